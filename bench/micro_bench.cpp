@@ -0,0 +1,270 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+#include "tokenizer.h"
+#include "varbyte.h"
+#include "index_reader.h"
+#include "embeddings.h"
+#include "embedding_store.h"
+
+// Microbenchmarks for the query and build kernels: tokenize, VarByte encode/decode,
+// posting list decode, docID intersection and embedding rerank dot products. Inputs are generated from a fixed seed so
+// numbers are comparable run to run; each case repeats until it has run for --min-time.
+//
+//   ./micro_bench [--filter substring] [--min-time seconds]
+
+// Sink for benchmark results so the optimizer cannot drop the measured work
+static volatile uint64_t g_sink = 0;
+
+struct BenchResult {
+    double ns_per_iter;
+    uint64_t iterations;
+};
+
+// Function to run one case until min_time has elapsed and return the mean time per iteration
+BenchResult run_case(const std::function<uint64_t()>& body, double min_time) {
+    g_sink = g_sink + body(); // warm-up: page in inputs and grow output buffers
+    uint64_t iterations = 0;
+    auto start = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed(0);
+    do {
+        g_sink = g_sink + body();
+        iterations++;
+        elapsed = std::chrono::steady_clock::now() - start;
+    } while(elapsed.count() < min_time);
+    return {elapsed.count() * 1e9 / iterations, iterations};
+}
+
+// Function to print one result line; items is the unit count processed per iteration
+void report(const std::string& name, const BenchResult& r, double items, const char* unit) {
+    double per_sec = items / (r.ns_per_iter / 1e9);
+    std::cout << std::left << std::setw(34) << name << std::right
+              << std::setw(14) << std::fixed << std::setprecision(1) << r.ns_per_iter << " ns/iter"
+              << std::setw(12) << std::setprecision(2) << per_sec / 1e6 << " M" << unit << "/s"
+              << std::setw(10) << r.iterations << " iters" << std::endl;
+}
+
+// Synthetic passages: Zipf-distributed words with punctuation and mixed case, roughly MS MARCO sized
+std::vector<std::string> make_passages(size_t count, std::mt19937& rng) {
+    std::vector<std::string> vocabulary;
+    for(int i = 0; i < 5000; ++i) {
+        vocabulary.push_back((i % 7 == 0 ? "Term" : "term") + std::to_string(i));
+    }
+    std::vector<double> weights(vocabulary.size());
+    for(size_t i = 0; i < weights.size(); ++i) weights[i] = 1.0 / (i + 1);
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> length(30, 80);
+
+    std::vector<std::string> passages(count);
+    for(auto& passage : passages) {
+        int words = length(rng);
+        for(int w = 0; w < words; ++w) {
+            passage += vocabulary[word(rng)];
+            passage += (w % 9 == 8) ? ". " : " ";
+        }
+    }
+    return passages;
+}
+
+// Sorted docID list of `count` ids drawn from [0, universe)
+std::vector<uint32_t> make_doc_ids(size_t count, uint32_t universe, std::mt19937& rng) {
+    std::uniform_int_distribution<uint32_t> pick(0, universe - 1);
+    std::vector<uint32_t> ids(count);
+    for(auto& id : ids) id = pick(rng);
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    return ids;
+}
+
+std::vector<uint32_t> to_gaps(const std::vector<uint32_t>& ids) {
+    std::vector<uint32_t> gaps(ids.size());
+    uint32_t prev = 0;
+    for(size_t i = 0; i < ids.size(); ++i) {
+        gaps[i] = ids[i] - prev;
+        prev = ids[i];
+    }
+    return gaps;
+}
+
+// Pointer-advance intersection, the access pattern of conjunctive DAAT traversal
+size_t intersect(const std::vector<uint32_t>& a, const std::vector<uint32_t>& b, std::vector<uint32_t>& out) {
+    out.clear();
+    size_t i = 0, j = 0;
+    while(i < a.size() && j < b.size()) {
+        if(a[i] < b[j]) {
+            i++;
+        } else if(b[j] < a[i]) {
+            j++;
+        } else {
+            out.push_back(a[i]);
+            i++;
+            j++;
+        }
+    }
+    return out.size();
+}
+
+// Galloping intersection: binary search the long list for each element of the short one
+size_t intersect_galloping(const std::vector<uint32_t>& shorter, const std::vector<uint32_t>& longer, std::vector<uint32_t>& out) {
+    out.clear();
+    auto from = longer.begin();
+    for(uint32_t id : shorter) {
+        from = std::lower_bound(from, longer.end(), id);
+        if(from == longer.end()) break;
+        if(*from == id) out.push_back(id);
+    }
+    return out.size();
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    double min_time = 0.5;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if(arg == "--min-time" && i + 1 < argc) {
+            min_time = std::stod(argv[++i]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--filter substring] [--min-time seconds]" << std::endl;
+            return 1;
+        }
+    }
+    auto selected = [&](const std::string& name) { return filter.empty() || name.find(filter) != std::string::npos; };
+
+    std::mt19937 rng(42);
+
+    // Tokenizer: throughput in input bytes
+    std::vector<std::string> passages = make_passages(2000, rng);
+    double passage_bytes = 0;
+    for(const auto& p : passages) passage_bytes += p.size();
+    if(selected("tokenize")) {
+        report("tokenize", run_case([&]() {
+            uint64_t n = 0;
+            for(const auto& p : passages) n += tokenize(p).size();
+            return n;
+        }, min_time), passage_bytes, "B");
+    }
+    if(selected("tokenize_with_offsets")) {
+        std::vector<std::string> tokens;
+        std::vector<uint32_t> offsets;
+        report("tokenize_with_offsets", run_case([&]() {
+            uint64_t n = 0;
+            for(const auto& p : passages) {
+                tokenize_with_offsets(p, tokens, offsets);
+                n += tokens.size();
+            }
+            return n;
+        }, min_time), passage_bytes, "B");
+    }
+
+    // VarByte: throughput in integers, on dense (small gaps) and sparse (large gaps) lists
+    struct GapCase { const char* name; size_t count; uint32_t universe; };
+    const GapCase gap_cases[] = {{"dense", 1000000, 2000000}, {"sparse", 100000, 8000000}};
+    for(const auto& gc : gap_cases) {
+        std::vector<uint32_t> ids = make_doc_ids(gc.count, gc.universe, rng);
+        std::vector<uint32_t> gaps = to_gaps(ids);
+        std::vector<uint8_t> encoded;
+        encodeVarByteList(gaps, encoded);
+        std::string suffix = std::string("/") + gc.name;
+
+        if(selected("encodeVarByteList" + suffix)) {
+            std::vector<uint8_t> out;
+            out.reserve(encoded.size());
+            report("encodeVarByteList" + suffix, run_case([&]() {
+                out.clear();
+                encodeVarByteList(gaps, out);
+                return static_cast<uint64_t>(out.size());
+            }, min_time), gaps.size(), "int");
+        }
+        if(selected("decodeVarByteList" + suffix)) {
+            report("decodeVarByteList" + suffix, run_case([&]() {
+                size_t index = 0;
+                return static_cast<uint64_t>(decodeVarByteList(encoded, index, gaps.size()).back());
+            }, min_time), gaps.size(), "int");
+        }
+        if(selected("decode_postings" + suffix)) {
+            // docIDs plus an all-ones frequency list, as most postings have freq 1
+            std::vector<uint8_t> encoded_freqs;
+            encodeVarByteList(std::vector<uint32_t>(gaps.size(), 1), encoded_freqs);
+            std::vector<uint32_t> doc_ids, freqs;
+            report("decode_postings" + suffix, run_case([&]() {
+                decode_postings(encoded, encoded_freqs, gaps.size(), doc_ids, freqs);
+                return static_cast<uint64_t>(doc_ids.back());
+            }, min_time), gaps.size(), "posting");
+        }
+    }
+
+    // Intersection: throughput in postings visited (sum of both list lengths)
+    struct IntersectCase { const char* name; size_t a; size_t b; };
+    const IntersectCase intersect_cases[] = {{"equal", 200000, 200000}, {"skewed", 1000000, 5000}};
+    for(const auto& ic : intersect_cases) {
+        std::vector<uint32_t> a = make_doc_ids(ic.a, 8000000, rng);
+        std::vector<uint32_t> b = make_doc_ids(ic.b, 8000000, rng);
+        std::vector<uint32_t> out;
+        out.reserve(std::min(a.size(), b.size()));
+        std::string suffix = std::string("/") + ic.name;
+        double postings = static_cast<double>(a.size() + b.size());
+
+        if(selected("intersect_merge" + suffix)) {
+            report("intersect_merge" + suffix, run_case([&]() { return static_cast<uint64_t>(intersect(a, b, out)); },
+                                                        min_time), postings, "posting");
+        }
+        if(selected("intersect_galloping" + suffix)) {
+            const auto& shorter = a.size() <= b.size() ? a : b;
+            const auto& longer = a.size() <= b.size() ? b : a;
+            report("intersect_galloping" + suffix, run_case([&]() { return static_cast<uint64_t>(intersect_galloping(shorter, longer, out)); },
+                                                            min_time), postings, "posting");
+        }
+    }
+
+    // Rerank: 1000 BM25 candidates scored against a 384-dim query, in candidates per second
+    const size_t rerank_dim = 384, rerank_candidates = 1000;
+    std::normal_distribution<float> normal(0.0f, 1.0f);
+    std::vector<float> query(rerank_dim), vectors(rerank_dim * rerank_candidates);
+    for(float& v : query) v = normal(rng);
+    for(float& v : vectors) v = normal(rng);
+    std::vector<int8_t> query_codes(rerank_dim), codes(vectors.size());
+    std::vector<uint16_t> halves(vectors.size());
+    quantizeInt8(query.data(), rerank_dim, query_codes.data());
+    for(size_t c = 0; c < rerank_candidates; ++c) {
+        quantizeInt8(vectors.data() + c * rerank_dim, rerank_dim, codes.data() + c * rerank_dim);
+    }
+    for(size_t i = 0; i < vectors.size(); ++i) halves[i] = floatToHalf(vectors[i]);
+
+    if(selected("rerank_f32")) {
+        report("rerank_f32", run_case([&]() {
+            float sum = 0.0f;
+            for(size_t c = 0; c < rerank_candidates; ++c) sum += dotProduct(query.data(), vectors.data() + c * rerank_dim, rerank_dim);
+            return static_cast<uint64_t>(sum != 0.0f);
+        }, min_time), rerank_candidates, "doc");
+    }
+    const SimdLevel detected = detectSimdLevel();
+    for(SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2, SimdLevel::Avx512}) {
+        if(level > detected) break;
+        std::string suffix = std::string("/") + simdLevelName(level);
+        if(selected("rerank_int8" + suffix)) {
+            report("rerank_int8" + suffix, run_case([&]() {
+                int64_t sum = 0;
+                for(size_t c = 0; c < rerank_candidates; ++c) sum += dotInt8(query_codes.data(), codes.data() + c * rerank_dim, rerank_dim, level);
+                return static_cast<uint64_t>(sum);
+            }, min_time), rerank_candidates, "doc");
+        }
+        if(selected("rerank_fp16" + suffix)) {
+            report("rerank_fp16" + suffix, run_case([&]() {
+                float sum = 0.0f;
+                for(size_t c = 0; c < rerank_candidates; ++c) sum += dotFp16(query.data(), halves.data() + c * rerank_dim, rerank_dim, level);
+                return static_cast<uint64_t>(sum != 0.0f);
+            }, min_time), rerank_candidates, "doc");
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,254 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+
+#include "collection_stats.h"
+
+// End-to-end benchmark harness. Builds an index with the pipeline executables (parser,
+// indexer) from a real or synthetic collection, reporting build throughput in
+// MB/s of collection text, then replays a query log through query_processor and reports QPS
+// and p50/p95/p99 query latency from the processor's own --metrics output.
+//
+//   ./replay_bench [--bin-dir DIR] [--collection collection.tsv | --synthetic-docs N]
+//                  [--queries queries.tsv | --synthetic-queries N] [--mode 1|2] [--repeat N]
+//                  [--skip-build] <work_dir>
+//
+// Query logs are one query per line, optionally "qid<TAB>query" as in MS MARCO queries.tsv.
+
+namespace fs = std::filesystem;
+
+#ifndef WSE_BIN_DIR
+#define WSE_BIN_DIR "."
+#endif
+
+// Function to run a shell command and return its wall time in seconds, or a negative value on failure
+double run_timed(const std::string& command) {
+    auto start = std::chrono::steady_clock::now();
+    int status = std::system(command.c_str());
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    if(status != 0) {
+        std::cerr << "Error: Command failed (" << status << "): " << command << std::endl;
+        return -1.0;
+    }
+    return elapsed.count();
+}
+
+std::string quote(const std::string& path) {
+    return "'" + path + "'";
+}
+
+// Function to write a synthetic collection: Zipf vocabulary plus a few recurring phrases
+bool write_synthetic_collection(const std::string& path, size_t num_docs, std::mt19937& rng) {
+    std::ofstream out(path);
+    if(!out.is_open()) {
+        std::cerr << "Error: Failed to create synthetic collection: " << path << std::endl;
+        return false;
+    }
+    std::vector<double> weights(20000);
+    for(size_t i = 0; i < weights.size(); ++i) weights[i] = 1.0 / (i + 1);
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> length(30, 80);
+    const char* phrases[] = {"New York City", "side effects", "how much does it cost"};
+
+    for(size_t doc = 0; doc < num_docs; ++doc) {
+        out << doc << "\t";
+        int words = length(rng);
+        for(int w = 0; w < words; ++w) {
+            if(w % 17 == 3 && doc % 5 == 0) {
+                out << phrases[doc % 3] << " ";
+            }
+            out << "w" << word(rng) << (w + 1 < words ? " " : ".");
+        }
+        out << "\n";
+    }
+    return true;
+}
+
+// Function to write a synthetic query log of 1-4 terms from the head and torso of the vocabulary
+bool write_synthetic_queries(const std::string& path, size_t num_queries, std::mt19937& rng) {
+    std::ofstream out(path);
+    if(!out.is_open()) {
+        std::cerr << "Error: Failed to create synthetic query log: " << path << std::endl;
+        return false;
+    }
+    std::vector<double> weights(5000);
+    for(size_t i = 0; i < weights.size(); ++i) weights[i] = 1.0 / std::sqrt(static_cast<double>(i + 1));
+    std::discrete_distribution<size_t> word(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> length(1, 4);
+    for(size_t q = 0; q < num_queries; ++q) {
+        out << q << "\t";
+        int terms = length(rng);
+        for(int t = 0; t < terms; ++t) {
+            out << (t ? " " : "") << "w" << word(rng);
+        }
+        out << "\n";
+    }
+    return true;
+}
+
+// Function to pull one numeric field out of the "query" stage line of query_processor's JSON metrics
+bool query_stage_field(const std::string& metrics_json, const std::string& key, double& value) {
+    size_t stage = metrics_json.find("\"query\":");
+    if(stage == std::string::npos) return false;
+    size_t field = metrics_json.find("\"" + key + "\":", stage);
+    if(field == std::string::npos) return false;
+    value = std::stod(metrics_json.substr(field + key.size() + 3));
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string bin_dir = WSE_BIN_DIR;
+    std::string collection;
+    size_t synthetic_docs = 0;
+    std::string queries;
+    size_t synthetic_queries = 0;
+    int mode = 2;
+    int repeat = 1;
+    bool skip_build = false;
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--bin-dir" && i + 1 < argc) {
+            bin_dir = argv[++i];
+        } else if(arg == "--collection" && i + 1 < argc) {
+            collection = argv[++i];
+        } else if(arg == "--synthetic-docs" && i + 1 < argc) {
+            synthetic_docs = std::stoul(argv[++i]);
+        } else if(arg == "--queries" && i + 1 < argc) {
+            queries = argv[++i];
+        } else if(arg == "--synthetic-queries" && i + 1 < argc) {
+            synthetic_queries = std::stoul(argv[++i]);
+        } else if(arg == "--mode" && i + 1 < argc) {
+            mode = std::stoi(argv[++i]);
+        } else if(arg == "--repeat" && i + 1 < argc) {
+            repeat = std::max(1, std::stoi(argv[++i]));
+        } else if(arg == "--skip-build") {
+            skip_build = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() != 1 || (mode != 1 && mode != 2)) {
+        std::cerr << "Usage: " << argv[0] << " [--bin-dir DIR] [--collection collection.tsv | --synthetic-docs N]"
+                  << " [--queries queries.tsv | --synthetic-queries N] [--mode 1|2] [--repeat N] [--skip-build] <work_dir>" << std::endl;
+        return 1;
+    }
+    std::string work_dir = args[0];
+    fs::create_directories(work_dir);
+
+    // Fixed seeds so synthetic runs are comparable across commits (and with --skip-build)
+    std::mt19937 collection_rng(2024);
+    std::mt19937 query_rng(2025);
+    if(collection.empty()) {
+        collection = work_dir + "/collection.tsv";
+        if(!skip_build && !write_synthetic_collection(collection, synthetic_docs ? synthetic_docs : 100000, collection_rng)) {
+            return 1;
+        }
+    }
+    if(queries.empty()) {
+        queries = work_dir + "/queries.tsv";
+        if(!write_synthetic_queries(queries, synthetic_queries ? synthetic_queries : 1000, query_rng)) {
+            return 1;
+        }
+    }
+
+    std::cout << std::fixed << std::setprecision(2);
+
+    // Build: parser -> indexer, each timed separately
+    if(!skip_build) {
+        double collection_mb = fs::file_size(collection) / (1024.0 * 1024.0);
+        for(const auto& entry : fs::directory_iterator(work_dir)) {
+            if(entry.path().filename().string().rfind("intermediate_", 0) == 0) fs::remove(entry.path());
+        }
+
+        double parse_s = run_timed(quote(bin_dir + "/parser") + " " + quote(collection) + " " + quote(work_dir) + " > /dev/null");
+        if(parse_s < 0) return 1;
+
+        std::string intermediates;
+        for(const auto& entry : fs::directory_iterator(work_dir)) {
+            if(entry.path().filename().string().rfind("intermediate_", 0) == 0) intermediates += " " + quote(entry.path().string());
+        }
+        double index_s = run_timed(quote(bin_dir + "/indexer") + intermediates + " " + quote(work_dir + "/final_index.bin") + " "
+                                   + quote(work_dir + "/lexicon.txt") + " > /dev/null");
+        if(index_s < 0) return 1;
+
+        CollectionStatsHeader stats;
+        if(!read_collection_stats_header(work_dir + "/collection_stats.bin", stats)) {
+            std::cerr << "Error: Failed to read collection stats in " << work_dir << std::endl;
+            return 1;
+        }
+
+        double total_s = parse_s + index_s;
+        std::cout << "Build: " << stats.num_docs << " docs, " << stats.num_terms << " terms, " << collection_mb << " MB" << std::endl;
+        std::cout << "  parser  " << std::setw(8) << parse_s << " s  " << std::setw(8) << collection_mb / parse_s << " MB/s" << std::endl;
+        std::cout << "  indexer " << std::setw(8) << index_s << " s  " << std::setw(8) << collection_mb / index_s << " MB/s" << std::endl;
+        std::cout << "  total   " << std::setw(8) << total_s << " s  " << std::setw(8) << collection_mb / total_s << " MB/s" << std::endl;
+    }
+
+    // Replay: feed "mode, query" pairs on stdin, as an interactive user would
+    std::ifstream log(queries);
+    if(!log.is_open()) {
+        std::cerr << "Error: Failed to open query log: " << queries << std::endl;
+        return 1;
+    }
+    std::vector<std::string> query_lines;
+    std::string line;
+    while(std::getline(log, line)) {
+        size_t tab = line.find('\t');
+        std::string text = (tab == std::string::npos) ? line : line.substr(tab + 1);
+        if(!text.empty() && text != "exit" && text != "metrics") query_lines.push_back(text);
+    }
+    if(query_lines.empty()) {
+        std::cerr << "Error: Query log is empty: " << queries << std::endl;
+        return 1;
+    }
+
+    std::string script = work_dir + "/replay_input.txt";
+    std::ofstream script_out(script);
+    for(int r = 0; r < repeat; ++r) {
+        for(const auto& q : query_lines) script_out << mode << "\n" << q << "\n";
+    }
+    script_out << mode << "\nexit\n";
+    script_out.close();
+
+    std::string metrics_file = work_dir + "/replay_metrics.json";
+    std::string command = quote(bin_dir + "/query_processor") + " " + quote(work_dir + "/final_index.bin") + " "
+                          + quote(work_dir + "/lexicon.txt") + " " + quote(work_dir + "/page_table.txt") + " "
+                          + quote(work_dir + "/passages.bin") + " " + quote(work_dir + "/collection_stats.bin")
+                          + " --metrics json --metrics-out " + quote(metrics_file)
+                          + " < " + quote(script) + " > " + quote(work_dir + "/replay_output.txt");
+    double replay_s = run_timed(command);
+    if(replay_s < 0) return 1;
+
+    std::ifstream metrics_in(metrics_file);
+    std::stringstream metrics_json;
+    metrics_json << metrics_in.rdbuf();
+    double count = 0, sum_ns = 0, p50 = 0, p95 = 0, p99 = 0, max_ns = 0;
+    if(!query_stage_field(metrics_json.str(), "count", count) || !query_stage_field(metrics_json.str(), "sum", sum_ns)
+       || !query_stage_field(metrics_json.str(), "p50", p50) || !query_stage_field(metrics_json.str(), "p95", p95)
+       || !query_stage_field(metrics_json.str(), "p99", p99) || !query_stage_field(metrics_json.str(), "max", max_ns)
+       || count == 0) {
+        std::cerr << "Error: No query metrics in " << metrics_file << std::endl;
+        return 1;
+    }
+
+    std::cout << "Replay: " << static_cast<uint64_t>(count) << " queries (mode " << mode << ", " << repeat << "x "
+              << query_lines.size() << " from " << queries << ")" << std::endl;
+    std::cout << "  QPS           " << std::setw(10) << count / (sum_ns / 1e9) << "  (in-process, excludes index load)" << std::endl;
+    std::cout << "  QPS wall      " << std::setw(10) << count / replay_s << "  (" << replay_s << " s including load)" << std::endl;
+    std::cout << "  latency ms    p50 " << p50 / 1e6 << "  p95 " << p95 / 1e6 << "  p99 " << p99 / 1e6
+              << "  max " << max_ns / 1e6 << std::endl;
+    std::cout << "Stage breakdown: " << metrics_file << std::endl;
+    return 0;
+}
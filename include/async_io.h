@@ -0,0 +1,409 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define ASYNC_IO_URING 1
+#endif
+#endif
+
+// Batched positional reads for the query processor. A query's posting lists (and later its
+// top-k passages and forward records) are issued together and handed back as each one
+// completes, so per-query I/O latency approaches one device round trip instead of the sum
+// of all of them when the index is not in the page cache.
+//
+// Backends, picked at startup:
+//   uring:    io_uring driven by raw syscalls (no liburing); falls back to threads when the
+//             kernel or a seccomp policy refuses io_uring_setup
+//   threads:  a small pool of pread workers
+//   sync:     one pread after another, the old behaviour
+//
+// Completion callbacks always run on the thread that called readBatch().
+
+enum class IoBackend { Sync, Threads, Uring };
+
+inline const char* ioBackendName(IoBackend backend) {
+    switch (backend) {
+        case IoBackend::Uring: return "io_uring";
+        case IoBackend::Threads: return "threads";
+        default: return "sync";
+    }
+}
+
+struct ReadRequest {
+    int fd = -1;
+    uint64_t offset = 0;
+    size_t length = 0;
+    void* buffer = nullptr;  // caller-owned, at least length bytes
+    ssize_t result = 0;      // bytes read (length on success) or -errno
+
+    // Backend state: bytes already read, for resubmitting short reads
+    size_t done = 0;
+    struct iovec iov {};
+};
+
+// Read-only file descriptor that closes itself
+class FileHandle {
+public:
+    FileHandle() = default;
+    FileHandle(const FileHandle&) = delete;
+    FileHandle& operator=(const FileHandle&) = delete;
+    ~FileHandle() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        return fd_ >= 0;
+    }
+    void close() {
+        if (fd_ >= 0) ::close(fd_);
+        fd_ = -1;
+    }
+    bool is_open() const { return fd_ >= 0; }
+    int fd() const { return fd_; }
+
+private:
+    int fd_ = -1;
+};
+
+// Function to read a whole request with pread, retrying short reads; sets request.result
+inline void preadFully(ReadRequest& request) {
+    char* out = static_cast<char*>(request.buffer);
+    while (request.done < request.length) {
+        ssize_t n = ::pread(request.fd, out + request.done, request.length - request.done,
+                            static_cast<off_t>(request.offset + request.done));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            request.result = n < 0 ? -errno : static_cast<ssize_t>(request.done);
+            return;
+        }
+        request.done += static_cast<size_t>(n);
+    }
+    request.result = static_cast<ssize_t>(request.done);
+}
+
+class AsyncReader {
+public:
+    AsyncReader() = default;
+    AsyncReader(const AsyncReader&) = delete;
+    AsyncReader& operator=(const AsyncReader&) = delete;
+    ~AsyncReader() { shutdown(); }
+
+    // Set up the preferred backend, falling back uring -> threads. queue_depth bounds the
+    // reads in flight; threads is the pool size for the thread backend.
+    void init(IoBackend preferred, unsigned queue_depth = 64, unsigned threads = 8) {
+        shutdown();
+        queue_depth_ = std::max(1u, queue_depth);
+        backend_ = IoBackend::Sync;
+        if (preferred == IoBackend::Uring && setupUring()) {
+            backend_ = IoBackend::Uring;
+        } else if (preferred != IoBackend::Sync) {
+            startThreads(std::max(1u, threads));
+            backend_ = IoBackend::Threads;
+        }
+    }
+
+    IoBackend backend() const { return backend_; }
+
+    // Issue every request at once and call on_complete(index) for each as it finishes, in
+    // completion order. Returns once all requests have completed.
+    void readBatch(std::vector<ReadRequest>& requests, const std::function<void(size_t)>& on_complete) {
+        for (auto& request : requests) {
+            request.done = 0;
+            request.result = 0;
+        }
+        if (requests.empty()) return;
+        if (backend_ == IoBackend::Uring) {
+            readBatchUring(requests, on_complete);
+        } else if (backend_ == IoBackend::Threads) {
+            readBatchThreads(requests, on_complete);
+        } else {
+            for (size_t i = 0; i < requests.size(); ++i) {
+                preadFully(requests[i]);
+                on_complete(i);
+            }
+        }
+    }
+
+private:
+    // ---- thread pool ----
+
+    struct Batch {
+        std::mutex mutex;
+        std::condition_variable done;
+        std::vector<size_t> completed;
+    };
+
+    struct Job {
+        ReadRequest* request;
+        size_t index;
+        Batch* batch;
+    };
+
+    void startThreads(unsigned threads) {
+        stopping_ = false;
+        for (unsigned t = 0; t < threads; ++t) {
+            workers_.emplace_back([this]() {
+                while (true) {
+                    Job job;
+                    {
+                        std::unique_lock<std::mutex> lock(jobs_mutex_);
+                        jobs_ready_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+                        if (jobs_.empty()) return;
+                        job = jobs_.front();
+                        jobs_.pop_front();
+                    }
+                    preadFully(*job.request);
+                    // Notify under the lock: the batch lives on the caller's stack and may be
+                    // gone as soon as the caller sees its last completion
+                    std::lock_guard<std::mutex> lock(job.batch->mutex);
+                    job.batch->completed.push_back(job.index);
+                    job.batch->done.notify_one();
+                }
+            });
+        }
+    }
+
+    void readBatchThreads(std::vector<ReadRequest>& requests, const std::function<void(size_t)>& on_complete) {
+        Batch batch;
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            for (size_t i = 0; i < requests.size(); ++i) {
+                jobs_.push_back(Job{&requests[i], i, &batch});
+            }
+        }
+        jobs_ready_.notify_all();
+
+        std::vector<size_t> ready;
+        for (size_t finished = 0; finished < requests.size();) {
+            {
+                std::unique_lock<std::mutex> lock(batch.mutex);
+                batch.done.wait(lock, [&]() { return !batch.completed.empty(); });
+                ready.swap(batch.completed);
+            }
+            for (size_t index : ready) {
+                on_complete(index);
+            }
+            finished += ready.size();
+            ready.clear();
+        }
+    }
+
+    // ---- io_uring ----
+
+#ifdef ASYNC_IO_URING
+    bool setupUring() {
+        struct io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, queue_depth_, &params));
+        if (fd < 0) return false;
+        ring_fd_ = fd;
+
+        sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+        bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap) sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+
+        sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (sq_ring_ == MAP_FAILED) {
+            sq_ring_ = nullptr;
+            shutdownUring();
+            return false;
+        }
+        cq_ring_ = single_mmap ? sq_ring_
+                               : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+        if (cq_ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+            if (cq_ring_ == MAP_FAILED) cq_ring_ = nullptr;
+            if (sqes != MAP_FAILED) munmap(sqes, sqes_size_);
+            shutdownUring();
+            return false;
+        }
+        sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+        char* sq = static_cast<char*>(sq_ring_);
+        char* cq = static_cast<char*>(cq_ring_);
+        sq_tail_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<uint32_t*>(sq + params.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<uint32_t*>(sq + params.sq_off.array);
+        cq_head_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.head);
+        cq_tail_ = reinterpret_cast<uint32_t*>(cq + params.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<uint32_t*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+        sq_entries_ = params.sq_entries;
+        return true;
+    }
+
+    void queueUring(ReadRequest& request, size_t index) {
+        request.iov.iov_base = static_cast<char*>(request.buffer) + request.done;
+        request.iov.iov_len = request.length - request.done;
+
+        uint32_t tail = *sq_tail_;
+        uint32_t slot = tail & sq_mask_;
+        struct io_uring_sqe* sqe = &sqes_[slot];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_READV;
+        sqe->fd = request.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&request.iov);
+        sqe->len = 1;
+        sqe->off = request.offset + request.done;
+        sqe->user_data = index;
+        sq_array_[slot] = slot;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    }
+
+    void readBatchUring(std::vector<ReadRequest>& requests, const std::function<void(size_t)>& on_complete) {
+        size_t next = 0;
+        size_t in_flight = 0;
+        size_t finished = 0;
+        unsigned to_submit = 0; // queued in the ring but not yet accepted by the kernel
+        std::vector<size_t> retry;
+        std::vector<bool> completed(requests.size(), false);
+
+        // Function to consume the completion queue; short reads are queued for a retry only
+        // while the ring is still usable
+        auto reap = [&](bool requeue) {
+            uint32_t head = *cq_head_;
+            uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            while (head != tail) {
+                const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                size_t index = static_cast<size_t>(cqe.user_data);
+                ReadRequest& request = requests[index];
+                --in_flight;
+                if (cqe.res > 0 && request.done + static_cast<size_t>(cqe.res) < request.length) {
+                    request.done += static_cast<size_t>(cqe.res);
+                    if (requeue) retry.push_back(index);
+                } else {
+                    if (cqe.res < 0) {
+                        request.result = cqe.res;
+                    } else {
+                        request.done += static_cast<size_t>(cqe.res);
+                        request.result = static_cast<ssize_t>(request.done);
+                    }
+                    completed[index] = true;
+                    ++finished;
+                    on_complete(index);
+                }
+                ++head;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        };
+
+        while (finished < requests.size()) {
+            // Fill the submission queue: short-read continuations first, then new requests
+            while (!retry.empty() && in_flight < sq_entries_) {
+                queueUring(requests[retry.back()], retry.back());
+                retry.pop_back();
+                ++in_flight;
+                ++to_submit;
+            }
+            while (next < requests.size() && in_flight < sq_entries_) {
+                queueUring(requests[next], next);
+                ++next;
+                ++in_flight;
+                ++to_submit;
+            }
+
+            int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (ret >= 0) {
+                to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(ret));
+            } else if (errno != EINTR) {
+                // The ring is unusable. Wait for the reads the kernel already accepted, since it
+                // may still be writing their buffers, then drop the ring for good: this reader
+                // stays synchronous from now on, and the reads left unfinished (never queued,
+                // never accepted, or cut short) complete with pread from where they stopped.
+                in_flight -= to_submit;
+                while (in_flight > 0) {
+                    reap(false);
+                    if (in_flight > 0) std::this_thread::yield();
+                }
+                shutdownUring();
+                backend_ = IoBackend::Sync;
+                for (size_t i = 0; i < requests.size(); ++i) {
+                    if (!completed[i]) {
+                        preadFully(requests[i]);
+                        on_complete(i);
+                    }
+                }
+                return;
+            }
+            reap(true);
+        }
+    }
+
+    void shutdownUring() {
+        if (sqes_) munmap(sqes_, sqes_size_);
+        if (cq_ring_ && cq_ring_ != sq_ring_) munmap(cq_ring_, cq_ring_size_);
+        if (sq_ring_) munmap(sq_ring_, sq_ring_size_);
+        if (ring_fd_ >= 0) ::close(ring_fd_);
+        sqes_ = nullptr;
+        cq_ring_ = sq_ring_ = nullptr;
+        ring_fd_ = -1;
+    }
+#else
+    bool setupUring() { return false; }
+    void readBatchUring(std::vector<ReadRequest>& requests, const std::function<void(size_t)>& on_complete) {
+        readBatchThreads(requests, on_complete);
+    }
+    void shutdownUring() {}
+#endif
+
+    void shutdown() {
+        {
+            std::lock_guard<std::mutex> lock(jobs_mutex_);
+            stopping_ = true;
+        }
+        jobs_ready_.notify_all();
+        for (auto& worker : workers_) worker.join();
+        workers_.clear();
+        shutdownUring();
+    }
+
+    IoBackend backend_ = IoBackend::Sync;
+    unsigned queue_depth_ = 64;
+
+    std::vector<std::thread> workers_;
+    std::mutex jobs_mutex_;
+    std::condition_variable jobs_ready_;
+    std::deque<Job> jobs_;
+    bool stopping_ = false;
+
+#ifdef ASYNC_IO_URING
+    int ring_fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    size_t sq_ring_size_ = 0;
+    size_t cq_ring_size_ = 0;
+    size_t sqes_size_ = 0;
+    struct io_uring_sqe* sqes_ = nullptr;
+    uint32_t* sq_tail_ = nullptr;
+    uint32_t* sq_array_ = nullptr;
+    uint32_t sq_mask_ = 0;
+    uint32_t sq_entries_ = 0;
+    uint32_t* cq_head_ = nullptr;
+    uint32_t* cq_tail_ = nullptr;
+    uint32_t cq_mask_ = 0;
+    struct io_uring_cqe* cqes_ = nullptr;
+#endif
+};
+
+#endif // ASYNC_IO_H
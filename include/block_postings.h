@@ -0,0 +1,270 @@
+#ifndef BLOCK_POSTINGS_H
+#define BLOCK_POSTINGS_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "varbyte.h"
+
+// Blocked final_index.bin layout ("indexer --layout blocked"): each term's postings are cut into
+// blocks of POSTING_BLOCK_SIZE, and every block stores its VarByte docID gaps immediately
+// followed by its VarByte freqs, so one contiguous read serves a whole list and a block's freqs
+// sit next to the docIDs that select them.
+//
+// File:    8-byte magic, padded to 64 bytes, then one region per term.
+// Region:  lists of up to one block are just  docIDs | freqs.
+//          longer lists start on a 64-byte boundary with a block directory (one BlockEntry per
+//          block, four to a cache line) followed by the blocks.
+// Blocks never straddle a 4 KB page unless they are larger than a page. docID gaps restart at
+// each block, relative to the previous block's last docID, so any block decodes on its own.
+//
+// The lexicon keeps its columns: docid_offset/docid_length give the region, freq_length is 0.
+
+const char BLOCKED_INDEX_MAGIC[8] = {'W', 'S', 'E', 'B', 'L', 'K', '0', '1'};
+const size_t BLOCKED_INDEX_HEADER_SIZE = 64;
+const size_t POSTING_BLOCK_SIZE = 128;
+const size_t INDEX_PAGE_SIZE = 4096;
+const size_t CACHE_LINE_SIZE = 64;
+
+#pragma pack(push, 1)
+struct BlockEntry {
+    uint32_t last_doc;    // largest docID in the block
+    uint32_t offset;      // block start, relative to the region
+    uint16_t doc_bytes;   // VarByte docID gaps; the freqs follow immediately
+    uint16_t freq_bytes;
+};
+#pragma pack(pop)
+
+enum class IndexLayout { Split, Blocked };
+
+// Function to detect the layout of final_index.bin from its first bytes
+inline IndexLayout detect_index_layout(const std::string& index_file) {
+    std::ifstream infile(index_file, std::ios::binary);
+    char magic[sizeof(BLOCKED_INDEX_MAGIC)] = {};
+    if (infile.read(magic, sizeof(magic)) && std::memcmp(magic, BLOCKED_INDEX_MAGIC, sizeof(magic)) == 0) {
+        return IndexLayout::Blocked;
+    }
+    return IndexLayout::Split;
+}
+
+// Function to pad `position` forward so `size` bytes starting there do not cross a page
+inline uint64_t avoid_page_split(uint64_t position, size_t size) {
+    uint64_t in_page = position % INDEX_PAGE_SIZE;
+    if (size <= INDEX_PAGE_SIZE && in_page + size > INDEX_PAGE_SIZE) {
+        return position + (INDEX_PAGE_SIZE - in_page);
+    }
+    return position;
+}
+
+// Function to lay out one term's docID-sorted postings for the blocked layout, to be written at
+// file offset `offset`. Fills `out` with leading padding followed by the region and returns the
+// padding length; the region is out.size() - padding bytes.
+inline size_t encode_blocked_postings(uint64_t offset, const std::vector<std::pair<uint32_t, uint32_t>>& postings,
+                                      std::vector<uint8_t>& out) {
+    out.clear();
+    size_t num_blocks = (postings.size() + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+
+    // Encode every block on its own
+    std::vector<std::vector<uint8_t>> blocks(num_blocks);
+    std::vector<BlockEntry> directory(num_blocks);
+    uint32_t prev_doc_id = 0;
+    for (size_t b = 0; b < num_blocks; ++b) {
+        size_t begin = b * POSTING_BLOCK_SIZE;
+        size_t end = std::min(postings.size(), begin + POSTING_BLOCK_SIZE);
+        std::vector<uint8_t> freq_bytes;
+        for (size_t i = begin; i < end; ++i) {
+            encodeVarByteSingle(postings[i].first - prev_doc_id, blocks[b]);
+            encodeVarByteSingle(postings[i].second, freq_bytes);
+            prev_doc_id = postings[i].first;
+        }
+        directory[b].last_doc = prev_doc_id;
+        directory[b].doc_bytes = static_cast<uint16_t>(blocks[b].size());
+        directory[b].freq_bytes = static_cast<uint16_t>(freq_bytes.size());
+        blocks[b].insert(blocks[b].end(), freq_bytes.begin(), freq_bytes.end());
+    }
+
+    if (num_blocks == 1) {
+        uint64_t start = avoid_page_split(offset, blocks[0].size());
+        out.assign(start - offset, 0);
+        out.insert(out.end(), blocks[0].begin(), blocks[0].end());
+        return static_cast<size_t>(start - offset);
+    }
+
+    // Directory on a cache line boundary, then the blocks, each kept inside one page
+    uint64_t start = (offset + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE * CACHE_LINE_SIZE;
+    uint64_t position = start + num_blocks * sizeof(BlockEntry);
+    std::vector<uint8_t> body;
+    for (size_t b = 0; b < num_blocks; ++b) {
+        uint64_t block_start = avoid_page_split(position, blocks[b].size());
+        body.resize(body.size() + (block_start - position), 0);
+        directory[b].offset = static_cast<uint32_t>(block_start - start);
+        body.insert(body.end(), blocks[b].begin(), blocks[b].end());
+        position = block_start + blocks[b].size();
+    }
+    out.assign(start - offset, 0);
+    const uint8_t* dir_bytes = reinterpret_cast<const uint8_t*>(directory.data());
+    out.insert(out.end(), dir_bytes, dir_bytes + directory.size() * sizeof(BlockEntry));
+    out.insert(out.end(), body.begin(), body.end());
+    return static_cast<size_t>(start - offset);
+}
+
+// Cursor over one term's postings, for either layout. A split-layout list is decoded up front
+// and behaves as a single block. A blocked list decodes a block's docIDs when the cursor enters
+// it and its freqs only when freq() is asked for there; blocks that nextGEQ jumps over are
+// never decoded at all. Decoding errors throw std::runtime_error.
+class PostingCursor {
+public:
+    // Split layout: the whole list, already decoded
+    void reset(std::vector<uint32_t> doc_ids, std::vector<uint32_t> freqs) {
+        blocked_ = false;
+        region_.clear();
+        directory_.clear();
+        size_ = doc_ids.size();
+        docs_ = std::move(doc_ids);
+        freqs_ = std::move(freqs);
+        freqs_ready_ = true;
+        block_ = 0;
+        block_begin_ = 0;
+        pos_ = 0;
+        blocks_skipped_ = 0;
+        blocks_decoded_ = 0;
+    }
+
+    // Blocked layout: the term's region as read from final_index.bin
+    void reset(std::vector<uint8_t> region, size_t doc_freq) {
+        blocked_ = true;
+        region_ = std::move(region);
+        size_ = doc_freq;
+        directory_.clear();
+        num_blocks_ = (doc_freq + POSTING_BLOCK_SIZE - 1) / POSTING_BLOCK_SIZE;
+        if (num_blocks_ > 1) {
+            if (region_.size() < num_blocks_ * sizeof(BlockEntry)) {
+                throw std::runtime_error("Posting list error: truncated block directory.");
+            }
+            directory_.resize(num_blocks_);
+            std::memcpy(directory_.data(), region_.data(), num_blocks_ * sizeof(BlockEntry));
+        }
+        blocks_skipped_ = 0;
+        blocks_decoded_ = 0;
+        block_ = 0;
+        block_begin_ = 0;
+        pos_ = 0;
+        if (size_ > 0) {
+            loadBlock(0);
+        }
+    }
+
+    size_t size() const { return size_; }
+    bool done() const { return block_begin_ + pos_ >= size_; }
+    uint32_t docid() const { return docs_[pos_]; }
+    size_t index() const { return block_begin_ + pos_; } // posting number within the whole list
+    uint64_t blocksSkipped() const { return blocks_skipped_; }
+    uint64_t blocksDecoded() const { return blocks_decoded_; }
+
+    uint32_t freq() {
+        if (!freqs_ready_) decodeFreqs();
+        return freqs_[pos_];
+    }
+
+    void next() {
+        if (++pos_ >= docs_.size() && !directory_.empty() && block_ + 1 < num_blocks_) {
+            loadBlock(block_ + 1);
+        }
+    }
+
+    // Advance to the first posting with docID >= target (or to the end)
+    void nextGEQ(uint32_t target) {
+        if (done() || docs_[pos_] >= target) return;
+        if (!directory_.empty() && directory_[block_].last_doc < target) {
+            // Jump straight to the first block that can hold the target
+            size_t b = block_ + 1;
+            while (b < num_blocks_ && directory_[b].last_doc < target) ++b;
+            if (b >= num_blocks_) {
+                blocks_skipped_ += num_blocks_ - block_ - 1;
+                block_begin_ = size_;
+                pos_ = 0;
+                return;
+            }
+            blocks_skipped_ += b - block_ - 1;
+            loadBlock(b);
+        }
+        // The block's last docID is >= target, so this lands inside it (or at the end of a split list)
+        auto it = std::lower_bound(docs_.begin() + pos_, docs_.end(), target);
+        pos_ = static_cast<size_t>(it - docs_.begin());
+    }
+
+    // Decode the entire list (phrase terms need every freq to walk their positions)
+    void decodeAll(std::vector<uint32_t>& doc_ids, std::vector<uint32_t>& freqs) {
+        doc_ids.clear();
+        freqs.clear();
+        if (!blocked_) {
+            doc_ids = docs_;
+            freqs = freqs_;
+            return;
+        }
+        for (size_t b = 0; b < num_blocks_; ++b) {
+            loadBlock(b);
+            decodeFreqs();
+            doc_ids.insert(doc_ids.end(), docs_.begin(), docs_.end());
+            freqs.insert(freqs.end(), freqs_.begin(), freqs_.end());
+        }
+        loadBlock(0);
+    }
+
+private:
+    void loadBlock(size_t b) {
+        block_ = b;
+        block_begin_ = b * POSTING_BLOCK_SIZE;
+        size_t count = std::min(POSTING_BLOCK_SIZE, size_ - block_begin_);
+        size_t start = 0;
+        uint32_t base = 0;
+        if (!directory_.empty()) {
+            start = directory_[b].offset;
+            base = b > 0 ? directory_[b - 1].last_doc : 0;
+        }
+        docs_.resize(count);
+        size_t index = start;
+        decodeVarByteRange(region_.data(), region_.size(), index, docs_.data(), count);
+        for (auto& doc_id : docs_) {
+            doc_id += base;
+            base = doc_id;
+        }
+        freq_start_ = index;
+        freqs_ready_ = false;
+        pos_ = 0;
+        blocks_decoded_++;
+    }
+
+    void decodeFreqs() {
+        size_t index = freq_start_;
+        freqs_.resize(docs_.size());
+        decodeVarByteRange(region_.data(), region_.size(), index, freqs_.data(), freqs_.size());
+        freqs_ready_ = true;
+    }
+
+    bool blocked_ = false;
+    std::vector<uint8_t> region_;
+    std::vector<BlockEntry> directory_;
+    size_t size_ = 0;
+    size_t num_blocks_ = 1;
+
+    // Current block
+    std::vector<uint32_t> docs_;
+    std::vector<uint32_t> freqs_;
+    bool freqs_ready_ = false;
+    size_t freq_start_ = 0;
+    size_t block_ = 0;
+    size_t block_begin_ = 0;
+    size_t pos_ = 0;
+
+    uint64_t blocks_skipped_ = 0;
+    uint64_t blocks_decoded_ = 0;
+};
+
+#endif // BLOCK_POSTINGS_H
@@ -0,0 +1,188 @@
+#ifndef COLLECTION_STATS_H
+#define COLLECTION_STATS_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// collection_stats.bin: the collection-wide numbers BM25 needs, written once by the parser (or
+// reorder / shard_index) and extended in place by the indexer, so nothing re-derives them from
+// text at query time.
+//
+// File:   a fixed 256-byte header, then one uint32 token count per docID slot, from the lowest
+//         docID on (0 for a docID with no document or an empty one), so a shard's table only
+//         covers its own docID range.
+// Header: document count, total tokens, avgdl, per-field totals, and the term and posting
+//         counts of the index built from it (0 until the indexer has run).
+//
+// The header has a fixed size and sits at the front, so the indexer updates it in place without
+// touching the length table.
+
+const char COLLECTION_STATS_MAGIC[8] = {'W', 'S', 'E', 'S', 'T', 'A', 'T', '1'};
+const uint32_t COLLECTION_STATS_VERSION = 1;
+const size_t COLLECTION_STATS_HEADER_SIZE = 256;
+const size_t COLLECTION_STATS_MAX_FIELDS = 4;
+
+#pragma pack(push, 1)
+struct FieldStats {
+    char name[16];          // e.g. "body"; MS MARCO passages have only the one field
+    uint64_t num_docs;      // documents with at least one token in the field
+    uint64_t total_tokens;
+};
+
+struct CollectionStatsHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_fields;
+    uint64_t num_docs;
+    uint64_t total_tokens;
+    double avgdl;
+    uint64_t num_terms;     // distinct terms in the index (set by the indexer)
+    uint64_t num_postings;  // postings in the index (set by the indexer)
+    uint64_t length_slots;  // entries in the length table that follows the header
+    uint32_t first_doc_id;  // docID of the table's first entry
+    FieldStats fields[COLLECTION_STATS_MAX_FIELDS];
+};
+#pragma pack(pop)
+
+static_assert(sizeof(CollectionStatsHeader) <= COLLECTION_STATS_HEADER_SIZE, "collection stats header too large");
+
+// In-memory collection statistics and the docID -> length table
+struct CollectionStats {
+    CollectionStatsHeader header{};
+    std::vector<uint32_t> doc_lengths; // indexed by docID - header.first_doc_id
+
+    CollectionStats() {
+        std::memcpy(header.magic, COLLECTION_STATS_MAGIC, sizeof(header.magic));
+        header.version = COLLECTION_STATS_VERSION;
+        header.num_fields = 1;
+        std::strncpy(header.fields[0].name, "body", sizeof(header.fields[0].name) - 1);
+    }
+
+    uint64_t numDocs() const { return header.num_docs; }
+    double avgdl() const { return header.avgdl; }
+
+    bool hasDoc(uint32_t doc_id) const {
+        return doc_id >= header.first_doc_id && doc_id - header.first_doc_id < doc_lengths.size();
+    }
+    uint32_t docLength(uint32_t doc_id) const { return hasDoc(doc_id) ? doc_lengths[doc_id - header.first_doc_id] : 0; }
+
+    // Function to record one document's token count in field `field` (0 is the body); false if
+    // the field does not exist, this document's field was already recorded, or the stats were
+    // loaded from a file rather than built with addDocument
+    bool addDocument(uint32_t doc_id, uint32_t length, uint32_t field = 0) {
+        if (field >= COLLECTION_STATS_MAX_FIELDS || field >= header.num_fields) {
+            std::cerr << "Error: Field " << field << " out of range for docID " << doc_id << "." << std::endl;
+            return false;
+        }
+        if (recorded.size() != doc_lengths.size()) {
+            // The table was filled from a stats file, which does not say which slots hold a
+            // document (an empty one also has length 0), so duplicates could not be caught
+            std::cerr << "Error: Cannot add docID " << doc_id << " to collection stats loaded from a file." << std::endl;
+            return false;
+        }
+        if (doc_lengths.empty()) {
+            header.first_doc_id = doc_id;
+        } else if (doc_id < header.first_doc_id) {
+            doc_lengths.insert(doc_lengths.begin(), header.first_doc_id - doc_id, 0);
+            recorded.insert(recorded.begin(), header.first_doc_id - doc_id, 0);
+            header.first_doc_id = doc_id;
+        }
+        size_t slot = doc_id - header.first_doc_id;
+        if (slot >= doc_lengths.size()) {
+            doc_lengths.resize(slot + 1, 0);
+            recorded.resize(slot + 1, 0);
+        }
+        if (recorded[slot] & (1u << field)) {
+            std::cerr << "Error: Duplicate docID " << doc_id << " in field " << field << "." << std::endl;
+            return false;
+        }
+        recorded[slot] |= static_cast<uint8_t>(1u << field);
+        doc_lengths[slot] += length;
+        header.num_docs += field == 0 ? 1 : 0;
+        header.total_tokens += length;
+        header.fields[field].num_docs += length > 0 ? 1 : 0;
+        header.fields[field].total_tokens += length;
+        header.avgdl = header.num_docs ? static_cast<double>(header.total_tokens) / static_cast<double>(header.num_docs) : 0.0;
+        header.length_slots = doc_lengths.size();
+        return true;
+    }
+
+private:
+    std::vector<uint8_t> recorded; // per slot, one bit per field already added
+};
+
+// Function to write the whole stats file (header and length table)
+inline bool save_collection_stats(const std::string& stats_file, const CollectionStats& stats) {
+    std::ofstream outfile(stats_file, std::ios::binary);
+    if (!outfile.is_open()) {
+        std::cerr << "Error: Failed to create collection stats file: " << stats_file << std::endl;
+        return false;
+    }
+    char header[COLLECTION_STATS_HEADER_SIZE] = {};
+    CollectionStatsHeader fixed = stats.header;
+    fixed.length_slots = stats.doc_lengths.size();
+    std::memcpy(header, &fixed, sizeof(fixed));
+    outfile.write(header, sizeof(header));
+    outfile.write(reinterpret_cast<const char*>(stats.doc_lengths.data()), stats.doc_lengths.size() * sizeof(uint32_t));
+    return static_cast<bool>(outfile);
+}
+
+// Function to read only the header; false if the file is missing or not a stats file
+inline bool read_collection_stats_header(const std::string& stats_file, CollectionStatsHeader& header) {
+    std::ifstream infile(stats_file, std::ios::binary);
+    return infile.read(reinterpret_cast<char*>(&header), sizeof(header))
+           && std::memcmp(header.magic, COLLECTION_STATS_MAGIC, sizeof(header.magic)) == 0
+           && header.version == COLLECTION_STATS_VERSION;
+}
+
+// Function to overwrite the header in place, leaving the length table untouched
+inline bool write_collection_stats_header(const std::string& stats_file, const CollectionStatsHeader& header) {
+    std::fstream file(stats_file, std::ios::binary | std::ios::in | std::ios::out);
+    if (!file.is_open()) {
+        std::cerr << "Error: Failed to open collection stats file: " << stats_file << std::endl;
+        return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(file);
+}
+
+// Function to load collection_stats.bin with one read of the length table. A text
+// "docID length" file (the older doc_lengths.txt) is accepted too, with the totals computed.
+inline bool load_collection_stats(const std::string& stats_file, CollectionStats& stats) {
+    std::ifstream infile(stats_file, std::ios::binary);
+    if (!infile.is_open()) {
+        std::cerr << "Error: Failed to open collection stats file: " << stats_file << std::endl;
+        return false;
+    }
+    stats = CollectionStats();
+    char header[COLLECTION_STATS_HEADER_SIZE];
+    if (infile.read(header, sizeof(header)) && std::memcmp(header, COLLECTION_STATS_MAGIC, sizeof(COLLECTION_STATS_MAGIC)) == 0) {
+        std::memcpy(&stats.header, header, sizeof(stats.header));
+        if (stats.header.version != COLLECTION_STATS_VERSION) {
+            std::cerr << "Error: Unsupported collection stats version " << stats.header.version << " in " << stats_file << std::endl;
+            return false;
+        }
+        stats.doc_lengths.resize(stats.header.length_slots);
+        if (!infile.read(reinterpret_cast<char*>(stats.doc_lengths.data()), stats.doc_lengths.size() * sizeof(uint32_t))) {
+            std::cerr << "Error: Truncated collection stats file: " << stats_file << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    infile.clear();
+    infile.seekg(0, std::ios::beg);
+    uint32_t doc_id, length;
+    while (infile >> doc_id >> length) {
+        if (!stats.addDocument(doc_id, length)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif // COLLECTION_STATS_H
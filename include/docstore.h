@@ -0,0 +1,254 @@
+#ifndef DOCSTORE_H
+#define DOCSTORE_H
+
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "lz.h"
+
+// Compressed passage store (docstore.bin).
+//
+// Layout:
+//   header:       magic u32 | version u32 | num_blocks u32 | num_docs u32 | index_offset u64
+//   blocks:       LZ-compressed runs of [docID u32][length u32][passage bytes] in ascending docID order
+//   block index:  num_blocks x DocStoreBlock, at index_offset
+//
+// Passages are grouped into blocks of roughly DOCSTORE_DEFAULT_BLOCK_SIZE raw bytes, so
+// one read + one decompression serves every passage in the block.
+
+const uint32_t DOCSTORE_MAGIC = 0x52545344; // "DSTR"
+const uint32_t DOCSTORE_VERSION = 1;
+const size_t DOCSTORE_DEFAULT_BLOCK_SIZE = 32 * 1024;
+
+struct DocStoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_blocks;
+    uint32_t num_docs;
+    uint64_t index_offset;
+};
+
+struct DocStoreBlock {
+    uint32_t first_doc_id;
+    uint32_t doc_count;
+    uint64_t file_offset;
+    uint32_t compressed_size;
+    uint32_t raw_size;
+};
+
+// Writer: append passages in ascending docID order, then finish()
+class DocStoreWriter {
+public:
+    explicit DocStoreWriter(const std::string& path, size_t block_size = DOCSTORE_DEFAULT_BLOCK_SIZE)
+        : out_(path, std::ios::binary), block_size_(block_size) {
+        if (!out_.is_open()) {
+            throw std::runtime_error("Failed to create docstore file: " + path);
+        }
+        DocStoreHeader header{DOCSTORE_MAGIC, DOCSTORE_VERSION, 0, 0, 0};
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset_ = sizeof(header);
+    }
+
+    void add(uint32_t doc_id, const char* data, uint32_t length) {
+        if (num_docs_ > 0 && doc_id <= last_doc_id_) {
+            throw std::runtime_error("Docstore passages must be added in ascending docID order.");
+        }
+        if (pending_count_ == 0) {
+            pending_first_ = doc_id;
+        }
+        appendRaw(&doc_id, sizeof(doc_id));
+        appendRaw(&length, sizeof(length));
+        appendRaw(data, length);
+        pending_count_++;
+        num_docs_++;
+        last_doc_id_ = doc_id;
+        if (pending_.size() >= block_size_) {
+            flushBlock();
+        }
+    }
+
+    // Flush the last block and write the block index and final header
+    uint64_t finish() {
+        flushBlock();
+        uint64_t index_offset = offset_;
+        out_.write(reinterpret_cast<const char*>(blocks_.data()), blocks_.size() * sizeof(DocStoreBlock));
+        offset_ += blocks_.size() * sizeof(DocStoreBlock);
+
+        DocStoreHeader header{DOCSTORE_MAGIC, DOCSTORE_VERSION, static_cast<uint32_t>(blocks_.size()), num_docs_, index_offset};
+        out_.seekp(0, std::ios::beg);
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out_.close();
+        return offset_;
+    }
+
+private:
+    void appendRaw(const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        pending_.insert(pending_.end(), bytes, bytes + length);
+    }
+
+    void flushBlock() {
+        if (pending_count_ == 0) return;
+        compressed_.clear();
+        lzCompress(reinterpret_cast<const uint8_t*>(pending_.data()), pending_.size(), compressed_);
+        out_.write(reinterpret_cast<const char*>(compressed_.data()), compressed_.size());
+
+        blocks_.push_back({pending_first_, pending_count_, offset_,
+                           static_cast<uint32_t>(compressed_.size()), static_cast<uint32_t>(pending_.size())});
+        offset_ += compressed_.size();
+        pending_.clear();
+        pending_count_ = 0;
+    }
+
+    std::ofstream out_;
+    size_t block_size_;
+    uint64_t offset_ = 0;
+    std::vector<char> pending_;
+    std::vector<uint8_t> compressed_;
+    uint32_t pending_first_ = 0;
+    uint32_t pending_count_ = 0;
+    uint32_t num_docs_ = 0;
+    uint32_t last_doc_id_ = 0;
+    std::vector<DocStoreBlock> blocks_;
+};
+
+// Reader with a small LRU cache of decompressed blocks
+class DocStore {
+public:
+    struct Stats {
+        uint64_t block_reads = 0;
+        uint64_t cache_hits = 0;
+    };
+
+    bool open(const std::string& path, size_t cache_blocks) {
+        file_.open(path, std::ios::binary);
+        if (!file_.is_open()) {
+            return false;
+        }
+        DocStoreHeader header;
+        if (!file_.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+            header.magic != DOCSTORE_MAGIC || header.version != DOCSTORE_VERSION) {
+            return false;
+        }
+        blocks_.resize(header.num_blocks);
+        file_.seekg(header.index_offset, std::ios::beg);
+        if (!file_.read(reinterpret_cast<char*>(blocks_.data()), blocks_.size() * sizeof(DocStoreBlock))) {
+            return false;
+        }
+        num_docs_ = header.num_docs;
+        cache_capacity_ = std::max<size_t>(1, cache_blocks);
+        return true;
+    }
+
+    size_t numDocs() const { return num_docs_; }
+    size_t numBlocks() const { return blocks_.size(); }
+    const Stats& stats() const { return stats_; }
+
+    // Fetch a batch of passages. Requests are grouped by block so each block is read and
+    // decompressed at most once; docIDs absent from the store are left out of the result.
+    void fetch(const std::vector<uint32_t>& doc_ids, std::unordered_map<uint32_t, std::string>& passages) {
+        std::vector<std::pair<size_t, uint32_t>> by_block;
+        by_block.reserve(doc_ids.size());
+        for (uint32_t doc_id : doc_ids) {
+            size_t block = findBlock(doc_id);
+            if (block != SIZE_MAX) {
+                by_block.emplace_back(block, doc_id);
+            }
+        }
+        std::sort(by_block.begin(), by_block.end());
+
+        for (const auto& [block, doc_id] : by_block) {
+            const CachedBlock& cached = loadBlock(block);
+            auto it = std::lower_bound(cached.entries.begin(), cached.entries.end(), doc_id,
+                                       [](const Entry& e, uint32_t id) { return e.doc_id < id; });
+            if (it != cached.entries.end() && it->doc_id == doc_id) {
+                passages[doc_id].assign(cached.data.data() + it->offset, it->length);
+            }
+        }
+    }
+
+private:
+    struct Entry {
+        uint32_t doc_id;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    struct CachedBlock {
+        std::vector<char> data;
+        std::vector<Entry> entries;
+    };
+
+    // Index of the block whose docID range may contain doc_id, or SIZE_MAX
+    size_t findBlock(uint32_t doc_id) const {
+        auto it = std::upper_bound(blocks_.begin(), blocks_.end(), doc_id,
+                                   [](uint32_t id, const DocStoreBlock& b) { return id < b.first_doc_id; });
+        if (it == blocks_.begin()) return SIZE_MAX;
+        return static_cast<size_t>(it - blocks_.begin()) - 1;
+    }
+
+    const CachedBlock& loadBlock(size_t block) {
+        auto it = cache_.find(block);
+        if (it != cache_.end()) {
+            stats_.cache_hits++;
+            lru_.splice(lru_.begin(), lru_, it->second.first);
+            return it->second.second;
+        }
+
+        const DocStoreBlock& meta = blocks_[block];
+        std::vector<uint8_t> compressed(meta.compressed_size);
+        file_.clear();
+        file_.seekg(meta.file_offset, std::ios::beg);
+        if (!file_.read(reinterpret_cast<char*>(compressed.data()), compressed.size())) {
+            throw std::runtime_error("Docstore read error: block " + std::to_string(block));
+        }
+        stats_.block_reads++;
+
+        CachedBlock cached;
+        cached.data.resize(meta.raw_size);
+        lzDecompress(compressed.data(), compressed.size(), reinterpret_cast<uint8_t*>(cached.data.data()), meta.raw_size);
+
+        // Index the passages inside the block
+        cached.entries.reserve(meta.doc_count);
+        size_t pos = 0;
+        for (uint32_t i = 0; i < meta.doc_count; ++i) {
+            if (pos + 2 * sizeof(uint32_t) > cached.data.size()) {
+                throw std::runtime_error("Docstore format error: truncated block " + std::to_string(block));
+            }
+            Entry entry;
+            std::memcpy(&entry.doc_id, cached.data.data() + pos, sizeof(uint32_t));
+            std::memcpy(&entry.length, cached.data.data() + pos + sizeof(uint32_t), sizeof(uint32_t));
+            entry.offset = static_cast<uint32_t>(pos + 2 * sizeof(uint32_t));
+            if (static_cast<size_t>(entry.offset) + entry.length > cached.data.size()) {
+                throw std::runtime_error("Docstore format error: truncated block " + std::to_string(block));
+            }
+            pos = entry.offset + entry.length;
+            cached.entries.push_back(entry);
+        }
+
+        if (cache_.size() >= cache_capacity_) {
+            cache_.erase(lru_.back());
+            lru_.pop_back();
+        }
+        lru_.push_front(block);
+        auto inserted = cache_.emplace(block, std::make_pair(lru_.begin(), std::move(cached)));
+        return inserted.first->second.second;
+    }
+
+    std::ifstream file_;
+    std::vector<DocStoreBlock> blocks_;
+    size_t num_docs_ = 0;
+    size_t cache_capacity_ = 1;
+    std::list<size_t> lru_;
+    std::unordered_map<size_t, std::pair<std::list<size_t>::iterator, CachedBlock>> cache_;
+    Stats stats_;
+};
+
+#endif // DOCSTORE_H
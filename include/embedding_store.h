@@ -0,0 +1,412 @@
+#ifndef EMBEDDING_STORE_H
+#define EMBEDDING_STORE_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define EMBEDDING_STORE_MMAP 1
+#endif
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define EMBEDDING_STORE_X86 1
+#endif
+
+#include "embeddings.h"
+
+// Scalar-quantized passage embeddings indexed by docID (embeddings_store.bin), for exact
+// dense reranking of BM25 candidates. The file is mapped read-only, so loading is free and
+// pages are shared between processes.
+//
+// Layout (every section starts on a 64-byte boundary):
+//   header:   EmbeddingStoreHeader
+//   present:  bitmap of num_slots bits, docIDs that have an embedding
+//   scales:   num_slots x f32, per-vector dequantization scale (int8 only)
+//   codes:    num_slots x stride bytes; int8 codes or IEEE fp16 values of the normalized vector
+//
+// int8 is symmetric per vector: code = round(x / scale), scale = max|x| / 127. Scores are
+// inner products of unit vectors, i.e. cosine similarity.
+
+const uint32_t EMBEDDING_STORE_MAGIC = 0x51424D45; // "EMBQ"
+const uint32_t EMBEDDING_STORE_VERSION = 1;
+
+enum class Quantization : uint32_t {
+    Int8 = 1,
+    Fp16 = 2
+};
+
+struct EmbeddingStoreHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t dim;
+    uint32_t quantization;
+    uint32_t num_slots;   // max docID + 1
+    uint32_t stride;      // bytes per code slot, a multiple of 64
+    uint64_t present_offset;
+    uint64_t scales_offset;
+    uint64_t codes_offset;
+    uint64_t file_size;
+};
+
+inline uint64_t alignTo64(uint64_t offset) {
+    return (offset + 63) & ~uint64_t(63);
+}
+
+// IEEE half <-> float, round to nearest even
+inline uint16_t floatToHalf(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((x >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = x & 0x7FFFFF;
+    if (((x >> 23) & 0xFF) == 0xFF) return static_cast<uint16_t>(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00);
+    if (exponent <= 0) {
+        if (exponent < -10) return static_cast<uint16_t>(sign);
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) half++;
+        return static_cast<uint16_t>(sign | half);
+    }
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // may carry into the exponent, which is correct
+    return static_cast<uint16_t>(half);
+}
+
+inline float halfToFloat(uint16_t h) {
+    uint32_t sign = static_cast<uint32_t>(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t x;
+    if (exponent == 0x1F) {
+        x = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent != 0) {
+        x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    } else if (mantissa == 0) {
+        x = sign;
+    } else {
+        // Subnormal half: renormalize
+        int e = -1;
+        do {
+            mantissa <<= 1;
+            e++;
+        } while ((mantissa & 0x400) == 0);
+        x = sign | (static_cast<uint32_t>(127 - 15 - e) << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// Quantize a vector to int8 codes; returns the scale
+inline float quantizeInt8(const float* v, size_t dim, int8_t* codes) {
+    float max_abs = 0.0f;
+    for (size_t i = 0; i < dim; ++i) max_abs = std::max(max_abs, std::fabs(v[i]));
+    float scale = max_abs > 0.0f ? max_abs / 127.0f : 1.0f;
+    for (size_t i = 0; i < dim; ++i) {
+        codes[i] = static_cast<int8_t>(std::lround(std::max(-127.0f, std::min(127.0f, v[i] / scale))));
+    }
+    return scale;
+}
+
+// Dot-product kernels. The SIMD versions are compiled for their target with function
+// attributes and picked at run time, so the binary still runs on CPUs without AVX2.
+
+inline int32_t dotInt8Scalar(const int8_t* a, const int8_t* b, size_t dim) {
+    int32_t sum = 0;
+    for (size_t i = 0; i < dim; ++i) sum += static_cast<int32_t>(a[i]) * b[i];
+    return sum;
+}
+
+inline float dotFp16Scalar(const float* q, const uint16_t* v, size_t dim) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < dim; ++i) sum += q[i] * halfToFloat(v[i]);
+    return sum;
+}
+
+#ifdef EMBEDDING_STORE_X86
+__attribute__((target("avx2"))) inline int32_t dotInt8Avx2(const int8_t* a, const int8_t* b, size_t dim) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m256i va = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i vb = _mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(va, vb));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_hadd_epi32(sum, sum);
+    sum = _mm_hadd_epi32(sum, sum);
+    return _mm_cvtsi128_si32(sum) + dotInt8Scalar(a + i, b + i, dim - i);
+}
+
+// GCC's AVX-512 headers build some results from _mm512_undefined_*(), which -Wall reports as
+// uninitialized once inlined here; the values are fully overwritten
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+__attribute__((target("avx512f,avx512bw"))) inline int32_t dotInt8Avx512(const int8_t* a, const int8_t* b, size_t dim) {
+    __m512i acc = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 32 <= dim; i += 32) {
+        __m512i va = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)));
+        __m512i vb = _mm512_cvtepi8_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        acc = _mm512_add_epi32(acc, _mm512_madd_epi16(va, vb));
+    }
+    return _mm512_reduce_add_epi32(acc) + dotInt8Scalar(a + i, b + i, dim - i);
+}
+
+__attribute__((target("avx2,fma,f16c"))) inline float dotFp16Avx2(const float* q, const uint16_t* v, size_t dim) {
+    __m256 acc = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= dim; i += 8) {
+        __m256 vv = _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v + i)));
+        acc = _mm256_fmadd_ps(_mm256_loadu_ps(q + i), vv, acc);
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    sum = _mm_hadd_ps(sum, sum);
+    sum = _mm_hadd_ps(sum, sum);
+    return _mm_cvtss_f32(sum) + dotFp16Scalar(q + i, v + i, dim - i);
+}
+
+__attribute__((target("avx512f"))) inline float dotFp16Avx512(const float* q, const uint16_t* v, size_t dim) {
+    __m512 acc = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= dim; i += 16) {
+        __m512 vv = _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(v + i)));
+        acc = _mm512_fmadd_ps(_mm512_loadu_ps(q + i), vv, acc);
+    }
+    return _mm512_reduce_add_ps(acc) + dotFp16Scalar(q + i, v + i, dim - i);
+}
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Instruction set used by the kernels, detected once
+enum class SimdLevel { Scalar, Avx2, Avx512 };
+
+inline SimdLevel detectSimdLevel() {
+#ifdef EMBEDDING_STORE_X86
+    static const SimdLevel level = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::Avx512;
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::Avx2;
+        return SimdLevel::Scalar;
+    }();
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+inline const char* simdLevelName(SimdLevel level) {
+    return level == SimdLevel::Avx512 ? "avx512" : level == SimdLevel::Avx2 ? "avx2" : "scalar";
+}
+
+inline int32_t dotInt8(const int8_t* a, const int8_t* b, size_t dim, SimdLevel level) {
+#ifdef EMBEDDING_STORE_X86
+    if (level == SimdLevel::Avx512) return dotInt8Avx512(a, b, dim);
+    if (level == SimdLevel::Avx2) return dotInt8Avx2(a, b, dim);
+#endif
+    (void)level;
+    return dotInt8Scalar(a, b, dim);
+}
+
+inline float dotFp16(const float* q, const uint16_t* v, size_t dim, SimdLevel level) {
+#ifdef EMBEDDING_STORE_X86
+    if (level == SimdLevel::Avx512) return dotFp16Avx512(q, v, dim);
+    if (level == SimdLevel::Avx2) return dotFp16Avx2(q, v, dim);
+#endif
+    (void)level;
+    return dotFp16Scalar(q, v, dim);
+}
+
+// Writer: quantize normalized vectors into docID slots
+inline uint64_t writeEmbeddingStore(const std::string& path, const EmbeddingMatrix& vectors,
+                                    const std::vector<uint32_t>& doc_ids, Quantization quantization) {
+    if (vectors.size() != doc_ids.size()) {
+        throw std::runtime_error("Embedding store error: vector and docID counts differ.");
+    }
+    uint32_t num_slots = 0;
+    for (uint32_t id : doc_ids) num_slots = std::max(num_slots, id + 1);
+    size_t dim = vectors.dim;
+    size_t code_bytes = quantization == Quantization::Int8 ? dim : dim * sizeof(uint16_t);
+
+    EmbeddingStoreHeader header{};
+    header.magic = EMBEDDING_STORE_MAGIC;
+    header.version = EMBEDDING_STORE_VERSION;
+    header.dim = static_cast<uint32_t>(dim);
+    header.quantization = static_cast<uint32_t>(quantization);
+    header.num_slots = num_slots;
+    header.stride = static_cast<uint32_t>(alignTo64(code_bytes));
+    header.present_offset = alignTo64(sizeof(header));
+    header.scales_offset = alignTo64(header.present_offset + (num_slots + 63) / 64 * sizeof(uint64_t));
+    header.codes_offset = alignTo64(header.scales_offset + static_cast<uint64_t>(num_slots) * sizeof(float));
+    header.file_size = header.codes_offset + static_cast<uint64_t>(num_slots) * header.stride;
+
+    std::vector<uint64_t> present((num_slots + 63) / 64, 0);
+    std::vector<float> scales(num_slots, 0.0f);
+    std::vector<char> codes(static_cast<size_t>(num_slots) * header.stride, 0);
+    std::vector<float> unit(dim);
+    for (size_t i = 0; i < vectors.size(); ++i) {
+        uint32_t doc = doc_ids[i];
+        present[doc / 64] |= uint64_t(1) << (doc % 64);
+        std::copy(vectors.row(i), vectors.row(i) + dim, unit.begin());
+        normalizeVector(unit.data(), dim);
+        char* slot = codes.data() + static_cast<size_t>(doc) * header.stride;
+        if (quantization == Quantization::Int8) {
+            scales[doc] = quantizeInt8(unit.data(), dim, reinterpret_cast<int8_t*>(slot));
+        } else {
+            uint16_t* halves = reinterpret_cast<uint16_t*>(slot);
+            for (size_t d = 0; d < dim; ++d) halves[d] = floatToHalf(unit[d]);
+            scales[doc] = 1.0f;
+        }
+    }
+
+    std::ofstream out(path, std::ios::binary);
+    if (!out.is_open()) {
+        throw std::runtime_error("Failed to create embedding store: " + path);
+    }
+    auto pad_to = [&out](uint64_t offset) {
+        uint64_t pos = static_cast<uint64_t>(out.tellp());
+        static const char zeros[64] = {};
+        if (offset > pos) out.write(zeros, static_cast<std::streamsize>(offset - pos));
+    };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    pad_to(header.present_offset);
+    out.write(reinterpret_cast<const char*>(present.data()), present.size() * sizeof(uint64_t));
+    pad_to(header.scales_offset);
+    out.write(reinterpret_cast<const char*>(scales.data()), scales.size() * sizeof(float));
+    pad_to(header.codes_offset);
+    out.write(codes.data(), codes.size());
+    if (!out) {
+        throw std::runtime_error("Failed to write embedding store: " + path);
+    }
+    return header.file_size;
+}
+
+// Read-only view of an embedding store
+class EmbeddingStore {
+public:
+    // A query prepared once for the store's format: normalized, and quantized for int8 stores
+    struct PreparedQuery {
+        std::vector<float> values;
+        std::vector<int8_t> codes;
+        float scale = 1.0f;
+    };
+
+    EmbeddingStore() = default;
+    EmbeddingStore(const EmbeddingStore&) = delete;
+    EmbeddingStore& operator=(const EmbeddingStore&) = delete;
+    ~EmbeddingStore() { close(); }
+
+    bool open(const std::string& path) {
+        close();
+#ifdef EMBEDDING_STORE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(EmbeddingStoreHeader))) {
+            ::close(fd);
+            return false;
+        }
+        void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (mapped == MAP_FAILED) return false;
+        mapped_ = mapped;
+        mapped_size_ = static_cast<size_t>(st.st_size);
+        base_ = static_cast<const char*>(mapped);
+#else
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        if (!in.is_open()) return false;
+        buffer_.resize(static_cast<size_t>(in.tellg()));
+        in.seekg(0, std::ios::beg);
+        if (buffer_.size() < sizeof(EmbeddingStoreHeader) || !in.read(buffer_.data(), buffer_.size())) return false;
+        base_ = buffer_.data();
+        mapped_size_ = buffer_.size();
+#endif
+        std::memcpy(&header_, base_, sizeof(header_));
+        if (header_.magic != EMBEDDING_STORE_MAGIC || header_.version != EMBEDDING_STORE_VERSION
+            || header_.file_size > mapped_size_) {
+            close();
+            return false;
+        }
+        present_ = reinterpret_cast<const uint64_t*>(base_ + header_.present_offset);
+        scales_ = reinterpret_cast<const float*>(base_ + header_.scales_offset);
+        codes_ = base_ + header_.codes_offset;
+        level_ = detectSimdLevel();
+        return true;
+    }
+
+    void close() {
+#ifdef EMBEDDING_STORE_MMAP
+        if (mapped_) munmap(mapped_, mapped_size_);
+        mapped_ = nullptr;
+#else
+        buffer_.clear();
+#endif
+        base_ = nullptr;
+        mapped_size_ = 0;
+    }
+
+    size_t dim() const { return header_.dim; }
+    Quantization quantization() const { return static_cast<Quantization>(header_.quantization); }
+    SimdLevel simdLevel() const { return level_; }
+    size_t bytes() const { return mapped_size_; }
+
+    bool contains(uint32_t doc_id) const {
+        return doc_id < header_.num_slots && ((present_[doc_id / 64] >> (doc_id % 64)) & 1);
+    }
+
+    PreparedQuery prepare(const float* query) const {
+        PreparedQuery prepared;
+        prepared.values.assign(query, query + dim());
+        normalizeVector(prepared.values.data(), dim());
+        if (quantization() == Quantization::Int8) {
+            prepared.codes.resize(dim());
+            prepared.scale = quantizeInt8(prepared.values.data(), dim(), prepared.codes.data());
+        }
+        return prepared;
+    }
+
+    // Cosine similarity between the query and a stored docID; the caller checks contains()
+    float score(const PreparedQuery& query, uint32_t doc_id) const {
+        const char* slot = codes_ + static_cast<size_t>(doc_id) * header_.stride;
+        if (quantization() == Quantization::Int8) {
+            int32_t dot = dotInt8(query.codes.data(), reinterpret_cast<const int8_t*>(slot), dim(), level_);
+            return static_cast<float>(dot) * query.scale * scales_[doc_id];
+        }
+        return dotFp16(query.values.data(), reinterpret_cast<const uint16_t*>(slot), dim(), level_);
+    }
+
+private:
+    EmbeddingStoreHeader header_{};
+    const char* base_ = nullptr;
+    size_t mapped_size_ = 0;
+#ifdef EMBEDDING_STORE_MMAP
+    void* mapped_ = nullptr;
+#else
+    std::vector<char> buffer_;
+#endif
+    const uint64_t* present_ = nullptr;
+    const float* scales_ = nullptr;
+    const char* codes_ = nullptr;
+    SimdLevel level_ = SimdLevel::Scalar;
+};
+
+#endif // EMBEDDING_STORE_H
@@ -0,0 +1,97 @@
+#ifndef EMBEDDINGS_H
+#define EMBEDDINGS_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <fstream>
+#include <cstdint>
+#include <cmath>
+#include <stdexcept>
+
+// Flat float32 embedding file written by vector_search/export_embeddings.py from the .h5
+// passage or query embeddings.
+//
+// Layout:
+//   header:   magic u32 | version u32 | count u32 | dim u32
+//   ids:      count x u32 (MS MARCO passage or query ID)
+//   vectors:  count x dim x f32, row-major, in the same order as ids
+
+const uint32_t EMBEDDINGS_MAGIC = 0x31424D45; // "EMB1"
+const uint32_t EMBEDDINGS_VERSION = 1;
+
+struct EmbeddingMatrix {
+    uint32_t dim = 0;
+    std::vector<uint32_t> ids;
+    std::vector<float> values;
+
+    size_t size() const { return ids.size(); }
+    const float* row(size_t i) const { return values.data() + i * dim; }
+    float* row(size_t i) { return values.data() + i * dim; }
+};
+
+// Load an embedding file; throws on a missing or malformed file
+inline EmbeddingMatrix loadEmbeddings(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.is_open()) {
+        throw std::runtime_error("Failed to open embeddings file: " + path);
+    }
+    uint32_t header[4];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != EMBEDDINGS_MAGIC) {
+        throw std::runtime_error("Not an embeddings file: " + path);
+    }
+    if (header[1] != EMBEDDINGS_VERSION || header[3] == 0) {
+        throw std::runtime_error("Unsupported embeddings file version or dimension: " + path);
+    }
+
+    EmbeddingMatrix matrix;
+    matrix.dim = header[3];
+    matrix.ids.resize(header[2]);
+    matrix.values.resize(static_cast<size_t>(header[2]) * matrix.dim);
+    in.read(reinterpret_cast<char*>(matrix.ids.data()), matrix.ids.size() * sizeof(uint32_t));
+    in.read(reinterpret_cast<char*>(matrix.values.data()), matrix.values.size() * sizeof(float));
+    if (!in) {
+        throw std::runtime_error("Truncated embeddings file: " + path);
+    }
+    return matrix;
+}
+
+// Map passage IDs to the index's docIDs through a reorder doc map (docID -> passage ID).
+// Rows whose passage is not in the map are dropped; returns the number dropped.
+inline size_t remapToDocIds(EmbeddingMatrix& matrix, const std::unordered_map<uint32_t, uint32_t>& doc_map,
+                            std::vector<uint32_t>& doc_ids) {
+    std::unordered_map<uint32_t, uint32_t> original_to_doc;
+    for (const auto& [doc_id, original_id] : doc_map) {
+        original_to_doc[original_id] = doc_id;
+    }
+    EmbeddingMatrix kept;
+    kept.dim = matrix.dim;
+    doc_ids.clear();
+    for (size_t i = 0; i < matrix.size(); ++i) {
+        auto it = original_to_doc.find(matrix.ids[i]);
+        if (it == original_to_doc.end()) continue;
+        kept.ids.push_back(matrix.ids[i]);
+        kept.values.insert(kept.values.end(), matrix.row(i), matrix.row(i) + matrix.dim);
+        doc_ids.push_back(it->second);
+    }
+    size_t dropped = matrix.size() - kept.size();
+    matrix = std::move(kept);
+    return dropped;
+}
+
+// Scale a vector to unit length so inner product equals cosine similarity
+inline void normalizeVector(float* v, size_t dim) {
+    double norm = 0.0;
+    for (size_t i = 0; i < dim; ++i) norm += static_cast<double>(v[i]) * v[i];
+    if (norm <= 0.0) return;
+    float scale = static_cast<float>(1.0 / std::sqrt(norm));
+    for (size_t i = 0; i < dim; ++i) v[i] *= scale;
+}
+
+inline float dotProduct(const float* a, const float* b, size_t dim) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < dim; ++i) sum += a[i] * b[i];
+    return sum;
+}
+
+#endif // EMBEDDINGS_H
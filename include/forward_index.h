@@ -0,0 +1,170 @@
+#ifndef FORWARD_INDEX_H
+#define FORWARD_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+#include "varbyte.h"
+#include "tokenizer.h"
+
+// Forward index record for one passage (forward.bin), addressed from the page table.
+//
+//   num_unique (varbyte) | num_unique x term hash (4 bytes LE) |
+//   num_tokens (varbyte) | num_tokens x [local term index (varbyte), start offset gap (varbyte)]
+//
+// Tokens reference a per-document dictionary of term hashes, so most token entries take
+// two bytes. Offsets are byte positions of each token's word in the raw passage text.
+
+struct ForwardRecord {
+    std::vector<uint32_t> term_hashes;  // per-document dictionary
+    std::vector<uint32_t> token_terms;  // index into term_hashes, per token
+    std::vector<uint32_t> offsets;      // start byte of each token's word in the passage
+};
+
+// Encode the tokens (and word offsets) of a passage into a forward record
+inline void encodeForwardRecord(const std::vector<std::string>& tokens, const std::vector<uint32_t>& offsets,
+                                std::vector<uint8_t>& encoded) {
+    std::unordered_map<std::string, uint32_t> local_ids;
+    std::vector<uint32_t> hashes;
+    std::vector<uint32_t> token_terms;
+    token_terms.reserve(tokens.size());
+    for (const auto& token : tokens) {
+        auto [it, inserted] = local_ids.emplace(token, static_cast<uint32_t>(hashes.size()));
+        if (inserted) {
+            hashes.push_back(hash_term(token));
+        }
+        token_terms.push_back(it->second);
+    }
+
+    encodeVarByteSingle(static_cast<uint32_t>(hashes.size()), encoded);
+    for (uint32_t h : hashes) {
+        for (int shift = 0; shift < 32; shift += 8) {
+            encoded.push_back(static_cast<uint8_t>(h >> shift));
+        }
+    }
+    encodeVarByteSingle(static_cast<uint32_t>(tokens.size()), encoded);
+    uint32_t prev_offset = 0;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        encodeVarByteSingle(token_terms[i], encoded);
+        encodeVarByteSingle(offsets[i] - prev_offset, encoded);
+        prev_offset = offsets[i];
+    }
+}
+
+// Decode a forward record produced by encodeForwardRecord
+inline ForwardRecord decodeForwardRecord(const std::vector<uint8_t>& encoded) {
+    ForwardRecord record;
+    size_t index = 0;
+    uint32_t num_unique = decodeVarByteSingle(encoded, index);
+    if (index + 4 * static_cast<size_t>(num_unique) > encoded.size()) {
+        throw std::runtime_error("Forward record error: truncated term dictionary.");
+    }
+    record.term_hashes.resize(num_unique);
+    for (uint32_t i = 0; i < num_unique; ++i) {
+        uint32_t h = 0;
+        for (int shift = 0; shift < 32; shift += 8) {
+            h |= static_cast<uint32_t>(encoded[index++]) << shift;
+        }
+        record.term_hashes[i] = h;
+    }
+
+    uint32_t num_tokens = decodeVarByteSingle(encoded, index);
+    record.token_terms.reserve(num_tokens);
+    record.offsets.reserve(num_tokens);
+    uint32_t offset = 0;
+    for (uint32_t i = 0; i < num_tokens; ++i) {
+        uint32_t term = decodeVarByteSingle(encoded, index);
+        if (term >= num_unique) {
+            throw std::runtime_error("Forward record error: token refers past the term dictionary.");
+        }
+        offset += decodeVarByteSingle(encoded, index);
+        record.token_terms.push_back(term);
+        record.offsets.push_back(offset);
+    }
+    return record;
+}
+
+// Build a query-biased snippet: the window of `window` tokens covering the most distinct
+// query terms (then the most query term hits), with matching words wrapped in **bold**.
+// Only the chosen window of the passage text is scanned.
+inline std::string buildSnippet(const std::string& passage, const ForwardRecord& record,
+                                const std::vector<uint32_t>& query_hashes, size_t window) {
+    size_t num_tokens = record.token_terms.size();
+    if (num_tokens == 0 || window == 0) {
+        return passage;
+    }
+    window = std::min(window, num_tokens);
+
+    // Which query term (if any) each dictionary entry is
+    std::vector<int> query_slot(record.term_hashes.size(), -1);
+    for (size_t t = 0; t < record.term_hashes.size(); ++t) {
+        for (size_t q = 0; q < query_hashes.size(); ++q) {
+            if (record.term_hashes[t] == query_hashes[q]) {
+                query_slot[t] = static_cast<int>(q);
+                break;
+            }
+        }
+    }
+
+    // Slide the window, tracking per-query-term hit counts inside it
+    std::vector<uint32_t> in_window(query_hashes.size(), 0);
+    size_t distinct = 0, hits = 0;
+    auto add = [&](size_t pos, int delta) {
+        int q = query_slot[record.token_terms[pos]];
+        if (q < 0) return;
+        if (delta > 0) {
+            if (in_window[q]++ == 0) distinct++;
+            hits++;
+        } else {
+            if (--in_window[q] == 0) distinct--;
+            hits--;
+        }
+    };
+
+    for (size_t pos = 0; pos < window; ++pos) add(pos, +1);
+    size_t best_start = 0, best_distinct = distinct, best_hits = hits;
+    for (size_t start = 1; start + window <= num_tokens; ++start) {
+        add(start - 1, -1);
+        add(start + window - 1, +1);
+        if (distinct > best_distinct || (distinct == best_distinct && hits > best_hits)) {
+            best_start = start;
+            best_distinct = distinct;
+            best_hits = hits;
+        }
+    }
+
+    // Word end: first whitespace after the word start
+    auto word_end = [&](size_t from) {
+        while (from < passage.size() && !std::isspace(static_cast<unsigned char>(passage[from]))) ++from;
+        return from;
+    };
+
+    size_t best_end = best_start + window; // exclusive, in tokens
+    size_t text_end = word_end(record.offsets[best_end - 1]);
+    std::string snippet;
+    if (best_start > 0) snippet += "... ";
+    size_t cursor = record.offsets[best_start];
+    for (size_t pos = best_start; pos < best_end; ++pos) {
+        size_t start = record.offsets[pos];
+        if (start > passage.size()) break; // stale forward record; stop rather than read past the text
+        snippet.append(passage, cursor, start - cursor);
+        size_t end = word_end(start);
+        if (query_slot[record.token_terms[pos]] >= 0) {
+            snippet += "**";
+            snippet.append(passage, start, end - start);
+            snippet += "**";
+        } else {
+            snippet.append(passage, start, end - start);
+        }
+        cursor = end;
+    }
+    if (text_end < passage.size()) snippet += " ...";
+    return snippet;
+}
+
+#endif // FORWARD_INDEX_H
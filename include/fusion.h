@@ -0,0 +1,63 @@
+#ifndef FUSION_H
+#define FUSION_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+
+// Rank fusion of a lexical (BM25) and a dense result list. Both inputs are (docID, score)
+// sorted best first; only the first `depth` entries of each take part.
+
+typedef std::vector<std::pair<uint32_t, double>> RankedList;
+
+// Function to sort best first; ties go to the lower docID, as everywhere else in the engine
+inline void sortByScore(RankedList& list) {
+    std::sort(list.begin(), list.end(), [](const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    });
+}
+
+// Reciprocal rank fusion: sum of 1 / (k + rank) over the lists a document appears in
+inline RankedList fuseReciprocalRank(const RankedList& lexical, const RankedList& dense, size_t depth, double k = 60.0) {
+    std::unordered_map<uint32_t, double> fused;
+    for (const RankedList* list : {&lexical, &dense}) {
+        size_t n = std::min(depth, list->size());
+        for (size_t rank = 0; rank < n; ++rank) {
+            fused[(*list)[rank].first] += 1.0 / (k + static_cast<double>(rank + 1));
+        }
+    }
+    RankedList result(fused.begin(), fused.end());
+    sortByScore(result);
+    return result;
+}
+
+// Linear interpolation of min-max normalized scores: alpha * lexical + (1 - alpha) * dense.
+// A document missing from one list gets that list's minimum (0 after normalization).
+inline RankedList fuseLinear(const RankedList& lexical, const RankedList& dense, size_t depth, double alpha) {
+    auto normalized = [depth](const RankedList& list) {
+        std::unordered_map<uint32_t, double> scores;
+        size_t n = std::min(depth, list.size());
+        if (n == 0) return scores;
+        double lo = list[0].second, hi = list[0].second;
+        for (size_t i = 0; i < n; ++i) {
+            lo = std::min(lo, list[i].second);
+            hi = std::max(hi, list[i].second);
+        }
+        for (size_t i = 0; i < n; ++i) {
+            scores[list[i].first] = (hi > lo) ? (list[i].second - lo) / (hi - lo) : 1.0;
+        }
+        return scores;
+    };
+    std::unordered_map<uint32_t, double> lexical_norm = normalized(lexical);
+    std::unordered_map<uint32_t, double> dense_norm = normalized(dense);
+
+    std::unordered_map<uint32_t, double> fused;
+    for (const auto& [doc, score] : lexical_norm) fused[doc] += alpha * score;
+    for (const auto& [doc, score] : dense_norm) fused[doc] += (1.0 - alpha) * score;
+    RankedList result(fused.begin(), fused.end());
+    sortByScore(result);
+    return result;
+}
+
+#endif // FUSION_H
@@ -0,0 +1,373 @@
+#ifndef HNSW_H
+#define HNSW_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstdint>
+#include <stdexcept>
+
+#include "embeddings.h"
+
+// In-process HNSW graph over unit-length passage embeddings (hnsw.bin), searched by inner
+// product. Nodes carry the index's internal docID, so results join directly with BM25.
+//
+// Layout:
+//   header:       magic u32 | version u32 | count u32 | dim u32 | M u32 | max_level i32 | entry u32 | pad u32
+//   doc ids:      count x u32
+//   levels:       count x u8
+//   vectors:      count x dim x f32
+//   level 0:      count x (1 + 2M) u32, each [neighbor count, neighbors...]
+//   upper levels: for each node with level > 0, level x (1 + M) u32
+
+const uint32_t HNSW_MAGIC = 0x57534E48; // "HNSW"
+const uint32_t HNSW_VERSION = 1;
+
+struct HnswHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t dim;
+    uint32_t M;
+    int32_t max_level;
+    uint32_t entry;
+    uint32_t pad;
+};
+
+class HnswIndex {
+public:
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+    size_t size() const { return doc_ids_.size(); }
+    size_t dim() const { return dim_; }
+
+    // Build the graph over `vectors` (normalized in place) with `threads` concurrent inserters
+    void build(EmbeddingMatrix vectors, std::vector<uint32_t> doc_ids, size_t M, size_t ef_construction, unsigned threads) {
+        if (vectors.size() != doc_ids.size()) {
+            throw std::runtime_error("HNSW build error: vector and docID counts differ.");
+        }
+        dim_ = vectors.dim;
+        M_ = std::max<size_t>(2, M);
+        ef_construction_ = std::max(ef_construction, M_);
+        vectors_ = std::move(vectors.values);
+        doc_ids_ = std::move(doc_ids);
+        size_t n = doc_ids_.size();
+        for (size_t i = 0; i < n; ++i) normalizeVector(vectorAt(i), dim_);
+
+        // Levels are drawn up front so every node's link storage exists before threads start
+        std::mt19937_64 rng(100);
+        std::uniform_real_distribution<double> unit(std::numeric_limits<double>::min(), 1.0);
+        double level_mult = 1.0 / std::log(static_cast<double>(M_));
+        levels_.resize(n);
+        upper_.assign(n, {});
+        for (size_t i = 0; i < n; ++i) {
+            int level = std::min(static_cast<int>(-std::log(unit(rng)) * level_mult), 255);
+            levels_[i] = static_cast<uint8_t>(level);
+            if (level > 0) upper_[i].assign(level * (M_ + 1), 0);
+        }
+        links0_.assign(n * (2 * M_ + 1), 0);
+        buildNodeIndex();
+        if (n == 0) return;
+
+        entry_ = 0;
+        max_level_ = levels_[0];
+        std::vector<std::mutex> node_locks(n);
+        std::mutex entry_lock;
+        std::atomic<size_t> next(1);
+        auto worker = [&]() {
+            for (size_t i = next++; i < n; i = next++) {
+                insert(static_cast<uint32_t>(i), node_locks, entry_lock);
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned t = 1; t < std::max(1u, threads); ++t) pool.emplace_back(worker);
+        worker();
+        for (auto& t : pool) t.join();
+    }
+
+    // k nearest passages to `query` (normalized here), as (docID, inner product) best first
+    std::vector<std::pair<uint32_t, float>> search(const float* query, size_t k, size_t ef) const {
+        std::vector<std::pair<uint32_t, float>> results;
+        if (size() == 0) return results;
+        std::vector<float> q(query, query + dim_);
+        normalizeVector(q.data(), dim_);
+
+        uint32_t cur = entry_;
+        for (int level = max_level_; level > 0; --level) {
+            cur = greedyClosest(q.data(), cur, level, nullptr);
+        }
+        MaxHeap top = searchLayer(q.data(), cur, std::max(ef, k), 0, nullptr);
+        while (top.size() > k) top.pop();
+        results.resize(top.size());
+        for (size_t i = top.size(); i-- > 0;) {
+            results[i] = {doc_ids_[top.top().second], 1.0f - top.top().first};
+            top.pop();
+        }
+        return results;
+    }
+
+    // Stored (normalized) vector of a docID, or nullptr if the docID has no embedding
+    const float* vectorForDoc(uint32_t doc_id) const {
+        if (doc_id >= node_of_doc_.size() || node_of_doc_[doc_id] == NO_NODE) return nullptr;
+        return vectorAt(node_of_doc_[doc_id]);
+    }
+
+    bool save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out.is_open()) return false;
+        HnswHeader header{HNSW_MAGIC, HNSW_VERSION, static_cast<uint32_t>(size()), static_cast<uint32_t>(dim_),
+                          static_cast<uint32_t>(M_), max_level_, entry_, 0};
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(doc_ids_.data()), doc_ids_.size() * sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(levels_.data()), levels_.size());
+        out.write(reinterpret_cast<const char*>(vectors_.data()), vectors_.size() * sizeof(float));
+        out.write(reinterpret_cast<const char*>(links0_.data()), links0_.size() * sizeof(uint32_t));
+        for (const auto& links : upper_) {
+            out.write(reinterpret_cast<const char*>(links.data()), links.size() * sizeof(uint32_t));
+        }
+        return static_cast<bool>(out);
+    }
+
+    bool load(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open()) return false;
+        HnswHeader header;
+        if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != HNSW_MAGIC
+            || header.version != HNSW_VERSION) {
+            return false;
+        }
+        size_t n = header.count;
+        dim_ = header.dim;
+        M_ = header.M;
+        max_level_ = header.max_level;
+        entry_ = header.entry;
+        doc_ids_.resize(n);
+        levels_.resize(n);
+        vectors_.resize(n * dim_);
+        links0_.resize(n * (2 * M_ + 1));
+        in.read(reinterpret_cast<char*>(doc_ids_.data()), n * sizeof(uint32_t));
+        in.read(reinterpret_cast<char*>(levels_.data()), n);
+        in.read(reinterpret_cast<char*>(vectors_.data()), vectors_.size() * sizeof(float));
+        in.read(reinterpret_cast<char*>(links0_.data()), links0_.size() * sizeof(uint32_t));
+        upper_.assign(n, {});
+        for (size_t i = 0; i < n; ++i) {
+            if (levels_[i] == 0) continue;
+            upper_[i].resize(levels_[i] * (M_ + 1));
+            in.read(reinterpret_cast<char*>(upper_[i].data()), upper_[i].size() * sizeof(uint32_t));
+        }
+        if (!in || !validate()) return false;
+        buildNodeIndex();
+        return true;
+    }
+
+private:
+    // (distance, node) with distance = 1 - inner product, so smaller is closer
+    typedef std::pair<float, uint32_t> Candidate;
+    typedef std::priority_queue<Candidate> MaxHeap;
+    typedef std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> MinHeap;
+
+    float* vectorAt(size_t node) { return vectors_.data() + node * dim_; }
+    const float* vectorAt(size_t node) const { return vectors_.data() + node * dim_; }
+
+    // Function to check a loaded graph before it is searched: the entry point reaches the top
+    // level, and every neighbor list fits its slot and names a node present at that level
+    bool validate() const {
+        size_t n = size();
+        if (n == 0) return true;
+        if (entry_ >= n || max_level_ < 0 || levels_[entry_] != max_level_) return false;
+        for (uint32_t node = 0; node < n; ++node) {
+            if (levels_[node] > max_level_) return false;
+            for (int level = 0; level <= levels_[node]; ++level) {
+                const uint32_t* slot = links(node, level);
+                if (slot[0] > maxLinks(level)) return false;
+                for (uint32_t i = 1; i <= slot[0]; ++i) {
+                    if (slot[i] >= n || levels_[slot[i]] < level) return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    float distance(const float* q, uint32_t node) const {
+        return 1.0f - dotProduct(q, vectorAt(node), dim_);
+    }
+
+    // Neighbor slot of a node at a level: [count, neighbors...]
+    uint32_t* links(uint32_t node, int level) {
+        return level == 0 ? &links0_[node * (2 * M_ + 1)] : &upper_[node][(level - 1) * (M_ + 1)];
+    }
+    const uint32_t* links(uint32_t node, int level) const {
+        return level == 0 ? &links0_[node * (2 * M_ + 1)] : &upper_[node][(level - 1) * (M_ + 1)];
+    }
+    size_t maxLinks(int level) const { return level == 0 ? 2 * M_ : M_; }
+
+    // Copy of a node's neighbor list, taken under the node's lock while the graph is being built
+    void neighbors(uint32_t node, int level, std::vector<std::mutex>* locks, std::vector<uint32_t>& out) const {
+        std::unique_lock<std::mutex> guard;
+        if (locks) guard = std::unique_lock<std::mutex>((*locks)[node]);
+        const uint32_t* list = links(node, level);
+        out.assign(list + 1, list + 1 + list[0]);
+    }
+
+    uint32_t greedyClosest(const float* q, uint32_t cur, int level, std::vector<std::mutex>* locks) const {
+        float cur_dist = distance(q, cur);
+        std::vector<uint32_t> adjacent;
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            neighbors(cur, level, locks, adjacent);
+            for (uint32_t next : adjacent) {
+                float d = distance(q, next);
+                if (d < cur_dist) {
+                    cur_dist = d;
+                    cur = next;
+                    changed = true;
+                }
+            }
+        }
+        return cur;
+    }
+
+    // Best-first search of one layer; returns up to ef closest nodes (farthest on top)
+    MaxHeap searchLayer(const float* q, uint32_t entry, size_t ef, int level, std::vector<std::mutex>* locks) const {
+        // Per-thread visited marks, cleared by bumping the generation instead of zeroing
+        thread_local std::vector<uint32_t> visited;
+        thread_local uint32_t generation = 0;
+        if (visited.size() < size()) visited.assign(size(), 0);
+        if (++generation == 0) {
+            std::fill(visited.begin(), visited.end(), 0);
+            generation = 1;
+        }
+
+        MaxHeap top;
+        MinHeap candidates;
+        float d = distance(q, entry);
+        top.emplace(d, entry);
+        candidates.emplace(d, entry);
+        visited[entry] = generation;
+
+        std::vector<uint32_t> adjacent;
+        while (!candidates.empty()) {
+            Candidate c = candidates.top();
+            if (c.first > top.top().first && top.size() >= ef) break;
+            candidates.pop();
+            neighbors(c.second, level, locks, adjacent);
+            for (uint32_t next : adjacent) {
+                if (visited[next] == generation) continue;
+                visited[next] = generation;
+                float nd = distance(q, next);
+                if (top.size() < ef || nd < top.top().first) {
+                    candidates.emplace(nd, next);
+                    top.emplace(nd, next);
+                    if (top.size() > ef) top.pop();
+                }
+            }
+        }
+        return top;
+    }
+
+    // Neighbor selection heuristic: keep a candidate only if it is closer to the base than to
+    // every neighbor already kept, which spreads links across directions
+    std::vector<uint32_t> selectNeighbors(std::vector<Candidate> candidates, size_t limit) const {
+        std::sort(candidates.begin(), candidates.end());
+        std::vector<uint32_t> selected;
+        for (const auto& [dist, node] : candidates) {
+            if (selected.size() >= limit) break;
+            bool keep = true;
+            for (uint32_t s : selected) {
+                if (1.0f - dotProduct(vectorAt(node), vectorAt(s), dim_) < dist) {
+                    keep = false;
+                    break;
+                }
+            }
+            if (keep) selected.push_back(node);
+        }
+        return selected;
+    }
+
+    void insert(uint32_t node, std::vector<std::mutex>& node_locks, std::mutex& entry_lock) {
+        int level = levels_[node];
+        std::unique_lock<std::mutex> entry_guard(entry_lock);
+        uint32_t cur = entry_;
+        int top_level = max_level_;
+        // A node that raises the top level keeps the entry lock so no one else descends from a stale entry
+        if (level <= top_level) entry_guard.unlock();
+
+        const float* q = vectorAt(node);
+        for (int l = top_level; l > level; --l) {
+            cur = greedyClosest(q, cur, l, &node_locks);
+        }
+        for (int l = std::min(level, top_level); l >= 0; --l) {
+            MaxHeap found = searchLayer(q, cur, ef_construction_, l, &node_locks);
+            std::vector<Candidate> candidates;
+            while (!found.empty()) {
+                candidates.push_back(found.top());
+                found.pop();
+            }
+            cur = candidates.back().second; // closest
+            std::vector<uint32_t> chosen = selectNeighbors(candidates, M_);
+            {
+                std::lock_guard<std::mutex> guard(node_locks[node]);
+                uint32_t* list = links(node, l);
+                list[0] = static_cast<uint32_t>(chosen.size());
+                std::copy(chosen.begin(), chosen.end(), list + 1);
+            }
+            for (uint32_t other : chosen) {
+                addLink(other, node, l, node_locks);
+            }
+        }
+        if (level > top_level) {
+            entry_ = node;
+            max_level_ = level;
+        }
+    }
+
+    // Add a back link, re-running the heuristic when the neighbor list is full
+    void addLink(uint32_t from, uint32_t to, int level, std::vector<std::mutex>& node_locks) {
+        std::lock_guard<std::mutex> guard(node_locks[from]);
+        uint32_t* list = links(from, level);
+        size_t limit = maxLinks(level);
+        if (list[0] < limit) {
+            list[1 + list[0]++] = to;
+            return;
+        }
+        std::vector<Candidate> candidates;
+        const float* base = vectorAt(from);
+        candidates.emplace_back(distance(base, to), to);
+        for (uint32_t i = 0; i < list[0]; ++i) {
+            candidates.emplace_back(distance(base, list[1 + i]), list[1 + i]);
+        }
+        std::vector<uint32_t> chosen = selectNeighbors(candidates, limit);
+        list[0] = static_cast<uint32_t>(chosen.size());
+        std::copy(chosen.begin(), chosen.end(), list + 1);
+    }
+
+    void buildNodeIndex() {
+        uint32_t max_doc = 0;
+        for (uint32_t id : doc_ids_) max_doc = std::max(max_doc, id);
+        node_of_doc_.assign(doc_ids_.empty() ? 0 : static_cast<size_t>(max_doc) + 1, NO_NODE);
+        for (size_t i = 0; i < doc_ids_.size(); ++i) node_of_doc_[doc_ids_[i]] = static_cast<uint32_t>(i);
+    }
+
+    size_t dim_ = 0;
+    size_t M_ = 16;
+    size_t ef_construction_ = 100;
+    int max_level_ = 0;
+    uint32_t entry_ = 0;
+    std::vector<float> vectors_;
+    std::vector<uint32_t> doc_ids_;
+    std::vector<uint8_t> levels_;
+    std::vector<uint32_t> links0_;
+    std::vector<std::vector<uint32_t>> upper_;
+    std::vector<uint32_t> node_of_doc_;
+};
+
+#endif // HNSW_H
@@ -0,0 +1,141 @@
+#ifndef INDEX_READER_H
+#define INDEX_READER_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <stdexcept>
+
+#include "varbyte.h"
+
+// Read side of the on-disk index: lexicon, page table, docID map and per-term posting lists in
+// final_index.bin (collection statistics and document lengths are in collection_stats.h).
+// Shared by the query processor and the benchmarks.
+
+// Structure for Lexicon Entry
+struct LexiconEntry {
+    uint64_t docid_offset;
+    size_t docid_length;
+    uint64_t freq_offset;
+    size_t freq_length;
+    size_t doc_freq; // Number of documents containing the term
+    uint64_t pos_offset = 0; // positions.bin range; zero length if the index has no positions
+    size_t pos_length = 0;
+    uint64_t coll_freq = 0; // Occurrences in the collection; 0 in lexicons written before it
+    uint32_t pruned_max_freq = 0;   // Pruned tier only: largest freq among the left-out postings (0: none left out)
+    uint32_t pruned_min_length = 0; // Pruned tier only: shortest document among the left-out postings
+};
+
+// Structure for Document Information
+struct DocumentInfo {
+    uint32_t docID;
+    uint64_t passage_offset;
+    size_t passage_length;
+    uint64_t forward_offset = 0; // record in forward.bin (older page tables have none)
+    size_t forward_length = 0;
+};
+
+// Function to load lexicon
+inline bool load_lexicon(const std::string& lexicon_file, std::unordered_map<std::string, LexiconEntry>& lexicon) {
+    std::ifstream infile(lexicon_file);
+    if(!infile.is_open()) {
+        std::cerr << "Error: Failed to open lexicon file: " << lexicon_file << std::endl;
+        return false;
+    }
+
+    std::string line;
+    std::string term;
+    while(std::getline(infile, line)) {
+        std::istringstream iss(line);
+        LexiconEntry entry;
+        if(!(iss >> term >> entry.docid_offset >> entry.docid_length >> entry.freq_offset >> entry.freq_length >> entry.doc_freq)) {
+            continue;
+        }
+        // Zero positions range without --positions; the pruning bound only in a pruned tier
+        iss >> entry.pos_offset >> entry.pos_length >> entry.coll_freq >> entry.pruned_max_freq >> entry.pruned_min_length;
+        lexicon[term] = entry;
+    }
+
+    infile.close();
+    return true;
+}
+
+// Function to load page table
+inline bool load_page_table(const std::string& page_table_file, std::unordered_map<uint32_t, DocumentInfo>& page_table) {
+    std::ifstream infile(page_table_file);
+    if(!infile.is_open()) {
+        std::cerr << "Error: Failed to open page table file: " << page_table_file << std::endl;
+        return false;
+    }
+
+    std::string line;
+    while(std::getline(infile, line)) {
+        std::istringstream iss(line);
+        DocumentInfo doc_info;
+        if(!(iss >> doc_info.docID >> doc_info.passage_offset >> doc_info.passage_length)) {
+            continue;
+        }
+        iss >> doc_info.forward_offset >> doc_info.forward_length;
+        page_table[doc_info.docID] = doc_info;
+    }
+
+    infile.close();
+    return true;
+}
+
+// Function to load the docID map written by reorder (internal docID -> original passage ID)
+inline bool load_doc_map(const std::string& doc_map_file, std::unordered_map<uint32_t, uint32_t>& doc_map) {
+    std::ifstream infile(doc_map_file);
+    if(!infile.is_open()) {
+        std::cerr << "Error: Failed to open doc map file: " << doc_map_file << std::endl;
+        return false;
+    }
+
+    uint32_t docID, original_id;
+    while(infile >> docID >> original_id) {
+        doc_map[docID] = original_id;
+    }
+
+    infile.close();
+    return true;
+}
+
+// Function to read a term's encoded docID and frequency lists from final_index.bin
+inline bool read_encoded_postings(std::ifstream& index_file, const LexiconEntry& entry,
+                                  std::vector<uint8_t>& encoded_docids, std::vector<uint8_t>& encoded_freqs) {
+    encoded_docids.resize(entry.docid_length);
+    encoded_freqs.resize(entry.freq_length);
+    index_file.clear();
+    index_file.seekg(entry.docid_offset, std::ios::beg);
+    if(!index_file.read(reinterpret_cast<char*>(encoded_docids.data()), entry.docid_length)) {
+        return false;
+    }
+    index_file.seekg(entry.freq_offset, std::ios::beg);
+    return static_cast<bool>(index_file.read(reinterpret_cast<char*>(encoded_freqs.data()), entry.freq_length));
+}
+
+// Function to decode a posting list into absolute docIDs and frequencies; throws on corrupt input
+inline void decode_postings(const std::vector<uint8_t>& encoded_docids, const std::vector<uint8_t>& encoded_freqs,
+                            size_t doc_freq, std::vector<uint32_t>& doc_ids, std::vector<uint32_t>& freqs) {
+    size_t index_pos = 0;
+    doc_ids = decodeVarByteList(encoded_docids, index_pos, doc_freq);
+
+    // Reconstruct original docIDs from gaps
+    uint32_t prev_doc_id = 0;
+    for(auto& doc_id : doc_ids) {
+        doc_id += prev_doc_id;
+        prev_doc_id = doc_id;
+    }
+
+    index_pos = 0;
+    freqs = decodeVarByteList(encoded_freqs, index_pos, doc_freq);
+    if(doc_ids.size() != freqs.size()) {
+        throw std::runtime_error("Posting list error: docID and frequency counts differ.");
+    }
+}
+
+#endif // INDEX_READER_H
@@ -0,0 +1,136 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+// Byte-oriented LZ77 codec in the LZ4 style. A compressed stream is a sequence of
+// [token][literal length ext][literals][offset:2 LE][match length ext] records; the
+// token's high nibble is the literal count and its low nibble the match length minus
+// LZ_MIN_MATCH, with 15 meaning "continued in 255-run extension bytes". The final
+// record carries literals only.
+
+const size_t LZ_MIN_MATCH = 4;
+const size_t LZ_MAX_OFFSET = 65535;
+const int LZ_HASH_BITS = 14;
+
+// Hash the 4 bytes at p into the match-finder table
+inline uint32_t lzHash(const uint8_t* p) {
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Append a length extension (bytes of 255 followed by the remainder)
+inline void lzWriteLength(size_t len, std::vector<uint8_t>& out) {
+    while (len >= 255) {
+        out.push_back(255);
+        len -= 255;
+    }
+    out.push_back(static_cast<uint8_t>(len));
+}
+
+// Emit one sequence: literals [lit, lit + lit_len) followed by an optional match
+inline void lzWriteSequence(const uint8_t* lit, size_t lit_len, size_t offset, size_t match_len, std::vector<uint8_t>& out) {
+    size_t match_code = match_len ? match_len - LZ_MIN_MATCH : 0;
+    uint8_t token = static_cast<uint8_t>((lit_len >= 15 ? 15 : lit_len) << 4);
+    token |= static_cast<uint8_t>(match_code >= 15 ? 15 : match_code);
+    out.push_back(token);
+    if (lit_len >= 15) lzWriteLength(lit_len - 15, out);
+    out.insert(out.end(), lit, lit + lit_len);
+    if (match_len) {
+        out.push_back(static_cast<uint8_t>(offset & 0xFF));
+        out.push_back(static_cast<uint8_t>(offset >> 8));
+        if (match_code >= 15) lzWriteLength(match_code - 15, out);
+    }
+}
+
+// Compress src[0, size) and append the result to out
+inline void lzCompress(const uint8_t* src, size_t size, std::vector<uint8_t>& out) {
+    std::vector<uint32_t> table(size_t(1) << LZ_HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t pos = 0;
+
+    while (size >= LZ_MIN_MATCH && pos + LZ_MIN_MATCH <= size) {
+        uint32_t h = lzHash(src + pos);
+        uint32_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(pos);
+
+        if (candidate != UINT32_MAX && pos - candidate <= LZ_MAX_OFFSET &&
+            std::memcmp(src + candidate, src + pos, LZ_MIN_MATCH) == 0) {
+            size_t match_len = LZ_MIN_MATCH;
+            while (pos + match_len < size && src[candidate + match_len] == src[pos + match_len]) {
+                ++match_len;
+            }
+            lzWriteSequence(src + anchor, pos - anchor, pos - candidate, match_len, out);
+            pos += match_len;
+            anchor = pos;
+        } else {
+            ++pos;
+        }
+    }
+
+    lzWriteSequence(src + anchor, size - anchor, 0, 0, out);
+}
+
+// Read a length extension, bounds-checked against the input
+inline size_t lzReadLength(const uint8_t* src, size_t size, size_t& index) {
+    size_t len = 0;
+    uint8_t byte;
+    do {
+        if (index >= size) {
+            throw std::runtime_error("LZ decoding error: truncated length.");
+        }
+        byte = src[index++];
+        len += byte;
+    } while (byte == 255);
+    return len;
+}
+
+// Decompress src[0, size) into dst, which must hold exactly raw_size bytes
+inline void lzDecompress(const uint8_t* src, size_t size, uint8_t* dst, size_t raw_size) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < size) {
+        uint8_t token = src[in++];
+
+        size_t lit_len = token >> 4;
+        if (lit_len == 15) lit_len += lzReadLength(src, size, in);
+        if (in + lit_len > size || out + lit_len > raw_size) {
+            throw std::runtime_error("LZ decoding error: literal run out of bounds.");
+        }
+        std::memcpy(dst + out, src + in, lit_len);
+        in += lit_len;
+        out += lit_len;
+
+        if (in == size) break; // last sequence has no match
+
+        if (in + 2 > size) {
+            throw std::runtime_error("LZ decoding error: truncated match offset.");
+        }
+        size_t offset = static_cast<size_t>(src[in]) | (static_cast<size_t>(src[in + 1]) << 8);
+        in += 2;
+        size_t match_len = (token & 0x0F);
+        if (match_len == 15) match_len += lzReadLength(src, size, in);
+        match_len += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > out || out + match_len > raw_size) {
+            throw std::runtime_error("LZ decoding error: match out of bounds.");
+        }
+        // Byte-wise copy: matches may overlap their own output
+        const uint8_t* from = dst + out - offset;
+        for (size_t i = 0; i < match_len; ++i) {
+            dst[out + i] = from[i];
+        }
+        out += match_len;
+    }
+
+    if (out != raw_size) {
+        throw std::runtime_error("LZ decoding error: decoded size mismatch.");
+    }
+}
+
+#endif // LZ_H
@@ -0,0 +1,145 @@
+#ifndef MEMORY_PLACEMENT_H
+#define MEMORY_PLACEMENT_H
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Placement of the query processor's resident structures: transparent huge pages for the
+// lexicon, page table and document length tables, and binding a process to one NUMA node.
+//
+// The hash maps allocate their nodes and bucket arrays through the default allocator, so huge
+// pages are applied after loading to the anonymous memory that loading mapped (compared with a
+// snapshot taken at startup), rather than through a custom allocator threaded through every type.
+// Per-node replicas are whole processes: one query processor or shard server per node, each
+// bound with bind_to_numa_node() before it loads, so every copy is local to the CPUs using it.
+
+const size_t HUGE_PAGE_SIZE = size_t(2) << 20;
+
+#ifdef __linux__
+#ifndef MADV_COLLAPSE
+#define MADV_COLLAPSE 25 // Linux 6.1
+#endif
+const int NUMA_MPOL_BIND = 2; // MPOL_BIND from <numaif.h>, without depending on libnuma
+#endif
+
+// Function to back the whole 2 MB pages inside [addr, addr + length) with transparent huge
+// pages: MADV_HUGEPAGE for later faults, then MADV_COLLAPSE so pages touched while loading are
+// moved now instead of whenever khugepaged gets to them. Returns the bytes advised.
+inline size_t advise_huge_pages(const void* addr, size_t length) {
+#ifdef __linux__
+    uintptr_t begin = (reinterpret_cast<uintptr_t>(addr) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    uintptr_t end = (reinterpret_cast<uintptr_t>(addr) + length) & ~(HUGE_PAGE_SIZE - 1);
+    if (end <= begin) return 0;
+    if (madvise(reinterpret_cast<void*>(begin), end - begin, MADV_HUGEPAGE) != 0) return 0;
+    madvise(reinterpret_cast<void*>(begin), end - begin, MADV_COLLAPSE); // best effort on older kernels
+    return end - begin;
+#else
+    (void)addr;
+    (void)length;
+    return 0;
+#endif
+}
+
+typedef std::vector<std::pair<uintptr_t, uintptr_t>> MappingList; // [begin, end) address ranges
+
+// Function to list the process's private writable anonymous mappings and its heap: where the hash
+// maps' nodes and the large bucket arrays and tables malloc maps separately end up. Stacks are
+// left out: the main one by name, thread stacks by the PROT_NONE guard page mapped right below them.
+inline MappingList anonymous_mappings() {
+    MappingList mappings;
+#ifdef __linux__
+    std::ifstream maps("/proc/self/maps");
+    std::string line;
+    uintptr_t guard_end = 0; // end of the last inaccessible anonymous mapping
+    while (std::getline(maps, line)) {
+        std::istringstream fields(line);
+        std::string range, perms, offset, device, inode, path;
+        fields >> range >> perms >> offset >> device >> inode >> path;
+        size_t dash = range.find('-');
+        uintptr_t begin = std::stoull(range.substr(0, dash), nullptr, 16);
+        uintptr_t end = std::stoull(range.substr(dash + 1), nullptr, 16);
+        bool below_guard = begin == guard_end;
+        guard_end = perms.compare(0, 3, "---") == 0 && path.empty() ? end : 0;
+        if (perms.size() < 4 || perms[1] != 'w' || perms[3] != 'p' || (!path.empty() && path != "[heap]") || below_guard) continue;
+        mappings.emplace_back(begin, end);
+    }
+#endif
+    return mappings;
+}
+
+// Function to advise the anonymous memory mapped since `before` was taken (at startup, so only
+// what loading allocated); returns the bytes advised
+inline size_t advise_resident_huge_pages(const MappingList& before) {
+    size_t advised = 0;
+    for (const auto& mapping : anonymous_mappings()) {
+        // Subtract the earlier ranges (both lists are in address order), advising each remaining piece
+        uintptr_t begin = mapping.first;
+        for (const auto& old : before) {
+            if (old.second <= begin) continue;
+            if (old.first >= mapping.second) break;
+            if (old.first > begin && old.first - begin >= HUGE_PAGE_SIZE) {
+                advised += advise_huge_pages(reinterpret_cast<const void*>(begin), old.first - begin);
+            }
+            begin = std::max(begin, old.second);
+        }
+        if (begin < mapping.second && mapping.second - begin >= HUGE_PAGE_SIZE) {
+            advised += advise_huge_pages(reinterpret_cast<const void*>(begin), mapping.second - begin);
+        }
+    }
+    return advised;
+}
+
+// Function to run the calling thread, and the threads it starts later, on NUMA node `node`'s CPUs
+// and allocate their memory from that node only; false if the node does not exist
+inline bool bind_to_numa_node(int node) {
+#ifdef __linux__
+    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string ranges;
+    if (node < 0 || node >= 64 || !std::getline(cpulist, ranges)) {
+        std::cerr << "Error: NUMA node " << node << " not found." << std::endl;
+        return false;
+    }
+
+    // cpulist is a comma-separated list of CPUs and ranges, e.g. "0-15,32-47"
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    std::istringstream list(ranges);
+    std::string range;
+    while (std::getline(list, range, ',')) {
+        if (range.empty()) continue;
+        size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last && cpu < CPU_SETSIZE; ++cpu) CPU_SET(cpu, &cpus);
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        std::cerr << "Error: Failed to bind to the CPUs of NUMA node " << node << "." << std::endl;
+        return false;
+    }
+
+    unsigned long nodemask = 1UL << node;
+    if (syscall(SYS_set_mempolicy, NUMA_MPOL_BIND, &nodemask, sizeof(nodemask) * 8) != 0) {
+        std::cerr << "Error: Failed to bind memory to NUMA node " << node << "." << std::endl;
+        return false;
+    }
+    return true;
+#else
+    std::cerr << "Error: NUMA binding is only supported on Linux." << std::endl;
+    (void)node;
+    return false;
+#endif
+}
+
+#endif // MEMORY_PLACEMENT_H
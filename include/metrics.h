@@ -0,0 +1,240 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+// Query-time instrumentation: per-stage latency histograms and event counters.
+//
+// When disabled every hook is a single predictable branch: no clock reads, no writes.
+// Stage times are accumulated per query and recorded once per query in endQuery(), so a
+// histogram sample is "time this query spent in the stage".
+
+enum class Stage : size_t {
+    LexiconLookup,
+    IndexRead,
+    Decode,
+    Traversal,
+    TopK,
+    SnippetFetch,
+    DenseSearch, // HNSW search, dense rerank and fusion
+    Query, // whole query, end to end
+    Count
+};
+
+enum class Counter : size_t {
+    Queries,
+    PostingsDecoded,
+    PostingsScored,
+    BlocksSkipped,
+    DocCacheHits,
+    DocBlockReads,
+    TierAnswers,
+    PairLists,
+    Count
+};
+
+inline const char* stageName(Stage s) {
+    static const char* names[] = {"lexicon_lookup", "index_read", "decode", "traversal", "top_k", "snippet_fetch", "dense_search", "query"};
+    return names[static_cast<size_t>(s)];
+}
+
+inline const char* counterName(Counter c) {
+    static const char* names[] = {"queries", "postings_decoded", "postings_scored", "blocks_skipped", "doc_cache_hits", "doc_block_reads", "tier_answers", "pair_lists"};
+    return names[static_cast<size_t>(c)];
+}
+
+// HDR-style log-linear histogram over nanoseconds: exact below 64, then 32 linear
+// sub-buckets per power of two (about 3% relative error) up to 2^64.
+class LatencyHistogram {
+public:
+    static const int SUB_BITS = 5;
+    static const size_t SUB_COUNT = size_t(1) << SUB_BITS;
+    static const size_t NUM_BUCKETS = 2 * SUB_COUNT + (64 - SUB_BITS - 1) * SUB_COUNT;
+
+    void record(uint64_t value) {
+        counts_[bucketOf(value)]++;
+        count_++;
+        sum_ += value;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+
+    // Smallest recorded bucket bound below which a fraction q of the samples fall
+    uint64_t percentile(double q) const {
+        if (count_ == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(q * static_cast<double>(count_ - 1)) + 1;
+        uint64_t seen = 0;
+        for (size_t b = 0; b < NUM_BUCKETS; ++b) {
+            seen += counts_[b];
+            if (seen >= rank) return std::min(max_, upperBound(b));
+        }
+        return max_;
+    }
+
+    void merge(const LatencyHistogram& other) {
+        for (size_t b = 0; b < NUM_BUCKETS; ++b) counts_[b] += other.counts_[b];
+        count_ += other.count_;
+        sum_ += other.sum_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+    }
+
+private:
+    static size_t bucketOf(uint64_t v) {
+        if (v < 2 * SUB_COUNT) return static_cast<size_t>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return 2 * SUB_COUNT + static_cast<size_t>(shift - 1) * SUB_COUNT + static_cast<size_t>((v >> shift) - SUB_COUNT);
+    }
+
+    static uint64_t upperBound(size_t b) {
+        if (b < 2 * SUB_COUNT) return b;
+        size_t shift = (b - 2 * SUB_COUNT) / SUB_COUNT + 1;
+        uint64_t sub = (b - 2 * SUB_COUNT) % SUB_COUNT + SUB_COUNT;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<uint64_t, NUM_BUCKETS> counts_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = UINT64_MAX;
+    uint64_t max_ = 0;
+};
+
+class Metrics {
+public:
+    explicit Metrics(bool enabled = false) : enabled_(enabled) {}
+
+    bool enabled() const { return enabled_; }
+
+    void add(Counter c, uint64_t n = 1) {
+        if (enabled_) counters_[static_cast<size_t>(c)] += n;
+    }
+
+    void beginQuery() {
+        if (!enabled_) return;
+        pending_.fill(0);
+        query_start_ = std::chrono::steady_clock::now();
+    }
+
+    void endQuery() {
+        if (!enabled_) return;
+        pending_[static_cast<size_t>(Stage::Query)] = elapsedSince(query_start_);
+        for (size_t s = 0; s < static_cast<size_t>(Stage::Count); ++s) {
+            histograms_[s].record(pending_[s]);
+        }
+        counters_[static_cast<size_t>(Counter::Queries)]++;
+    }
+
+    // Adds the lifetime of the object to the current query's time in one stage
+    class ScopedTimer {
+    public:
+        ScopedTimer(Metrics& metrics, Stage stage) : metrics_(metrics), stage_(stage) {
+            if (metrics_.enabled_) start_ = std::chrono::steady_clock::now();
+        }
+        ~ScopedTimer() {
+            if (metrics_.enabled_) metrics_.pending_[static_cast<size_t>(stage_)] += elapsedSince(start_);
+        }
+    private:
+        Metrics& metrics_;
+        Stage stage_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    const LatencyHistogram& histogram(Stage s) const { return histograms_[static_cast<size_t>(s)]; }
+    uint64_t counter(Counter c) const { return counters_[static_cast<size_t>(c)]; }
+
+    std::string toJson() const {
+        std::ostringstream out;
+        out << "{\n  \"stages_ns\": {";
+        for (size_t s = 0; s < static_cast<size_t>(Stage::Count); ++s) {
+            const auto& h = histograms_[s];
+            out << (s ? "," : "") << "\n    \"" << stageName(static_cast<Stage>(s)) << "\": {"
+                << "\"count\": " << h.count() << ", \"sum\": " << h.sum()
+                << ", \"min\": " << h.min() << ", \"p50\": " << h.percentile(0.50)
+                << ", \"p95\": " << h.percentile(0.95) << ", \"p99\": " << h.percentile(0.99)
+                << ", \"max\": " << h.max() << "}";
+        }
+        out << "\n  },\n  \"counters\": {";
+        for (size_t c = 0; c < static_cast<size_t>(Counter::Count); ++c) {
+            out << (c ? "," : "") << "\n    \"" << counterName(static_cast<Counter>(c)) << "\": " << counters_[c];
+        }
+        ProcessStats p = processStats();
+        out << "\n  },\n  \"process\": {\"cpu_user_seconds\": " << p.cpu_user_seconds
+            << ", \"cpu_system_seconds\": " << p.cpu_system_seconds << ", \"max_rss_kb\": " << p.max_rss_kb << "}\n}\n";
+        return out.str();
+    }
+
+    // Prometheus text exposition: summaries per stage (seconds) plus counters
+    std::string toPrometheus() const {
+        std::ostringstream out;
+        out << "# TYPE query_stage_seconds summary\n";
+        for (size_t s = 0; s < static_cast<size_t>(Stage::Count); ++s) {
+            const auto& h = histograms_[s];
+            const char* name = stageName(static_cast<Stage>(s));
+            const double quantiles[] = {0.5, 0.95, 0.99};
+            for (double q : quantiles) {
+                out << "query_stage_seconds{stage=\"" << name << "\",quantile=\"" << q << "\"} "
+                    << h.percentile(q) / 1e9 << "\n";
+            }
+            out << "query_stage_seconds_sum{stage=\"" << name << "\"} " << h.sum() / 1e9 << "\n";
+            out << "query_stage_seconds_count{stage=\"" << name << "\"} " << h.count() << "\n";
+        }
+        for (size_t c = 0; c < static_cast<size_t>(Counter::Count); ++c) {
+            const char* name = counterName(static_cast<Counter>(c));
+            out << "# TYPE query_" << name << "_total counter\n";
+            out << "query_" << name << "_total " << counters_[c] << "\n";
+        }
+        ProcessStats p = processStats();
+        out << "# TYPE process_cpu_user_seconds gauge\nprocess_cpu_user_seconds " << p.cpu_user_seconds << "\n";
+        out << "# TYPE process_cpu_system_seconds gauge\nprocess_cpu_system_seconds " << p.cpu_system_seconds << "\n";
+        out << "# TYPE process_max_rss_kb gauge\nprocess_max_rss_kb " << p.max_rss_kb << "\n";
+        return out.str();
+    }
+
+private:
+    static uint64_t elapsedSince(std::chrono::steady_clock::time_point start) {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+
+    struct ProcessStats {
+        double cpu_user_seconds = 0.0;
+        double cpu_system_seconds = 0.0;
+        long max_rss_kb = 0;
+    };
+
+    // Process-wide CPU time and peak RSS, read once at dump time rather than per query
+    static ProcessStats processStats() {
+        ProcessStats p;
+#ifdef __linux__
+        rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        p.cpu_user_seconds = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+        p.cpu_system_seconds = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+        p.max_rss_kb = usage.ru_maxrss;
+#endif
+        return p;
+    }
+
+    bool enabled_;
+    std::chrono::steady_clock::time_point query_start_;
+    std::array<uint64_t, static_cast<size_t>(Stage::Count)> pending_{};
+    std::array<LatencyHistogram, static_cast<size_t>(Stage::Count)> histograms_;
+    std::array<uint64_t, static_cast<size_t>(Counter::Count)> counters_{};
+};
+
+#endif // METRICS_H
@@ -0,0 +1,259 @@
+#ifndef QUERY_PLAN_H
+#define QUERY_PLAN_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <cstdint>
+
+#include "index_reader.h"
+#include "async_io.h"
+#include "block_postings.h"
+#include "collection_stats.h"
+#include "ranking.h"
+#include "fusion.h"
+
+// Query plan: every distinct query term is resolved once, before traversal, into a TermScorer
+// holding its cursor, its precomputed kernel constants and the bound on what it can add to a
+// document. The traversal loops below then work on that flat vector only (no string hashing, no
+// IDF per posting), with the ranking kernel (ranking.h) a template parameter so it inlines into
+// the loop.
+
+// Function to fetch the posting lists of `entries` from the index open as `fd` in one batch,
+// decoding each list as soon as it has arrived; ready[i] is false if list i failed to read or decode
+inline void fetch_posting_cursors(AsyncReader& reader, int fd, IndexLayout layout, const std::vector<std::string>& terms,
+                                  const std::vector<LexiconEntry>& entries, std::vector<PostingCursor>& cursors,
+                                  std::vector<bool>& ready) {
+    struct ListRead {
+        std::vector<uint8_t> encoded_docids;
+        std::vector<uint8_t> encoded_freqs;
+        int pending;
+        bool failed = false;
+    };
+    std::vector<ListRead> reads(entries.size());
+    cursors.assign(entries.size(), PostingCursor());
+    ready.assign(entries.size(), false);
+
+    std::vector<ReadRequest> requests;
+    std::vector<size_t> owners; // request -> list
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const LexiconEntry& entry = entries[i];
+        ListRead& read = reads[i];
+        if (entry.doc_freq == 0) {
+            // A pruned tier can keep no postings of a term
+            cursors[i].reset(std::vector<uint32_t>(), std::vector<uint32_t>());
+            ready[i] = true;
+            continue;
+        }
+        read.pending = layout == IndexLayout::Blocked ? 1 : 2;
+        read.encoded_docids.resize(entry.docid_length);
+        ReadRequest request;
+        request.fd = fd;
+        request.offset = entry.docid_offset;
+        request.length = entry.docid_length;
+        request.buffer = read.encoded_docids.data();
+        requests.push_back(request);
+        owners.push_back(i);
+        if (layout == IndexLayout::Split) {
+            read.encoded_freqs.resize(entry.freq_length);
+            request.offset = entry.freq_offset;
+            request.length = entry.freq_length;
+            request.buffer = read.encoded_freqs.data();
+            requests.push_back(request);
+            owners.push_back(i);
+        }
+    }
+    reader.readBatch(requests, [&](size_t q) {
+        size_t i = owners[q];
+        ListRead& read = reads[i];
+        read.failed = read.failed || requests[q].result != static_cast<ssize_t>(requests[q].length);
+        if (--read.pending > 0 || read.failed) return;
+        try {
+            if (layout == IndexLayout::Blocked) {
+                cursors[i].reset(std::move(read.encoded_docids), entries[i].doc_freq);
+            } else {
+                std::vector<uint32_t> doc_ids;
+                std::vector<uint32_t> freqs;
+                decode_postings(read.encoded_docids, read.encoded_freqs, entries[i].doc_freq, doc_ids, freqs);
+                cursors[i].reset(std::move(doc_ids), std::move(freqs));
+            }
+            ready[i] = true;
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Decoding error for term '" << terms[i] << "': " << e.what() << std::endl;
+        }
+    });
+}
+
+// One distinct query term, resolved
+struct TermScorer {
+    PostingCursor* cursor;
+    TermWeight term;
+};
+
+// Function to build a scorer
+template <class Kernel>
+inline TermScorer make_term_scorer(const Kernel& kernel, PostingCursor* cursor, const TermStatistics& stats) {
+    return TermScorer{cursor, kernel.prepare(stats)};
+}
+
+// The best k (docID, score) pairs seen; ties go to the lower docID
+class TopK {
+public:
+    explicit TopK(size_t k) : k_(k) { heap_.reserve(k); }
+
+    bool full() const { return k_ > 0 && heap_.size() >= k_; }
+
+    // Score a new document must beat once the heap is full
+    double threshold() const { return full() ? heap_.front().second : -std::numeric_limits<double>::infinity(); }
+
+    void push(uint32_t doc_id, double score) {
+        if (k_ == 0) return;
+        std::pair<uint32_t, double> entry(doc_id, score);
+        if (heap_.size() < k_) {
+            heap_.push_back(entry);
+            std::push_heap(heap_.begin(), heap_.end(), better);
+        } else if (better(entry, heap_.front())) {
+            std::pop_heap(heap_.begin(), heap_.end(), better);
+            heap_.back() = entry;
+            std::push_heap(heap_.begin(), heap_.end(), better);
+        }
+    }
+
+    // Function to take the results, best first
+    RankedList sorted() {
+        std::sort_heap(heap_.begin(), heap_.end(), better);
+        RankedList result;
+        result.swap(heap_);
+        return result;
+    }
+
+private:
+    // Heap order: the front is the worst of the kept entries
+    static bool better(const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    }
+
+    size_t k_;
+    RankedList heap_;
+};
+
+// Per-traversal counters for the metrics
+struct TraversalStats {
+    uint64_t postings_scored = 0;
+};
+
+// Conjunctive traversal: drive from the shortest list and skip the others forward with nextGEQ.
+// `accept(docID, score)` decides whether a document that matched every term enters `top`
+// (phrase checks); the cursors are positioned on the document during the call.
+template <class Kernel, class Accept>
+inline TraversalStats traverse_conjunctive(std::vector<TermScorer>& scorers, const Kernel& kernel,
+                                           const CollectionStats& stats, TopK& top, Accept&& accept) {
+    TraversalStats counters;
+    if (scorers.empty()) return counters;
+    PostingCursor* driver = std::min_element(scorers.begin(), scorers.end(),
+        [](const TermScorer& a, const TermScorer& b) { return a.cursor->size() < b.cursor->size(); })->cursor;
+    while (!driver->done()) {
+        uint32_t candidate = driver->docid();
+        bool matched = true;
+        for (TermScorer& scorer : scorers) {
+            PostingCursor* cursor = scorer.cursor;
+            cursor->nextGEQ(candidate);
+            if (cursor->done()) return counters;
+            if (cursor->docid() != candidate) {
+                driver->nextGEQ(cursor->docid());
+                matched = false;
+                break;
+            }
+        }
+        if (!matched) continue;
+
+        uint32_t doc_length = stats.docLength(candidate);
+        double norm = kernel.docNorm(doc_length);
+        double score = kernel.docPrior(doc_length);
+        for (TermScorer& scorer : scorers) {
+            score += kernel.score(scorer.term, scorer.cursor->freq(), norm);
+        }
+        counters.postings_scored += scorers.size();
+        if (score >= top.threshold() && accept(candidate, score)) {
+            top.push(candidate, score);
+        }
+        driver->next();
+    }
+    return counters;
+}
+
+// Disjunctive traversal with MaxScore: scorers are ordered by bound, and the low-bound prefix
+// whose bounds together cannot beat the current top-k threshold is "non-essential". Only
+// documents in an essential list become candidates; non-essential lists are probed with nextGEQ,
+// highest bound first, and only while the document can still make the top k. Kernels keep
+// docPrior() <= 0, so the bounds hold for whole scores.
+template <class Kernel, class Accept>
+inline TraversalStats traverse_disjunctive(std::vector<TermScorer>& scorers, const Kernel& kernel,
+                                           const CollectionStats& stats, TopK& top, Accept&& accept) {
+    TraversalStats counters;
+    std::sort(scorers.begin(), scorers.end(),
+              [](const TermScorer& a, const TermScorer& b) { return a.term.max_score < b.term.max_score; });
+    std::vector<double> bound_prefix(scorers.size()); // sum of bounds of scorers[0..i]
+    double sum = 0.0;
+    for (size_t i = 0; i < scorers.size(); ++i) {
+        sum += scorers[i].term.max_score;
+        bound_prefix[i] = sum;
+    }
+
+    size_t essential = 0; // scorers[0..essential) are non-essential
+    while (true) {
+        while (top.full() && essential < scorers.size() && bound_prefix[essential] <= top.threshold()) {
+            essential++;
+        }
+        if (essential == scorers.size()) break; // nothing left can enter the top k
+
+        bool any = false;
+        uint32_t doc_id = 0;
+        for (size_t i = essential; i < scorers.size(); ++i) {
+            PostingCursor* cursor = scorers[i].cursor;
+            if (!cursor->done() && (!any || cursor->docid() < doc_id)) {
+                doc_id = cursor->docid();
+                any = true;
+            }
+        }
+        if (!any) break;
+
+        uint32_t doc_length = stats.docLength(doc_id);
+        double norm = kernel.docNorm(doc_length);
+        double score = kernel.docPrior(doc_length);
+        for (size_t i = essential; i < scorers.size(); ++i) {
+            PostingCursor* cursor = scorers[i].cursor;
+            if (!cursor->done() && cursor->docid() == doc_id) {
+                score += kernel.score(scorers[i].term, cursor->freq(), norm);
+                counters.postings_scored++;
+            }
+        }
+        bool candidate = true;
+        for (size_t i = essential; i-- > 0;) {
+            if (top.full() && score + bound_prefix[i] <= top.threshold()) {
+                candidate = false;
+                break;
+            }
+            PostingCursor* cursor = scorers[i].cursor;
+            cursor->nextGEQ(doc_id);
+            if (!cursor->done() && cursor->docid() == doc_id) {
+                score += kernel.score(scorers[i].term, cursor->freq(), norm);
+                counters.postings_scored++;
+            }
+        }
+        if (candidate && accept(doc_id, score)) {
+            top.push(doc_id, score);
+        }
+
+        for (size_t i = essential; i < scorers.size(); ++i) {
+            PostingCursor* cursor = scorers[i].cursor;
+            if (!cursor->done() && cursor->docid() == doc_id) cursor->next();
+        }
+    }
+    return counters;
+}
+
+#endif // QUERY_PLAN_H
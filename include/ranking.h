@@ -0,0 +1,234 @@
+#ifndef RANKING_H
+#define RANKING_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <string>
+
+// Ranking functions shared by the query processor and the shard searcher, so a sharded query
+// scored with global statistics matches the single-index score exactly.
+//
+// Every ranking function is a kernel class with the same four members, split into per-term,
+// per-document and per-posting parts so the traversal loop does as little as possible per posting:
+//   prepare(term)           constants of one query term (once per query)
+//   docNorm(length)         length normalisation of a candidate document (once per document)
+//   docPrior(length)        query-independent part of a document's score (once per document)
+//   score(term, f, norm)    one posting's contribution
+// The traversals in query_plan.h are templates on the kernel, so each ranking function gets its
+// own inlined loop; with_ranking_kernel() picks one at runtime, once per query. Parameters are
+// compile-time constants of each kernel's Params, so the constant parts fold away.
+
+// BM25 Parameters
+constexpr double BM25_K1 = 1.5;
+constexpr double BM25_B = 0.75;
+
+// Collection-wide inputs of a kernel, fixed for one query
+struct RankingContext {
+    uint64_t num_docs = 0;
+    uint64_t total_tokens = 0;
+    double avgdl = 0.0;
+    size_t query_terms = 0; // query term occurrences that occur in the collection
+};
+
+// Statistics of one distinct query term
+struct TermStatistics {
+    uint64_t doc_freq = 0;
+    uint64_t coll_freq = 0;  // total occurrences in the collection; 0 if the lexicon predates it
+    size_t occurrences = 1;  // times the term appears in the query
+};
+
+// A query term's precomputed scoring constants
+struct TermWeight {
+    double weight;    // per-term factor of the score, times the term's query occurrences
+    double scale;     // kernel-specific per-term constant (unused by the BM25 family)
+    double max_score; // upper bound of the term's contribution to any document
+};
+
+// Function to calculate IDF
+inline double calculate_idf(uint64_t total_docs, uint64_t doc_freq) {
+    return log((static_cast<double>(total_docs) - doc_freq + 0.5) / (doc_freq + 0.5) + 1);
+}
+
+// Compile-time BM25 parameters
+struct Bm25Defaults {
+    static constexpr double k1 = BM25_K1;
+    static constexpr double b = BM25_B;
+};
+
+// BM25:
+//   score(t, d) = weight(t) * f / (f + norm(d))
+//   weight(t)   = idf(t) * (k1 + 1)
+//   norm(d)     = k1 * (1 - b) + k1 * b / avgdl * |d|
+template <class Params = Bm25Defaults>
+class Bm25Kernel {
+public:
+    explicit Bm25Kernel(const RankingContext& context)
+        : num_docs_(context.num_docs), norm_base_(Params::k1 * (1 - Params::b)),
+          norm_per_token_(context.avgdl > 0 ? Params::k1 * Params::b / context.avgdl : 0.0) {}
+
+    TermWeight prepare(const TermStatistics& term) const {
+        double weight = calculate_idf(num_docs_, term.doc_freq) * (Params::k1 + 1) * static_cast<double>(term.occurrences);
+        return TermWeight{weight, 0.0, weight}; // f / (f + norm) < 1
+    }
+
+    double docNorm(uint32_t doc_length) const { return norm_base_ + norm_per_token_ * doc_length; }
+    double docPrior(uint32_t) const { return 0.0; }
+
+    double score(const TermWeight& term, uint32_t freq, double norm) const {
+        return term.weight * freq / (freq + norm);
+    }
+
+private:
+    uint64_t num_docs_;
+    double norm_base_;
+    double norm_per_token_;
+};
+
+// Compile-time BM25+ parameters
+struct Bm25PlusDefaults {
+    static constexpr double k1 = BM25_K1;
+    static constexpr double b = BM25_B;
+    static constexpr double delta = 1.0;
+};
+
+// BM25+ (Lv and Zhai): BM25 with a lower bound `delta` on a matching term's normalised tf, so
+// long documents are not scored below documents that lack the term:
+//   score(t, d) = idf(t) * ((k1 + 1) * f / (f + norm(d)) + delta)
+template <class Params = Bm25PlusDefaults>
+class Bm25PlusKernel {
+public:
+    explicit Bm25PlusKernel(const RankingContext& context)
+        : num_docs_(context.num_docs), norm_base_(Params::k1 * (1 - Params::b)),
+          norm_per_token_(context.avgdl > 0 ? Params::k1 * Params::b / context.avgdl : 0.0) {}
+
+    TermWeight prepare(const TermStatistics& term) const {
+        double weight = calculate_idf(num_docs_, term.doc_freq) * static_cast<double>(term.occurrences);
+        return TermWeight{weight, 0.0, weight * (Params::k1 + 1 + Params::delta)};
+    }
+
+    double docNorm(uint32_t doc_length) const { return norm_base_ + norm_per_token_ * doc_length; }
+    double docPrior(uint32_t) const { return 0.0; }
+
+    double score(const TermWeight& term, uint32_t freq, double norm) const {
+        return term.weight * ((Params::k1 + 1) * freq / (freq + norm) + Params::delta);
+    }
+
+private:
+    uint64_t num_docs_;
+    double norm_base_;
+    double norm_per_token_;
+};
+
+// Compile-time Dirichlet smoothing parameter
+struct DirichletDefaults {
+    static constexpr double mu = 1000.0;
+};
+
+// Query likelihood with Dirichlet smoothing, in its rank-equivalent sum over matching terms:
+//   score(d) = sum_t occ(t) * log(1 + f / (mu * p(t))) + |q| * log(mu / (|d| + mu))
+// with p(t) = cf(t) / total tokens. The document part is never positive, so the per-term bounds
+// remain upper bounds of whole scores. Without collection frequencies in the lexicon, df stands
+// in for cf and the bounds are dropped (no pruning).
+template <class Params = DirichletDefaults>
+class DirichletLmKernel {
+public:
+    explicit DirichletLmKernel(const RankingContext& context)
+        : total_tokens_(static_cast<double>(context.total_tokens)), query_terms_(static_cast<double>(context.query_terms)) {}
+
+    TermWeight prepare(const TermStatistics& term) const {
+        double weight = static_cast<double>(term.occurrences);
+        uint64_t coll_freq = term.coll_freq > 0 ? term.coll_freq : term.doc_freq;
+        double scale = coll_freq > 0 ? total_tokens_ / (Params::mu * static_cast<double>(coll_freq)) : 0.0;
+        // f <= cf, so f * scale <= total tokens / mu
+        double max_score = term.coll_freq > 0 ? weight * log(1 + total_tokens_ / Params::mu) : std::numeric_limits<double>::infinity();
+        return TermWeight{weight, scale, max_score};
+    }
+
+    double docNorm(uint32_t) const { return 0.0; }
+    double docPrior(uint32_t doc_length) const { return query_terms_ * log(Params::mu / (doc_length + Params::mu)); }
+
+    double score(const TermWeight& term, uint32_t freq, double) const {
+        return term.weight * log(1 + freq * term.scale);
+    }
+
+private:
+    double total_tokens_;
+    double query_terms_;
+};
+
+// Compile-time BM25F parameters: saturation, and per field a weight and a length normalisation
+struct Bm25fDefaults {
+    static constexpr double k1 = 1.2;
+    static constexpr double body_weight = 1.0;
+    static constexpr double body_b = 0.75;
+};
+
+// BM25F: field frequencies are length-normalised per field and weighted before a single
+// saturation, tf~ = sum_field weight * f_field / (1 - b_field + b_field * |d_field| / avg_field),
+// score = idf * (k1 + 1) * tf~ / (k1 + tf~). The index stores one field (the passage body), so
+// the sum has one term and rearranges to the BM25 shape with norm = k1 * B_body / weight_body.
+template <class Params = Bm25fDefaults>
+class Bm25fKernel {
+public:
+    explicit Bm25fKernel(const RankingContext& context)
+        : num_docs_(context.num_docs), norm_base_(Params::k1 * (1 - Params::body_b) / Params::body_weight),
+          norm_per_token_(context.avgdl > 0 ? Params::k1 * Params::body_b / (context.avgdl * Params::body_weight) : 0.0) {}
+
+    TermWeight prepare(const TermStatistics& term) const {
+        double weight = calculate_idf(num_docs_, term.doc_freq) * (Params::k1 + 1) * static_cast<double>(term.occurrences);
+        return TermWeight{weight, 0.0, weight};
+    }
+
+    double docNorm(uint32_t body_length) const { return norm_base_ + norm_per_token_ * body_length; }
+    double docPrior(uint32_t) const { return 0.0; }
+
+    double score(const TermWeight& term, uint32_t body_freq, double norm) const {
+        return term.weight * body_freq / (body_freq + norm);
+    }
+
+private:
+    uint64_t num_docs_;
+    double norm_base_;
+    double norm_per_token_;
+};
+
+// Ranking functions selectable at runtime
+enum class RankingModel { Bm25, Bm25Plus, DirichletLm, Bm25f };
+
+inline const char* rankingModelName(RankingModel model) {
+    static const char* names[] = {"bm25", "bm25+", "ql", "bm25f"};
+    return names[static_cast<size_t>(model)];
+}
+
+// Function to parse a ranking function name; false if unknown
+inline bool parse_ranking_model(const std::string& name, RankingModel& model) {
+    for (RankingModel candidate : {RankingModel::Bm25, RankingModel::Bm25Plus, RankingModel::DirichletLm, RankingModel::Bm25f}) {
+        if (name == rankingModelName(candidate)) {
+            model = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Function to call fn(kernel) with the kernel of `model`; fn is instantiated once per kernel type
+template <class Fn>
+inline void with_ranking_kernel(RankingModel model, const RankingContext& context, Fn&& fn) {
+    switch (model) {
+    case RankingModel::Bm25Plus:
+        fn(Bm25PlusKernel<>(context));
+        break;
+    case RankingModel::DirichletLm:
+        fn(DirichletLmKernel<>(context));
+        break;
+    case RankingModel::Bm25f:
+        fn(Bm25fKernel<>(context));
+        break;
+    default:
+        fn(Bm25Kernel<>(context));
+        break;
+    }
+}
+
+#endif // RANKING_H
@@ -0,0 +1,289 @@
+#ifndef SEQUENTIAL_IO_H
+#define SEQUENTIAL_IO_H
+
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+// Large-block sequential file I/O for the index build (collection scan, intermediate runs,
+// final index). Buffers are page aligned and several MB, so the disk sees long sequential
+// transfers instead of the 4-8 KB requests of a default iostream buffer.
+//
+// Buffered mode tells the kernel the access is sequential, prefetches the next block while the
+// current one is parsed and drops consumed pages, so a multi-GB run scan does not evict the rest
+// of the page cache. Direct mode opens the file with O_DIRECT where the platform and file system
+// support it and silently falls back to buffered I/O where they do not (e.g. tmpfs).
+
+const size_t SEQUENTIAL_IO_ALIGNMENT = 4096;
+const size_t SEQUENTIAL_IO_DEFAULT_BUFFER = 4 * 1024 * 1024;
+
+inline char* allocateAlignedBuffer(size_t& size) {
+    size = (size + SEQUENTIAL_IO_ALIGNMENT - 1) / SEQUENTIAL_IO_ALIGNMENT * SEQUENTIAL_IO_ALIGNMENT;
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, SEQUENTIAL_IO_ALIGNMENT, size) != 0) {
+        return nullptr;
+    }
+    return static_cast<char*>(buffer);
+}
+
+// Open for sequential access, with O_DIRECT when requested and accepted. Returns the fd or -1.
+inline int openSequential(const std::string& path, int flags, bool direct, bool& direct_enabled) {
+    direct_enabled = false;
+#ifdef O_DIRECT
+    if (direct) {
+        int fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+        if (fd >= 0) {
+            direct_enabled = true;
+            return fd;
+        }
+    }
+#else
+    (void)direct;
+#endif
+    int fd = ::open(path.c_str(), flags, 0644);
+#ifdef POSIX_FADV_SEQUENTIAL
+    if (fd >= 0) {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+#endif
+    return fd;
+}
+
+class SequentialReader {
+public:
+    SequentialReader() = default;
+    SequentialReader(const SequentialReader&) = delete;
+    SequentialReader& operator=(const SequentialReader&) = delete;
+    SequentialReader(SequentialReader&& other) noexcept { *this = std::move(other); }
+    SequentialReader& operator=(SequentialReader&& other) noexcept {
+        if (this != &other) {
+            close();
+            fd_ = other.fd_;
+            direct_ = other.direct_;
+            failed_ = other.failed_;
+            buffer_ = other.buffer_;
+            capacity_ = other.capacity_;
+            begin_ = other.begin_;
+            end_ = other.end_;
+            file_offset_ = other.file_offset_;
+            other.fd_ = -1;
+            other.buffer_ = nullptr;
+        }
+        return *this;
+    }
+    ~SequentialReader() { close(); }
+
+    bool open(const std::string& path, bool direct = false, size_t buffer_size = SEQUENTIAL_IO_DEFAULT_BUFFER) {
+        close();
+        capacity_ = buffer_size;
+        buffer_ = allocateAlignedBuffer(capacity_);
+        if (!buffer_) return false;
+        fd_ = openSequential(path, O_RDONLY, direct, direct_);
+        failed_ = fd_ < 0;
+        begin_ = end_ = 0;
+        file_offset_ = 0;
+        return fd_ >= 0;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+    bool failed() const { return failed_; }
+    bool direct() const { return direct_; }
+
+    // Read up to the next '\n' (not included). Returns false at end of file; a final line
+    // without a newline is still returned.
+    bool readLine(std::string& line) {
+        line.clear();
+        while (true) {
+            if (begin_ == end_ && !refill()) {
+                return !line.empty();
+            }
+            const char* start = buffer_ + begin_;
+            const void* newline = std::memchr(start, '\n', end_ - begin_);
+            if (newline) {
+                size_t length = static_cast<const char*>(newline) - start;
+                line.append(start, length);
+                begin_ += length + 1;
+                return true;
+            }
+            line.append(start, end_ - begin_);
+            begin_ = end_;
+        }
+    }
+
+    void close() {
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+        std::free(buffer_);
+        buffer_ = nullptr;
+    }
+
+private:
+    bool refill() {
+        if (fd_ < 0 || failed_) return false;
+#ifdef POSIX_FADV_DONTNEED
+        // The block just parsed will not be read again
+        if (!direct_ && end_ > 0) {
+            posix_fadvise(fd_, static_cast<off_t>(file_offset_ - end_), static_cast<off_t>(end_), POSIX_FADV_DONTNEED);
+        }
+#endif
+        ssize_t n;
+        do {
+            n = ::read(fd_, buffer_, capacity_);
+#ifdef O_DIRECT
+            // A short read left the offset unaligned; continue through the page cache
+            if (n < 0 && errno == EINVAL && direct_) {
+                fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+                direct_ = false;
+                errno = EINTR;
+            }
+#endif
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            failed_ = n < 0;
+            begin_ = end_ = 0;
+            return false;
+        }
+        begin_ = 0;
+        end_ = static_cast<size_t>(n);
+        file_offset_ += end_;
+#ifdef POSIX_FADV_WILLNEED
+        // Start reading the next block while this one is parsed
+        if (!direct_) {
+            posix_fadvise(fd_, static_cast<off_t>(file_offset_), static_cast<off_t>(capacity_), POSIX_FADV_WILLNEED);
+        }
+#endif
+        return true;
+    }
+
+    int fd_ = -1;
+    bool direct_ = false;
+    bool failed_ = false;
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t begin_ = 0;
+    size_t end_ = 0;
+    uint64_t file_offset_ = 0;
+};
+
+class SequentialWriter {
+public:
+    SequentialWriter() = default;
+    SequentialWriter(const SequentialWriter&) = delete;
+    SequentialWriter& operator=(const SequentialWriter&) = delete;
+    ~SequentialWriter() { close(); }
+
+    bool open(const std::string& path, bool direct = false, size_t buffer_size = SEQUENTIAL_IO_DEFAULT_BUFFER) {
+        close();
+        capacity_ = buffer_size;
+        buffer_ = allocateAlignedBuffer(capacity_);
+        if (!buffer_) return false;
+        fd_ = openSequential(path, O_WRONLY | O_CREAT | O_TRUNC, direct, direct_);
+        failed_ = fd_ < 0;
+        size_ = 0;
+        bytes_written_ = 0;
+        return fd_ >= 0;
+    }
+
+    bool is_open() const { return fd_ >= 0; }
+    bool failed() const { return failed_; }
+    bool direct() const { return direct_; }
+    uint64_t bytes_written() const { return bytes_written_ + size_; }
+
+    void write(const void* data, size_t length) {
+        const char* bytes = static_cast<const char*>(data);
+        while (length > 0) {
+            if (size_ == capacity_) flush(false);
+            if (failed_) return;
+            size_t chunk = std::min(length, capacity_ - size_);
+            std::memcpy(buffer_ + size_, bytes, chunk);
+            size_ += chunk;
+            bytes += chunk;
+            length -= chunk;
+        }
+    }
+
+    void write(std::string_view text) { write(text.data(), text.size()); }
+
+    void put(char c) {
+        if (size_ == capacity_) flush(false);
+        if (!failed_) buffer_[size_++] = c;
+    }
+
+    void writeNumber(uint64_t value) {
+        char digits[20];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        write(digits, static_cast<size_t>(result.ptr - digits));
+    }
+
+    // Flush the buffer and close; returns false if any write failed
+    bool close() {
+        bool ok = !failed_;
+        if (fd_ >= 0) {
+            flush(true);
+            ok = !failed_;
+            if (::close(fd_) != 0) ok = false;
+            fd_ = -1;
+        }
+        std::free(buffer_);
+        buffer_ = nullptr;
+        size_ = 0;
+        return ok;
+    }
+
+private:
+    void flush(bool final) {
+        if (fd_ < 0 || failed_ || size_ == 0) return;
+        size_t length = size_;
+#ifdef O_DIRECT
+        if (direct_ && size_ % SEQUENTIAL_IO_ALIGNMENT != 0) {
+            // O_DIRECT transfers must be whole aligned blocks; the unaligned tail at close goes
+            // out through the page cache
+            if (!final) return;
+            length = size_ / SEQUENTIAL_IO_ALIGNMENT * SEQUENTIAL_IO_ALIGNMENT;
+            writeAll(buffer_, length);
+            fcntl(fd_, F_SETFL, fcntl(fd_, F_GETFL) & ~O_DIRECT);
+            direct_ = false;
+            writeAll(buffer_ + length, size_ - length);
+            length = size_;
+        } else
+#endif
+        {
+            writeAll(buffer_, length);
+        }
+        (void)final;
+        bytes_written_ += length;
+        size_ = 0;
+    }
+
+    void writeAll(const char* data, size_t length) {
+        while (length > 0 && !failed_) {
+            ssize_t n = ::write(fd_, data, length);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                failed_ = true;
+                return;
+            }
+            data += n;
+            length -= static_cast<size_t>(n);
+        }
+    }
+
+    int fd_ = -1;
+    bool direct_ = false;
+    bool failed_ = false;
+    char* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    uint64_t bytes_written_ = 0;
+};
+
+#endif // SEQUENTIAL_IO_H
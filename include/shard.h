@@ -0,0 +1,462 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "index_reader.h"
+#include "block_postings.h"
+#include "async_io.h"
+#include "ranking.h"
+#include "query_plan.h"
+#include "collection_stats.h"
+#include "fusion.h"
+
+// Scatter-gather search over docID-range shards (built by shard_index, each indexed on its own).
+// Every shard keeps global docIDs. The coordinator sums the shards' document counts, lengths and
+// per-term document and collection frequencies, and each shard scores with those global
+// statistics and the coordinator's ranking function, so scores are the ones a single index over the whole collection would give and the per-shard
+// top-k lists merge directly.
+//
+// A shard is searched either in-process (LocalShard, one thread per shard per query) or in a
+// separate process reached over a TCP socket (RemoteShard talking to serveShard). The wire
+// protocol is one request line, answered by text lines:
+//
+//   STATS                        -> <num_docs> <total_length>
+//   DF <t1> <t2> ...             -> <df1> <cf1> <df2> <cf2> ...
+//   SEARCH <mode> <k> <ranking> <num_docs> <total_length> <avgdl> <t1> <df1> <cf1> ...
+//                                -> <n>, then n lines <docID> <score>
+//   PASSAGE <docID>              -> <length>, then the passage bytes; -1 if not in this shard
+//
+// Doubles travel as hex floats, so scores cross the socket bit for bit.
+
+// Collection-wide statistics a shard query is scored with
+struct ShardQueryStats {
+    RankingModel ranking = RankingModel::Bm25;
+    uint64_t num_docs = 0;
+    uint64_t total_length = 0;
+    double avgdl = 0.0;
+    std::vector<uint64_t> doc_freqs;  // global df of each query term
+    std::vector<uint64_t> coll_freqs; // global cf of each query term
+};
+
+// One shard's index, lengths and passages, searched with externally supplied statistics
+class ShardSearcher {
+public:
+    // Open <dir>/final_index.bin, lexicon.txt, collection_stats.bin, page_table.txt and passages.bin
+    bool open(const std::string& dir, IoBackend backend = IoBackend::Uring) {
+        if (!load_lexicon(dir + "/lexicon.txt", lexicon_)
+            || !load_collection_stats(dir + "/collection_stats.bin", stats_)
+            || !load_page_table(dir + "/page_table.txt", page_table_)) {
+            return false;
+        }
+        if (!index_file_.open(dir + "/final_index.bin") || !passages_file_.open(dir + "/passages.bin")) {
+            std::cerr << "Error: Failed to open the index or passages of shard: " << dir << std::endl;
+            return false;
+        }
+        layout_ = detect_index_layout(dir + "/final_index.bin");
+        reader_.init(backend, 64, 2);
+        return true;
+    }
+
+    uint64_t numDocs() const { return stats_.numDocs(); }
+    uint64_t totalLength() const { return stats_.header.total_tokens; }
+
+    // Function to look up a term's document and collection frequency in this shard
+    void termFreqs(const std::string& term, uint64_t& doc_freq, uint64_t& coll_freq) const {
+        auto it = lexicon_.find(term);
+        doc_freq = it == lexicon_.end() ? 0 : it->second.doc_freq;
+        coll_freq = it == lexicon_.end() ? 0 : it->second.coll_freq;
+    }
+
+    // Top-k documents of this shard for `terms` (one entry per query term occurrence, as in the
+    // query processor); mode 1 is conjunctive, mode 2 disjunctive. Ties go to the lower docID.
+    RankedList search(const std::vector<std::string>& terms, int mode, size_t k, const ShardQueryStats& stats) {
+        // Fetch every distinct term's postings in one batch
+        std::vector<std::string> list_terms;
+        std::vector<LexiconEntry> entries;
+        std::vector<size_t> slot_of(terms.size(), SIZE_MAX); // query term -> list index
+        for (size_t i = 0; i < terms.size(); ++i) {
+            auto it = lexicon_.find(terms[i]);
+            if (it == lexicon_.end()) continue;
+            for (size_t r = 0; r < list_terms.size() && slot_of[i] == SIZE_MAX; ++r) {
+                if (list_terms[r] == terms[i]) slot_of[i] = r;
+            }
+            if (slot_of[i] == SIZE_MAX) {
+                slot_of[i] = list_terms.size();
+                list_terms.push_back(terms[i]);
+                entries.push_back(it->second);
+            }
+        }
+        std::vector<PostingCursor> cursors;
+        std::vector<bool> ready;
+        fetch_posting_cursors(reader_, index_file_.fd(), layout_, list_terms, entries, cursors, ready);
+
+        // Query plan with the global statistics, so scores match the single-index query processor
+        std::vector<size_t> occurrences(list_terms.size(), 0);
+        size_t matched_terms = 0;
+        RankingContext context{stats.num_docs, stats.total_length, stats.avgdl, 0};
+        for (size_t i = 0; i < terms.size(); ++i) {
+            context.query_terms += stats.doc_freqs[i] > 0 ? 1 : 0;
+            if (slot_of[i] == SIZE_MAX || !ready[slot_of[i]]) continue;
+            matched_terms++;
+            occurrences[slot_of[i]]++;
+        }
+
+        TopK top(k);
+        with_ranking_kernel(stats.ranking, context, [&](const auto& kernel) {
+            std::vector<TermScorer> scorers;
+            for (size_t i = 0; i < terms.size(); ++i) {
+                if (slot_of[i] == SIZE_MAX || !ready[slot_of[i]] || occurrences[slot_of[i]] == 0) continue;
+                TermStatistics term{stats.doc_freqs[i], stats.coll_freqs[i], occurrences[slot_of[i]]};
+                scorers.push_back(make_term_scorer(kernel, &cursors[slot_of[i]], term));
+                occurrences[slot_of[i]] = 0;
+            }
+            auto accept_document = [](uint32_t, double) { return true; };
+            if (mode == 1) {
+                if (matched_terms == terms.size()) traverse_conjunctive(scorers, kernel, stats_, top, accept_document);
+            } else {
+                traverse_disjunctive(scorers, kernel, stats_, top, accept_document);
+            }
+        });
+        return top.sorted();
+    }
+
+    // Function to read one passage of this shard; false if the docID is not here
+    bool passage(uint32_t doc_id, std::string& out) {
+        auto it = page_table_.find(doc_id);
+        if (it == page_table_.end()) return false;
+        std::vector<char> bytes(sizeof(uint32_t) + it->second.passage_length);
+        ReadRequest request;
+        request.fd = passages_file_.fd();
+        request.offset = it->second.passage_offset;
+        request.length = bytes.size();
+        request.buffer = bytes.data();
+        preadFully(request);
+        uint32_t passage_length = 0;
+        if (request.result != static_cast<ssize_t>(request.length)) return false;
+        std::memcpy(&passage_length, bytes.data(), sizeof(uint32_t));
+        if (passage_length > it->second.passage_length) return false;
+        out.assign(bytes.data() + sizeof(uint32_t), passage_length);
+        return true;
+    }
+
+private:
+    std::unordered_map<std::string, LexiconEntry> lexicon_;
+    CollectionStats stats_;
+    std::unordered_map<uint32_t, DocumentInfo> page_table_;
+    FileHandle index_file_;
+    FileHandle passages_file_;
+    IndexLayout layout_ = IndexLayout::Split;
+    AsyncReader reader_;
+};
+
+// Function to format a double exactly (hex float)
+inline std::string formatExact(double value) {
+    char text[64];
+    std::snprintf(text, sizeof(text), "%a", value);
+    return text;
+}
+
+// Buffered line I/O over a connected socket
+class SocketStream {
+public:
+    explicit SocketStream(int fd = -1) : fd_(fd) {}
+
+    bool sendAll(const std::string& data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t n = ::send(fd_, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return false;
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readLine(std::string& line) {
+        line.clear();
+        while (true) {
+            size_t newline = buffer_.find('\n', begin_);
+            if (newline != std::string::npos) {
+                line.assign(buffer_, begin_, newline - begin_);
+                begin_ = newline + 1;
+                return true;
+            }
+            if (!fill()) return false;
+        }
+    }
+
+    bool readBytes(size_t length, std::string& out) {
+        while (buffer_.size() - begin_ < length) {
+            if (!fill()) return false;
+        }
+        out.assign(buffer_, begin_, length);
+        begin_ += length;
+        return true;
+    }
+
+    int fd() const { return fd_; }
+
+private:
+    bool fill() {
+        buffer_.erase(0, begin_);
+        begin_ = 0;
+        char chunk[65536];
+        ssize_t n;
+        do {
+            n = ::recv(fd_, chunk, sizeof(chunk), 0);
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) return false;
+        buffer_.append(chunk, static_cast<size_t>(n));
+        return true;
+    }
+
+    int fd_;
+    std::string buffer_;
+    size_t begin_ = 0;
+};
+
+// Function to answer one connection's requests until it closes
+inline void serveShardConnection(ShardSearcher& shard, int fd) {
+    SocketStream stream(fd);
+    std::string line;
+    while (stream.readLine(line)) {
+        std::istringstream iss(line);
+        std::string command;
+        iss >> command;
+        std::ostringstream reply;
+        if (command == "STATS") {
+            reply << shard.numDocs() << " " << shard.totalLength() << "\n";
+        } else if (command == "DF") {
+            std::string term;
+            bool first = true;
+            while (iss >> term) {
+                uint64_t doc_freq, coll_freq;
+                shard.termFreqs(term, doc_freq, coll_freq);
+                reply << (first ? "" : " ") << doc_freq << " " << coll_freq;
+                first = false;
+            }
+            reply << "\n";
+        } else if (command == "SEARCH") {
+            int mode = 0;
+            size_t k = 0;
+            ShardQueryStats stats;
+            std::string ranking, avgdl;
+            iss >> mode >> k >> ranking >> stats.num_docs >> stats.total_length >> avgdl;
+            parse_ranking_model(ranking, stats.ranking);
+            stats.avgdl = std::strtod(avgdl.c_str(), nullptr);
+            std::vector<std::string> terms;
+            std::string term;
+            uint64_t doc_freq, coll_freq;
+            while (iss >> term >> doc_freq >> coll_freq) {
+                terms.push_back(term);
+                stats.doc_freqs.push_back(doc_freq);
+                stats.coll_freqs.push_back(coll_freq);
+            }
+            RankedList top = shard.search(terms, mode, k, stats);
+            reply << top.size() << "\n";
+            for (const auto& [doc_id, score] : top) {
+                reply << doc_id << " " << formatExact(score) << "\n";
+            }
+        } else if (command == "PASSAGE") {
+            uint32_t doc_id = 0;
+            std::string passage;
+            iss >> doc_id;
+            if (shard.passage(doc_id, passage)) {
+                reply << passage.size() << "\n" << passage;
+            } else {
+                reply << "-1\n";
+            }
+        } else {
+            break; // QUIT or an unknown request ends the connection
+        }
+        if (!stream.sendAll(reply.str())) break;
+    }
+    ::close(fd);
+}
+
+// Function to serve one shard on 127.0.0.1:port, one connection at a time; returns false if
+// the port cannot be bound
+inline bool serveShard(ShardSearcher& shard, uint16_t port) {
+    int listen_fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_fd < 0) return false;
+    int reuse = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if (::bind(listen_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(listen_fd, 16) != 0) {
+        ::close(listen_fd);
+        return false;
+    }
+    while (true) {
+        int fd = ::accept(listen_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        serveShardConnection(shard, fd);
+    }
+    ::close(listen_fd);
+    return true;
+}
+
+// Coordinator-side view of a shard. Searches are split into send and receive so the
+// coordinator can have every shard working on a query at once.
+class ShardClient {
+public:
+    virtual ~ShardClient() = default;
+    virtual bool stats(uint64_t& num_docs, uint64_t& total_length) = 0;
+    virtual bool termFreqs(const std::vector<std::string>& terms, std::vector<uint64_t>& doc_freqs,
+                           std::vector<uint64_t>& coll_freqs) = 0;
+    virtual bool startSearch(const std::vector<std::string>& terms, int mode, size_t k, const ShardQueryStats& stats) = 0;
+    virtual bool finishSearch(RankedList& top) = 0;
+    virtual bool passage(uint32_t doc_id, std::string& out) = 0; // false if the docID is not in the shard
+};
+
+// In-process shard; each search runs on its own thread
+class LocalShard : public ShardClient {
+public:
+    bool open(const std::string& dir, IoBackend backend) { return searcher_.open(dir, backend); }
+
+    bool stats(uint64_t& num_docs, uint64_t& total_length) override {
+        num_docs = searcher_.numDocs();
+        total_length = searcher_.totalLength();
+        return true;
+    }
+    bool termFreqs(const std::vector<std::string>& terms, std::vector<uint64_t>& doc_freqs,
+                   std::vector<uint64_t>& coll_freqs) override {
+        doc_freqs.assign(terms.size(), 0);
+        coll_freqs.assign(terms.size(), 0);
+        for (size_t i = 0; i < terms.size(); ++i) searcher_.termFreqs(terms[i], doc_freqs[i], coll_freqs[i]);
+        return true;
+    }
+    bool startSearch(const std::vector<std::string>& terms, int mode, size_t k, const ShardQueryStats& stats) override {
+        worker_ = std::thread([this, terms, mode, k, stats]() { result_ = searcher_.search(terms, mode, k, stats); });
+        return true;
+    }
+    bool finishSearch(RankedList& top) override {
+        if (worker_.joinable()) worker_.join();
+        top = std::move(result_);
+        return true;
+    }
+    bool passage(uint32_t doc_id, std::string& out) override { return searcher_.passage(doc_id, out); }
+
+private:
+    ShardSearcher searcher_;
+    std::thread worker_;
+    RankedList result_;
+};
+
+// Shard served by another process (query_processor --serve-shard) over TCP
+class RemoteShard : public ShardClient {
+public:
+    ~RemoteShard() override {
+        if (stream_.fd() >= 0) {
+            stream_.sendAll("QUIT\n");
+            ::close(stream_.fd());
+        }
+    }
+
+    // Function to connect to "host:port"
+    bool connect(const std::string& host_port) {
+        size_t colon = host_port.rfind(':');
+        if (colon == std::string::npos) return false;
+        std::string host = host_port.substr(0, colon);
+        std::string port = host_port.substr(colon + 1);
+        addrinfo hints{};
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo* addresses = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses) != 0) return false;
+        int fd = -1;
+        for (addrinfo* a = addresses; a != nullptr && fd < 0; a = a->ai_next) {
+            fd = ::socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+            if (fd >= 0 && ::connect(fd, a->ai_addr, a->ai_addrlen) != 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+        freeaddrinfo(addresses);
+        if (fd < 0) return false;
+        int no_delay = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &no_delay, sizeof(no_delay));
+        stream_ = SocketStream(fd);
+        return true;
+    }
+
+    bool stats(uint64_t& num_docs, uint64_t& total_length) override {
+        std::string line;
+        if (!stream_.sendAll("STATS\n") || !stream_.readLine(line)) return false;
+        std::istringstream iss(line);
+        return static_cast<bool>(iss >> num_docs >> total_length);
+    }
+    bool termFreqs(const std::vector<std::string>& terms, std::vector<uint64_t>& doc_freqs,
+                   std::vector<uint64_t>& coll_freqs) override {
+        std::string request = "DF";
+        for (const auto& term : terms) request += " " + term;
+        std::string line;
+        if (!stream_.sendAll(request + "\n") || !stream_.readLine(line)) return false;
+        std::istringstream iss(line);
+        doc_freqs.assign(terms.size(), 0);
+        coll_freqs.assign(terms.size(), 0);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            if (!(iss >> doc_freqs[i] >> coll_freqs[i])) return false;
+        }
+        return true;
+    }
+    bool startSearch(const std::vector<std::string>& terms, int mode, size_t k, const ShardQueryStats& stats) override {
+        std::ostringstream request;
+        request << "SEARCH " << mode << " " << k << " " << rankingModelName(stats.ranking) << " " << stats.num_docs
+                << " " << stats.total_length << " " << formatExact(stats.avgdl);
+        for (size_t i = 0; i < terms.size(); ++i) {
+            request << " " << terms[i] << " " << stats.doc_freqs[i] << " " << stats.coll_freqs[i];
+        }
+        request << "\n";
+        return stream_.sendAll(request.str());
+    }
+    bool finishSearch(RankedList& top) override {
+        top.clear();
+        std::string line;
+        if (!stream_.readLine(line)) return false;
+        size_t count = std::strtoul(line.c_str(), nullptr, 10);
+        for (size_t i = 0; i < count; ++i) {
+            if (!stream_.readLine(line)) return false;
+            char* end = nullptr;
+            uint32_t doc_id = static_cast<uint32_t>(std::strtoul(line.c_str(), &end, 10));
+            top.emplace_back(doc_id, std::strtod(end, nullptr));
+        }
+        return true;
+    }
+    bool passage(uint32_t doc_id, std::string& out) override {
+        std::string line;
+        if (!stream_.sendAll("PASSAGE " + std::to_string(doc_id) + "\n") || !stream_.readLine(line)) return false;
+        long length = std::strtol(line.c_str(), nullptr, 10);
+        return length >= 0 && stream_.readBytes(static_cast<size_t>(length), out);
+    }
+
+private:
+    SocketStream stream_;
+};
+
+#endif // SHARD_H
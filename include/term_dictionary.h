@@ -0,0 +1,198 @@
+#ifndef TERM_DICTIONARY_H
+#define TERM_DICTIONARY_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "varbyte.h"
+
+// Sorted, front-coded term dictionary ("indexer --term-dict"): the lexicon's terms in
+// lexicographic order, for prefix queries that the lexicon's hash map cannot answer.
+//
+// File:   32-byte header (magic, terms per block, term and block counts), the blocks, then one
+//         uint64 offset per block.
+// Block:  up to TERM_DICT_BLOCK_SIZE terms. Each term is VarByte(shared prefix length with the
+//         previous term) VarByte(suffix length) suffix VarByte(document frequency); the first
+//         term of a block shares nothing, so blocks are binary-searchable by their first term.
+//
+// The reader keeps the file as one byte buffer and decodes terms only while scanning the
+// blocks that can hold a prefix's matches.
+
+const char TERM_DICT_MAGIC[8] = {'W', 'S', 'E', 'T', 'D', 'I', 'C', '1'};
+const uint32_t TERM_DICT_BLOCK_SIZE = 16;
+
+#pragma pack(push, 1)
+struct TermDictHeader {
+    char magic[8];
+    uint32_t block_size;
+    uint32_t reserved;
+    uint64_t num_terms;
+    uint64_t num_blocks;
+};
+#pragma pack(pop)
+
+// Streams terms, which must arrive in increasing order, into a dictionary file
+class TermDictionaryWriter {
+public:
+    bool open(const std::string& path) {
+        out_.open(path, std::ios::binary);
+        if (!out_.is_open()) return false;
+        TermDictHeader header{};
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        offset_ = sizeof(header);
+        return static_cast<bool>(out_);
+    }
+
+    void add(const std::string& term, uint64_t doc_freq) {
+        size_t shared = 0;
+        if (num_terms_ % TERM_DICT_BLOCK_SIZE == 0) {
+            block_offsets_.push_back(offset_);
+        } else {
+            size_t limit = std::min(term.size(), previous_.size());
+            while (shared < limit && term[shared] == previous_[shared]) ++shared;
+        }
+        bytes_.clear();
+        encodeVarByteSingle(static_cast<uint32_t>(shared), bytes_);
+        encodeVarByteSingle(static_cast<uint32_t>(term.size() - shared), bytes_);
+        bytes_.insert(bytes_.end(), term.begin() + shared, term.end());
+        encodeVarByteSingle(static_cast<uint32_t>(std::min<uint64_t>(doc_freq, UINT32_MAX)), bytes_);
+        out_.write(reinterpret_cast<const char*>(bytes_.data()), bytes_.size());
+        offset_ += bytes_.size();
+        previous_ = term;
+        num_terms_++;
+    }
+
+    // Function to write the block offsets and the header; false on any write error
+    bool close() {
+        out_.write(reinterpret_cast<const char*>(block_offsets_.data()), block_offsets_.size() * sizeof(uint64_t));
+        TermDictHeader header{};
+        std::memcpy(header.magic, TERM_DICT_MAGIC, sizeof(header.magic));
+        header.block_size = TERM_DICT_BLOCK_SIZE;
+        header.num_terms = num_terms_;
+        header.num_blocks = block_offsets_.size();
+        out_.seekp(0, std::ios::beg);
+        out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out_.close();
+        return static_cast<bool>(out_);
+    }
+
+    uint64_t numTerms() const { return num_terms_; }
+
+private:
+    std::ofstream out_;
+    uint64_t offset_ = 0;
+    uint64_t num_terms_ = 0;
+    std::string previous_;
+    std::vector<uint8_t> bytes_;
+    std::vector<uint64_t> block_offsets_;
+};
+
+class TermDictionary {
+public:
+    // Function to read the whole dictionary file into memory
+    bool open(const std::string& path) {
+        std::ifstream infile(path, std::ios::binary | std::ios::ate);
+        if (!infile.is_open()) {
+            std::cerr << "Error: Failed to open term dictionary: " << path << std::endl;
+            return false;
+        }
+        data_.resize(static_cast<size_t>(infile.tellg()));
+        infile.seekg(0, std::ios::beg);
+        TermDictHeader header;
+        if (!infile.read(reinterpret_cast<char*>(data_.data()), data_.size()) || data_.size() < sizeof(header)) {
+            std::cerr << "Error: Failed to read term dictionary: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&header, data_.data(), sizeof(header));
+        if (std::memcmp(header.magic, TERM_DICT_MAGIC, sizeof(header.magic)) != 0
+            || data_.size() < sizeof(header) + header.num_blocks * sizeof(uint64_t)) {
+            std::cerr << "Error: Not a term dictionary: " << path << std::endl;
+            return false;
+        }
+        num_terms_ = header.num_terms;
+        block_offsets_.resize(header.num_blocks);
+        std::memcpy(block_offsets_.data(), data_.data() + data_.size() - block_offsets_.size() * sizeof(uint64_t),
+                    block_offsets_.size() * sizeof(uint64_t));
+        return true;
+    }
+
+    uint64_t numTerms() const { return num_terms_; }
+    size_t bytes() const { return data_.size(); }
+
+    // Function to expand `prefix` into its matching terms: fills `out` with at most `limit` of
+    // them, the most frequent first, and returns how many terms match in total
+    size_t expand(const std::string& prefix, size_t limit, std::vector<std::string>& out) const {
+        out.clear();
+        if (block_offsets_.empty() || limit == 0) return 0;
+
+        // Last block whose first term is <= prefix; earlier blocks hold only smaller terms
+        size_t lo = 0, hi = block_offsets_.size();
+        while (hi - lo > 1) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (firstTerm(mid) <= prefix) {
+                lo = mid;
+            } else {
+                hi = mid;
+            }
+        }
+
+        // Scan forward while terms still start with the prefix, keeping the `limit` most
+        // frequent in a min-heap by (doc_freq, reverse term order)
+        std::vector<std::pair<uint64_t, std::string>> best;
+        auto heap_order = [](const auto& a, const auto& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+        size_t matches = 0;
+        std::string term;
+        size_t end = data_.size() - block_offsets_.size() * sizeof(uint64_t);
+        size_t index = block_offsets_[lo];
+        while (index < end) {
+            uint32_t shared = decodeVarByteSingle(data_, index);
+            uint32_t suffix = decodeVarByteSingle(data_, index);
+            if (shared > term.size() || index + suffix > end) {
+                throw std::runtime_error("Term dictionary error: corrupt block.");
+            }
+            term.resize(shared);
+            term.append(reinterpret_cast<const char*>(data_.data() + index), suffix);
+            index += suffix;
+            uint64_t doc_freq = decodeVarByteSingle(data_, index);
+            if (term.compare(0, prefix.size(), prefix) != 0) {
+                if (term > prefix) break; // past every term with the prefix
+                continue;
+            }
+            matches++;
+            if (best.size() < limit) {
+                best.emplace_back(doc_freq, term);
+                std::push_heap(best.begin(), best.end(), heap_order);
+            } else if (heap_order(std::make_pair(doc_freq, term), best.front())) {
+                std::pop_heap(best.begin(), best.end(), heap_order);
+                best.back() = std::make_pair(doc_freq, term);
+                std::push_heap(best.begin(), best.end(), heap_order);
+            }
+        }
+        std::sort_heap(best.begin(), best.end(), heap_order);
+        for (auto& entry : best) {
+            out.push_back(std::move(entry.second));
+        }
+        return matches;
+    }
+
+private:
+    std::string firstTerm(size_t block) const {
+        size_t index = block_offsets_[block];
+        decodeVarByteSingle(data_, index); // shared prefix, always 0
+        uint32_t length = decodeVarByteSingle(data_, index);
+        return std::string(reinterpret_cast<const char*>(data_.data() + index), std::min<size_t>(length, data_.size() - index));
+    }
+
+    std::vector<uint8_t> data_;
+    std::vector<uint64_t> block_offsets_;
+    uint64_t num_terms_ = 0;
+};
+
+#endif // TERM_DICTIONARY_H
@@ -0,0 +1,169 @@
+#ifndef TIERED_INDEX_H
+#define TIERED_INDEX_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cstdint>
+
+#include "index_reader.h"
+#include "block_postings.h"
+#include "async_io.h"
+#include "collection_stats.h"
+#include "ranking.h"
+#include "query_plan.h"
+#include "fusion.h"
+
+// Statically pruned first tier (indexer --tier): a small index holding each term's highest-impact
+// postings, searched before the full index. Every tier lexicon line records the largest frequency
+// and the shortest document among the postings its term left out, which bounds the score any
+// left-out posting can add under every ranking kernel (scores grow with f and shrink with |d|).
+//
+// A tier result is used only when that bound proves it equals the full index's top k, scores
+// included: every returned document must have all of its postings for the query terms in the
+// tier (matched, or its term left nothing out), and the k-th score must beat the best score any
+// other document could reach with the left-out postings added. Otherwise the query falls back
+// to the full index.
+
+class TieredIndex {
+public:
+    // Open <dir>/final_index.bin and lexicon.txt
+    bool open(const std::string& dir, IoBackend backend = IoBackend::Uring) {
+        if (!load_lexicon(dir + "/lexicon.txt", lexicon_)) {
+            return false;
+        }
+        if (!index_file_.open(dir + "/final_index.bin")) {
+            std::cerr << "Error: Failed to open the tier index in: " << dir << std::endl;
+            return false;
+        }
+        layout_ = detect_index_layout(dir + "/final_index.bin");
+        reader_.init(backend, 64, 2);
+        return true;
+    }
+
+    size_t numTerms() const { return lexicon_.size(); }
+
+    // Function to search the tier for the distinct query `terms`, with their full-index
+    // statistics; true if `out` is provably the full index's top k, false to fall back
+    bool search(const std::vector<std::string>& terms, const std::vector<TermStatistics>& term_stats, int mode, size_t k,
+                RankingModel ranking, const RankingContext& context, const CollectionStats& collection, RankedList& out) {
+        if (k == 0) return false;
+        std::vector<LexiconEntry> entries;
+        for (const auto& term : terms) {
+            auto it = lexicon_.find(term);
+            if (it == lexicon_.end()) return false; // tier built from another index
+            entries.push_back(it->second);
+        }
+        std::vector<PostingCursor> cursors;
+        std::vector<bool> ready;
+        fetch_posting_cursors(reader_, index_file_.fd(), layout_, terms, entries, cursors, ready);
+        if (std::find(ready.begin(), ready.end(), false) != ready.end()) return false;
+
+        bool proven = false;
+        with_ranking_kernel(ranking, context, [&](const auto& kernel) {
+            proven = searchTier(kernel, entries, term_stats, cursors, mode, k, collection, out);
+        });
+        return proven;
+    }
+
+private:
+    struct Candidate {
+        uint32_t doc_id;
+        double score; // from the tier's postings
+        bool exact;   // no left-out posting can add to it
+        double bound; // score with every possibly left-out posting added
+    };
+
+    template <class Kernel>
+    static bool searchTier(const Kernel& kernel, const std::vector<LexiconEntry>& entries, const std::vector<TermStatistics>& term_stats,
+                           std::vector<PostingCursor>& cursors, int mode, size_t k, const CollectionStats& collection, RankedList& out) {
+        const double none = -std::numeric_limits<double>::infinity();
+        size_t n = cursors.size();
+
+        // Per term: kernel constants (full-index statistics) and the bound on a left-out posting
+        std::vector<TermWeight> weights(n);
+        std::vector<double> left_out(n, none);
+        bool all_left_out = true;
+        bool any_left_out = false;
+        double unseen = 0.0; // bound of a document with no tier postings at all
+        for (size_t i = 0; i < n; ++i) {
+            weights[i] = kernel.prepare(term_stats[i]);
+            if (entries[i].pruned_max_freq > 0) {
+                left_out[i] = kernel.score(weights[i], entries[i].pruned_max_freq, kernel.docNorm(entries[i].pruned_min_length));
+                unseen += left_out[i];
+                any_left_out = true;
+            } else {
+                all_left_out = false;
+            }
+        }
+        if (mode == 1 ? !all_left_out : !any_left_out) unseen = none;
+
+        // Exhaustive union of the tier lists; the tier is small enough not to need pruning
+        std::vector<Candidate> candidates;
+        double other_bound = unseen; // best score a document that is not a tier result could reach
+        while (true) {
+            bool any = false;
+            uint32_t doc_id = 0;
+            for (auto& cursor : cursors) {
+                if (!cursor.done() && (!any || cursor.docid() < doc_id)) {
+                    doc_id = cursor.docid();
+                    any = true;
+                }
+            }
+            if (!any) break;
+
+            uint32_t doc_length = collection.docLength(doc_id);
+            double norm = kernel.docNorm(doc_length);
+            double score = kernel.docPrior(doc_length);
+            double missing = 0.0;
+            bool exact = true;
+            bool possible = true;
+            for (size_t i = 0; i < n; ++i) {
+                PostingCursor& cursor = cursors[i];
+                if (!cursor.done() && cursor.docid() == doc_id) {
+                    score += kernel.score(weights[i], cursor.freq(), norm);
+                    cursor.next();
+                } else if (left_out[i] == none) {
+                    possible = possible && mode != 1; // the term's full list is in the tier
+                } else {
+                    missing += left_out[i];
+                    exact = false;
+                }
+            }
+            if (!possible) continue;
+            if (mode == 1 && !exact) {
+                // Only a match if its left-out postings exist; never a tier result
+                other_bound = std::max(other_bound, score + missing);
+                continue;
+            }
+            candidates.push_back(Candidate{doc_id, score, exact, score + missing});
+        }
+
+        size_t top = std::min(k, candidates.size());
+        std::partial_sort(candidates.begin(), candidates.begin() + top, candidates.end(), [](const Candidate& a, const Candidate& b) {
+            return a.score > b.score || (a.score == b.score && a.doc_id < b.doc_id);
+        });
+        for (size_t i = 0; i < top; ++i) {
+            if (!candidates[i].exact) return false;
+        }
+        for (size_t i = top; i < candidates.size(); ++i) {
+            other_bound = std::max(other_bound, candidates[i].bound);
+        }
+        if (top < k ? other_bound != none : !(candidates[top - 1].score > other_bound)) return false;
+
+        out.clear();
+        for (size_t i = 0; i < top; ++i) {
+            out.emplace_back(candidates[i].doc_id, candidates[i].score);
+        }
+        return true;
+    }
+
+    std::unordered_map<std::string, LexiconEntry> lexicon_;
+    FileHandle index_file_;
+    IndexLayout layout_ = IndexLayout::Split;
+    AsyncReader reader_;
+};
+
+#endif // TIERED_INDEX_H
@@ -6,6 +6,7 @@
 #include <algorithm>
 #include <cctype>
 #include <sstream>
+#include <cstdint>
 
 // Function to convert string to lowercase
 inline std::string to_lowercase(const std::string& str) {
@@ -56,4 +57,39 @@ inline std::vector<std::string> tokenize(const std::string& text) {
     return tokens;
 }
 
+// Function to tokenize a string while recording the byte offset in the original text
+// where each token's word starts. Produces exactly the tokens of tokenize().
+inline void tokenize_with_offsets(const std::string& text, std::vector<std::string>& tokens, std::vector<uint32_t>& offsets) {
+    tokens.clear();
+    offsets.clear();
+    std::string token;
+    size_t i = 0;
+    while(i < text.size()) {
+        while(i < text.size() && std::isspace(static_cast<unsigned char>(text[i]))) ++i;
+        size_t word_start = i;
+        token.clear();
+        while(i < text.size() && !std::isspace(static_cast<unsigned char>(text[i]))) {
+            unsigned char c = static_cast<unsigned char>(std::tolower(static_cast<unsigned char>(text[i])));
+            if(!std::ispunct(c) && c < 128) { // same filtering as remove_punctuation / remove_non_ascii
+                token += static_cast<char>(c);
+            }
+            ++i;
+        }
+        if(!token.empty()) {
+            tokens.push_back(token);
+            offsets.push_back(static_cast<uint32_t>(word_start));
+        }
+    }
+}
+
+// Function to hash a term to 32 bits (FNV-1a); used to key terms without a lexicon lookup
+inline uint32_t hash_term(const std::string& term) {
+    uint32_t h = 2166136261u;
+    for(char c : term) {
+        h ^= static_cast<unsigned char>(c);
+        h *= 16777619u;
+    }
+    return h;
+}
+
 #endif
\ No newline at end of file
@@ -71,4 +71,37 @@ inline std::vector<uint32_t> decodeVarByteAll(const std::vector<uint8_t>& bytes,
     return numbers;
 }
 
+// Skip over count VarByte-encoded integers without decoding them
+inline void skipVarByteList(const std::vector<uint8_t>& bytes, size_t& index, size_t count) {
+    while (count > 0) {
+        if (index >= bytes.size()) {
+            throw std::runtime_error("VarByte decoding error: not enough bytes to skip the expected count.");
+        }
+        if ((bytes[index++] & 0x80) == 0) {
+            --count;
+        }
+    }
+}
+
+// Decode count integers from a raw byte range starting at index; throws on truncated input
+inline void decodeVarByteRange(const uint8_t* bytes, size_t length, size_t& index, uint32_t* out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t num = 0;
+        uint32_t shift = 0;
+        while (true) {
+            if (index >= length) {
+                throw std::runtime_error("VarByte decoding error: not enough bytes to decode the expected count.");
+            }
+            uint8_t byte = bytes[index++];
+            num |= (static_cast<uint32_t>(byte & 0x7F)) << shift;
+            if (!(byte & 0x80)) break;
+            shift += 7;
+            if (shift > 28) {
+                throw std::runtime_error("VarByte decoding error: shift exceeds 28 bits.");
+            }
+        }
+        out[i] = num;
+    }
+}
+
 #endif // VARBYTE_H
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <exception>
+#include <limits>
+#include "docstore.h"
+
+
+using namespace std;
+
+// Structure to hold one page table row
+struct PassageLocation {
+    uint32_t doc_id;
+    uint64_t offset;
+    size_t length;
+};
+
+int main(int argc, char* argv[]) {
+    size_t block_size = DOCSTORE_DEFAULT_BLOCK_SIZE;
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--block-kb" && i + 1 < argc) {
+            block_size = stoul(argv[++i]) * 1024;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 3) {
+        cerr << "Usage: " << argv[0] << " [--block-kb N] <page_table.txt> <passages.bin> <docstore.bin>" << endl;
+        return 1;
+    }
+
+    string page_table_file = args[0];
+    string passages_file = args[1];
+    string docstore_file = args[2];
+
+    ifstream page_table(page_table_file);
+    if (!page_table.is_open()) {
+        cerr << "Failed to open page table file: " << page_table_file << endl;
+        return 1;
+    }
+
+    vector<PassageLocation> locations;
+    PassageLocation loc;
+    while (page_table >> loc.doc_id >> loc.offset >> loc.length) {
+        locations.push_back(loc);
+        page_table.ignore(numeric_limits<streamsize>::max(), '\n'); // skip any extra columns
+    }
+    page_table.close();
+
+    // Blocks are keyed by docID range, so passages go in docID order. After reorder this
+    // groups similar passages together, which also helps the block compressor.
+    sort(locations.begin(), locations.end(),
+         [](const PassageLocation& a, const PassageLocation& b) { return a.doc_id < b.doc_id; });
+
+    ifstream passages(passages_file, ios::binary);
+    if (!passages.is_open()) {
+        cerr << "Failed to open passages file: " << passages_file << endl;
+        return 1;
+    }
+
+    uint64_t raw_bytes = 0;
+    uint64_t store_bytes = 0;
+    try {
+        DocStoreWriter writer(docstore_file, block_size);
+        vector<char> buffer;
+        for (const auto& l : locations) {
+            // Each passages.bin record is a 4-byte length prefix followed by the passage bytes
+            uint32_t passage_length;
+            passages.seekg(l.offset, ios::beg);
+            if (!passages.read(reinterpret_cast<char*>(&passage_length), sizeof(uint32_t)) || passage_length > l.length) {
+                cerr << "Failed to read passage length for docID: " << l.doc_id << endl;
+                return 1;
+            }
+            buffer.resize(passage_length);
+            if (!passages.read(buffer.data(), passage_length)) {
+                cerr << "Failed to read passage content for docID: " << l.doc_id << endl;
+                return 1;
+            }
+            writer.add(l.doc_id, buffer.data(), passage_length);
+            raw_bytes += sizeof(uint32_t) + passage_length;
+        }
+        store_bytes = writer.finish();
+    } catch (const exception& e) {
+        cerr << "Docstore build error: " << e.what() << endl;
+        return 1;
+    }
+
+    cout << "Docstore written: " << locations.size() << " passages, " << raw_bytes << " -> " << store_bytes
+         << " bytes (" << (raw_bytes ? 100.0 * store_bytes / raw_bytes : 0.0) << "%)." << endl;
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <exception>
+#include "embeddings.h"
+#include "embedding_store.h"
+#include "index_reader.h"
+
+
+using namespace std;
+
+// Build the quantized, docID-indexed embedding store (embeddings_store.bin) used by the
+// query processor to rerank BM25 candidates, from exported float32 passage embeddings.
+
+int main(int argc, char* argv[]) {
+    Quantization quantization = Quantization::Int8;
+    string doc_map_file;
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--quant" && i + 1 < argc) {
+            string value = argv[++i];
+            if (value == "int8") {
+                quantization = Quantization::Int8;
+            } else if (value == "fp16") {
+                quantization = Quantization::Fp16;
+            } else {
+                cerr << "Unknown quantization: " << value << " (expected int8 or fp16)" << endl;
+                return 1;
+            }
+        } else if (arg == "--doc-map" && i + 1 < argc) {
+            doc_map_file = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 2) {
+        cerr << "Usage: " << argv[0] << " [--quant int8|fp16] [--doc-map doc_map.txt] <passage_embeddings.bin> <embeddings_store.bin>" << endl;
+        return 1;
+    }
+
+    EmbeddingMatrix embeddings;
+    try {
+        embeddings = loadEmbeddings(args[0]);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    // Passage ID -> docID; identity unless the collection was reordered
+    vector<uint32_t> doc_ids = embeddings.ids;
+    if (!doc_map_file.empty()) {
+        unordered_map<uint32_t, uint32_t> doc_map;
+        if (!load_doc_map(doc_map_file, doc_map)) {
+            return 1;
+        }
+        size_t dropped = remapToDocIds(embeddings, doc_map, doc_ids);
+        if (dropped > 0) {
+            cout << "Skipped " << dropped << " embeddings with no docID in the doc map." << endl;
+        }
+    }
+
+    uint64_t store_bytes = 0;
+    try {
+        store_bytes = writeEmbeddingStore(args[1], embeddings, doc_ids, quantization);
+    } catch (const exception& e) {
+        cerr << "Embedding store build error: " << e.what() << endl;
+        return 1;
+    }
+
+    uint64_t float_bytes = static_cast<uint64_t>(embeddings.values.size()) * sizeof(float);
+    cout << "Embedding store written: " << embeddings.size() << " vectors of dimension " << embeddings.dim << " as "
+         << (quantization == Quantization::Int8 ? "int8" : "fp16") << ", " << float_bytes << " -> " << store_bytes
+         << " bytes (" << (float_bytes ? 100.0 * store_bytes / float_bytes : 0.0) << "%)." << endl;
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <thread>
+#include <exception>
+#include "embeddings.h"
+#include "hnsw.h"
+#include "index_reader.h"
+
+
+using namespace std;
+
+// Build the in-process HNSW index (hnsw.bin) from the passage embeddings exported by
+// vector_search/export_embeddings.py. Passage IDs are mapped to the index's docIDs through
+// doc_map.txt when the collection was reordered.
+
+int main(int argc, char* argv[]) {
+    size_t m = 16;
+    size_t ef_construction = 100;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    string doc_map_file;
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--m" && i + 1 < argc) {
+            m = stoul(argv[++i]);
+        } else if (arg == "--ef-construction" && i + 1 < argc) {
+            ef_construction = stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = max(1, stoi(argv[++i]));
+        } else if (arg == "--doc-map" && i + 1 < argc) {
+            doc_map_file = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 2) {
+        cerr << "Usage: " << argv[0] << " [--m 16] [--ef-construction 100] [--threads N] [--doc-map doc_map.txt]"
+             << " <passage_embeddings.bin> <hnsw.bin>" << endl;
+        return 1;
+    }
+
+    EmbeddingMatrix embeddings;
+    try {
+        embeddings = loadEmbeddings(args[0]);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    cout << "Loaded " << embeddings.size() << " embeddings of dimension " << embeddings.dim << "." << endl;
+
+    // Passage ID -> docID; identity unless the collection was reordered
+    vector<uint32_t> doc_ids = embeddings.ids;
+    if (!doc_map_file.empty()) {
+        unordered_map<uint32_t, uint32_t> doc_map;
+        if (!load_doc_map(doc_map_file, doc_map)) {
+            return 1;
+        }
+        size_t dropped = remapToDocIds(embeddings, doc_map, doc_ids);
+        if (dropped > 0) {
+            cout << "Skipped " << dropped << " embeddings with no docID in the doc map." << endl;
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    HnswIndex index;
+    try {
+        index.build(std::move(embeddings), std::move(doc_ids), m, ef_construction, threads);
+    } catch (const exception& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+    chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+    if (!index.save(args[1])) {
+        cerr << "Failed to write HNSW index: " << args[1] << endl;
+        return 1;
+    }
+    cout << "HNSW index built over " << index.size() << " passages (M=" << m << ", efConstruction=" << ef_construction
+         << ", " << threads << " threads) in " << elapsed.count() << " seconds." << endl;
+    return 0;
+}
@@ -3,19 +3,37 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <set>
 #include <utility>
 #include <algorithm>
 #include <cstdint>
-#include <sstream>
+#include <cstring>
 #include <queue>
 #include <functional>
 #include <memory>
 #include <exception>
-#include "/Users/ad12/Documents/Develop/wse-hw-2/include/varbyte.h"
+#include <charconv>
+#include <filesystem>
+#include "varbyte.h"
+#include "sequential_io.h"
+#include "block_postings.h"
+#include "collection_stats.h"
+#include "index_reader.h"
+#include "ranking.h"
+#include "tokenizer.h"
+#include "term_dictionary.h"
 
 
 using namespace std;
 
+namespace fs = std::filesystem;
+
+const size_t DEFAULT_FAN_IN = 64; // max runs merged at once; more runs take extra merge passes
+const size_t TIER_MIN_POSTINGS = 10; // term-centric pruning keeps at least a result page per term
+const size_t DEFAULT_PAIR_MIN_DOC_FREQ = 1000; // pair lists only pay off when both terms' lists are long
+const size_t PAIR_COUNTERS_PER_PAIR = 16; // pair counters kept per requested pair list
+const size_t PAIR_MIN_COUNTERS = 1 << 16;
+
 // Structure to hold a term and its postings
 struct TermPostings {
     string term;
@@ -29,23 +47,56 @@ struct TermComparator {
     }
 };
 
-// Function to read the next term and its postings from a file
-bool readNextTerm(ifstream& infile, string& term, vector<pair<uint32_t, uint32_t>>& postings) {
+// Function to parse the next unsigned field of an intermediate line, skipping the separator
+bool parseField(const char*& p, const char* end, uint32_t& value) {
+    while (p < end && (*p == '\t' || *p == ' ')) ++p;
+    auto result = from_chars(p, end, value);
+    if (result.ec != errc()) return false;
+    p = result.ptr;
+    return true;
+}
+
+// Function to read the next term and its postings from a file. When positions is non-null the
+// file was written by "parser --positions" and each posting carries a comma-separated position list.
+bool readNextTerm(SequentialReader& infile, string& term, vector<pair<uint32_t, uint32_t>>& postings,
+                  vector<vector<uint32_t>>* positions = nullptr) {
     postings.clear();
-    string line;
-    if (!getline(infile, line)) {
+    if (positions) positions->clear();
+    static thread_local string line;
+    if (!infile.readLine(line)) {
         return false; // End of file
     }
 
-    istringstream iss(line);
-    if (!(iss >> term)) {
+    size_t tab = line.find('\t');
+    if (tab == 0 || tab == string::npos) {
         cerr << "Invalid line format in intermediate file: " << line << endl;
         return false; // Invalid line
     }
+    term.assign(line, 0, tab);
 
+    const char* p = line.data() + tab;
+    const char* end = line.data() + line.size();
     uint32_t doc_id, freq;
-    while (iss >> doc_id >> freq) {
+    while (parseField(p, end, doc_id) && parseField(p, end, freq)) {
         postings.emplace_back(doc_id, freq);
+        if (positions) {
+            vector<uint32_t> doc_positions;
+            doc_positions.reserve(freq);
+            uint32_t pos;
+            if (p < end && *p == '\t') ++p;
+            while (p < end && *p != '\t') {
+                auto result = from_chars(p, end, pos);
+                if (result.ec != errc()) break;
+                doc_positions.push_back(pos);
+                p = result.ptr;
+                if (p < end && *p == ',') ++p;
+            }
+            if (doc_positions.size() != freq) {
+                cerr << "Position count mismatch for term '" << term << "' in doc " << doc_id << endl;
+                return false;
+            }
+            positions->push_back(std::move(doc_positions));
+        }
     }
 
     if (postings.empty()) {
@@ -56,24 +107,37 @@ bool readNextTerm(ifstream& infile, string& term, vector<pair<uint32_t, uint32_t
     return true;
 }
 
-int main(int argc, char* argv[]) {
-    if (argc < 4) {
-        cerr << "Usage: " << argv[0] << " <intermediate_file1> [<intermediate_file2> ...] <final_index> <lexicon_file>" << endl;
-        return 1;
+// Function to write one merged term back out in the intermediate format, for multi-level merges
+void writeTerm(SequentialWriter& out, const string& term, const vector<pair<uint32_t, uint32_t>>& postings,
+               const vector<vector<uint32_t>>* positions) {
+    out.write(term);
+    for (size_t i = 0; i < postings.size(); ++i) {
+        out.put('\t');
+        out.writeNumber(postings[i].first);
+        out.put('\t');
+        out.writeNumber(postings[i].second);
+        if (positions) {
+            out.put('\t');
+            const auto& doc_positions = (*positions)[i];
+            for (size_t j = 0; j < doc_positions.size(); ++j) {
+                if (j > 0) out.put(',');
+                out.writeNumber(doc_positions[j]);
+            }
+        }
     }
+    out.put('\n');
+}
 
-    // Last two arguments are the final index and lexicon files
-    string final_index_file = argv[argc - 2];
-    string lexicon_file = argv[argc - 1];
-
-    // Open intermediate files
-    size_t num_files = argc - 3;
-    vector<ifstream> intermediate_files(num_files);
+// Function to k-way merge sorted intermediate files, calling emit once per term with the postings
+// of every file that has it (not yet sorted by docID). Returns false if a file cannot be read.
+bool mergeRuns(const vector<string>& files, bool with_positions, bool direct_io, size_t buffer_size,
+               const function<bool(const string&, vector<pair<uint32_t, uint32_t>>&, vector<vector<uint32_t>>&)>& emit) {
+    size_t num_files = files.size();
+    vector<SequentialReader> intermediate_files(num_files);
     for (size_t i = 0; i < num_files; ++i) {
-        intermediate_files[i].open(argv[i + 1]);
-        if (!intermediate_files[i].is_open()) {
-            cerr << "Failed to open intermediate file: " << argv[i + 1] << endl;
-            return 1;
+        if (!intermediate_files[i].open(files[i], direct_io, buffer_size)) {
+            cerr << "Failed to open intermediate file: " << files[i] << endl;
+            return false;
         }
     }
 
@@ -81,28 +145,15 @@ int main(int argc, char* argv[]) {
     priority_queue<pair<string, size_t>, vector<pair<string, size_t>>, TermComparator> min_heap;
     vector<string> current_terms(num_files);
     vector<vector<pair<uint32_t, uint32_t>>> current_postings(num_files);
+    vector<vector<vector<uint32_t>>> current_positions(num_files);
+    auto positionsOf = [&](size_t i) { return with_positions ? &current_positions[i] : nullptr; };
 
     for (size_t i = 0; i < num_files; ++i) {
-        if (readNextTerm(intermediate_files[i], current_terms[i], current_postings[i])) {
+        if (readNextTerm(intermediate_files[i], current_terms[i], current_postings[i], positionsOf(i))) {
             min_heap.emplace(current_terms[i], i);
         }
     }
 
-    // Open final index and lexicon files
-    ofstream final_index(final_index_file, ios::binary);
-    if (!final_index.is_open()) {
-        cerr << "Failed to create final index file: " << final_index_file << endl;
-        return 1;
-    }
-
-    ofstream lexicon(lexicon_file);
-    if (!lexicon.is_open()) {
-        cerr << "Failed to create lexicon file: " << lexicon_file << endl;
-        return 1;
-    }
-
-    uint64_t current_offset = 0;
-
     while (!min_heap.empty()) {
         // Get the smallest term
         auto [term, file_idx] = min_heap.top();
@@ -110,9 +161,10 @@ int main(int argc, char* argv[]) {
 
         // Collect postings for this term from all files
         vector<pair<uint32_t, uint32_t>> merged_postings = std::move(current_postings[file_idx]);
+        vector<vector<uint32_t>> merged_positions = std::move(current_positions[file_idx]);
 
         // Read the next term from the same file
-        if (readNextTerm(intermediate_files[file_idx], current_terms[file_idx], current_postings[file_idx])) {
+        if (readNextTerm(intermediate_files[file_idx], current_terms[file_idx], current_postings[file_idx], positionsOf(file_idx))) {
             min_heap.emplace(current_terms[file_idx], file_idx);
         }
 
@@ -123,61 +175,743 @@ int main(int argc, char* argv[]) {
 
             // Merge postings
             merged_postings.insert(merged_postings.end(), current_postings[idx].begin(), current_postings[idx].end());
+            if (with_positions) {
+                for (auto& doc_positions : current_positions[idx]) {
+                    merged_positions.push_back(std::move(doc_positions));
+                }
+            }
 
             // Read the next term from this file
-            if (readNextTerm(intermediate_files[idx], current_terms[idx], current_postings[idx])) {
+            if (readNextTerm(intermediate_files[idx], current_terms[idx], current_postings[idx], positionsOf(idx))) {
                 min_heap.emplace(current_terms[idx], idx);
             }
         }
 
-        // Sort merged postings by docID
-        sort(merged_postings.begin(), merged_postings.end());
+        if (!emit(term, merged_postings, merged_positions)) {
+            return false;
+        }
+    }
 
-        // Gap encode docIDs
-        vector<uint32_t> doc_gaps;
-        vector<uint32_t> freqs;
-        uint32_t prev_doc_id = 0;
-        for (const auto& [doc_id, freq] : merged_postings) {
-            uint32_t gap = doc_id - prev_doc_id;
-            doc_gaps.push_back(gap);
-            freqs.push_back(freq);
-            prev_doc_id = doc_id;
+    for (size_t i = 0; i < num_files; ++i) {
+        if (intermediate_files[i].failed()) {
+            cerr << "Failed to read intermediate file: " << files[i] << endl;
+            return false;
         }
+    }
+    return true;
+}
 
+// Function to encode one term's docID-sorted postings for an index file at byte `offset`: returns
+// the bytes to append and sets the entry's docID and frequency ranges and document frequency
+vector<uint8_t> encodePostingList(uint64_t offset, bool blocked, const vector<pair<uint32_t, uint32_t>>& postings,
+                                  LexiconEntry& entry) {
+    vector<uint8_t> bytes;
+    entry.doc_freq = postings.size();
+    if (postings.empty()) {
+        entry.docid_offset = entry.freq_offset = offset;
+        entry.docid_length = entry.freq_length = 0;
+        return bytes;
+    }
+
+    // Blocked layout: docIDs and freqs interleaved per block, one region per term (a single
+    // stream in the lexicon)
+    if (blocked) {
+        size_t padding = encode_blocked_postings(offset, postings, bytes);
+        entry.docid_offset = entry.freq_offset = offset + padding;
+        entry.docid_length = bytes.size() - padding;
+        entry.freq_length = 0;
+        return bytes;
+    }
+
+    // Gap encode docIDs
+    vector<uint32_t> doc_gaps;
+    vector<uint32_t> freqs;
+    uint32_t prev_doc_id = 0;
+    for (const auto& [doc_id, freq] : postings) {
+        doc_gaps.push_back(doc_id - prev_doc_id);
+        freqs.push_back(freq);
+        prev_doc_id = doc_id;
+    }
+
+    // Encode docIDs and frequencies using VarByte encoding
+    vector<uint8_t> encoded_freqs;
+    encodeVarByteList(doc_gaps, bytes);
+    encodeVarByteList(freqs, encoded_freqs);
+    entry.docid_offset = offset;
+    entry.docid_length = bytes.size();
+    entry.freq_offset = offset + bytes.size();
+    entry.freq_length = encoded_freqs.size();
+    bytes.insert(bytes.end(), encoded_freqs.begin(), encoded_freqs.end());
+    return bytes;
+}
+
+// Function to write one lexicon line. A pruned tier's lines add the largest frequency and the
+// shortest document length among the term's left-out postings (0 0 if none were left out).
+void writeLexiconEntry(ostream& lexicon, const string& term, const LexiconEntry& entry, bool pruned_tier) {
+    lexicon << term << "\t" << entry.docid_offset << "\t" << entry.docid_length << "\t"
+            << entry.freq_offset << "\t" << entry.freq_length << "\t" << entry.doc_freq << "\t"
+            << entry.pos_offset << "\t" << entry.pos_length << "\t" << entry.coll_freq;
+    if (pruned_tier) {
+        lexicon << "\t" << entry.pruned_max_freq << "\t" << entry.pruned_min_length;
+    }
+    lexicon << "\n";
+}
+
+// Function to read and decode one term's posting list from the index just written; throws on error
+void readPostingList(ifstream& index_file, const LexiconEntry& entry, bool blocked, vector<uint32_t>& doc_ids, vector<uint32_t>& freqs) {
+    vector<uint8_t> encoded_docids, encoded_freqs;
+    if (!read_encoded_postings(index_file, entry, encoded_docids, encoded_freqs)) {
+        throw runtime_error("failed to read the posting list");
+    }
+    if (blocked) {
+        PostingCursor cursor;
+        cursor.reset(std::move(encoded_docids), entry.doc_freq);
+        cursor.decodeAll(doc_ids, freqs);
+    } else {
+        decode_postings(encoded_docids, encoded_freqs, entry.doc_freq, doc_ids, freqs);
+    }
+}
+
+// Function to build a statically pruned first tier from the index just written: tier_dir gets
+// its own final_index.bin and lexicon.txt holding the postings with the highest BM25 impact,
+//   term-centric: the top `keep` fraction of each term's postings (at least a result page)
+//   doc-centric:  the top `keep` fraction of each document's postings
+// Each tier lexicon line records what its term left out, so the query processor can bound the
+// score any left-out posting could add and fall back to the full index when it matters.
+bool buildTier(const string& final_index_file, const string& lexicon_file, bool blocked, const CollectionStats& stats,
+               double keep, bool doc_centric, const string& tier_dir) {
+    unordered_map<string, LexiconEntry> lexicon_map;
+    if (!load_lexicon(lexicon_file, lexicon_map)) {
+        return false;
+    }
+    vector<pair<string, LexiconEntry>> lexicon(lexicon_map.begin(), lexicon_map.end());
+    lexicon_map.clear();
+    sort(lexicon.begin(), lexicon.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    ifstream index_file(final_index_file, ios::binary);
+    if (!index_file.is_open()) {
+        cerr << "Failed to open final index file: " << final_index_file << endl;
+        return false;
+    }
+    vector<uint32_t> doc_ids, freqs;
+    auto readList = [&](const LexiconEntry& entry) { readPostingList(index_file, entry, blocked, doc_ids, freqs); };
+
+    // Impacts are BM25 scores with the collection's statistics
+    Bm25Kernel<> kernel(RankingContext{stats.numDocs(), stats.header.total_tokens, stats.avgdl(), 0});
+    auto slotOf = [&](uint32_t doc_id) { return static_cast<size_t>(doc_id - stats.header.first_doc_id); };
+
+    // Doc-centric: one pass counts each document's postings, a second keeps each document's
+    // top impacts in a bounded min-heap, whose smallest entry is then the document's threshold
+    vector<float> doc_threshold;
+    if (doc_centric) {
+        size_t slots = stats.doc_lengths.size();
+        vector<uint64_t> heap_begin(slots + 1, 0);
         try {
-            // Encode docIDs and frequencies using VarByte encoding
-            vector<uint8_t> encoded_docids;
-            encodeVarByteList(doc_gaps, encoded_docids);
+            for (const auto& [term, entry] : lexicon) {
+                readList(entry);
+                for (uint32_t doc_id : doc_ids) {
+                    if (stats.hasDoc(doc_id)) heap_begin[slotOf(doc_id) + 1]++;
+                }
+            }
+            for (size_t d = 0; d < slots; ++d) {
+                heap_begin[d + 1] = heap_begin[d] + static_cast<uint64_t>(ceil(keep * heap_begin[d + 1]));
+            }
+            vector<float> heaps(heap_begin[slots]);
+            vector<uint32_t> heap_size(slots, 0);
+            for (const auto& [term, entry] : lexicon) {
+                readList(entry);
+                TermWeight weight = kernel.prepare(TermStatistics{entry.doc_freq, entry.coll_freq, 1});
+                for (size_t i = 0; i < doc_ids.size(); ++i) {
+                    if (!stats.hasDoc(doc_ids[i])) continue;
+                    size_t slot = slotOf(doc_ids[i]);
+                    float impact = static_cast<float>(kernel.score(weight, freqs[i], kernel.docNorm(stats.docLength(doc_ids[i]))));
+                    float* heap = heaps.data() + heap_begin[slot];
+                    size_t capacity = heap_begin[slot + 1] - heap_begin[slot];
+                    if (heap_size[slot] < capacity) {
+                        heap[heap_size[slot]++] = impact;
+                        push_heap(heap, heap + heap_size[slot], greater<float>());
+                    } else if (capacity > 0 && impact > heap[0]) {
+                        pop_heap(heap, heap + capacity, greater<float>());
+                        heap[capacity - 1] = impact;
+                        push_heap(heap, heap + capacity, greater<float>());
+                    }
+                }
+            }
+            doc_threshold.assign(slots, numeric_limits<float>::infinity());
+            for (size_t d = 0; d < slots; ++d) {
+                if (heap_size[d] > 0) doc_threshold[d] = heaps[heap_begin[d]];
+            }
+        } catch (const std::runtime_error& e) {
+            cerr << "Failed to build the tier from " << final_index_file << ": " << e.what() << endl;
+            return false;
+        }
+    }
+
+    error_code ec;
+    fs::create_directories(tier_dir, ec);
+    string tier_index_file = (fs::path(tier_dir) / "final_index.bin").string();
+    string tier_lexicon_file = (fs::path(tier_dir) / "lexicon.txt").string();
+    SequentialWriter tier_index;
+    ofstream tier_lexicon(tier_lexicon_file);
+    if (ec || !tier_index.open(tier_index_file) || !tier_lexicon.is_open()) {
+        cerr << "Failed to create the tier index in: " << tier_dir << endl;
+        return false;
+    }
+    uint64_t offset = 0;
+    if (blocked) {
+        vector<char> header(BLOCKED_INDEX_HEADER_SIZE, 0);
+        memcpy(header.data(), BLOCKED_INDEX_MAGIC, sizeof(BLOCKED_INDEX_MAGIC));
+        tier_index.write(header.data(), header.size());
+        offset = header.size();
+    }
+
+    uint64_t total_postings = 0;
+    uint64_t kept_postings = 0;
+    vector<pair<uint32_t, uint32_t>> kept;
+    vector<double> impacts;
+    vector<size_t> order;
+    try {
+        for (const auto& [term, entry] : lexicon) {
+            readList(entry);
+            TermWeight weight = kernel.prepare(TermStatistics{entry.doc_freq, entry.coll_freq, 1});
+            impacts.resize(doc_ids.size());
+            for (size_t i = 0; i < doc_ids.size(); ++i) {
+                impacts[i] = kernel.score(weight, freqs[i], kernel.docNorm(stats.docLength(doc_ids[i])));
+            }
+
+            vector<bool> keep_posting(doc_ids.size(), false);
+            if (doc_centric) {
+                for (size_t i = 0; i < doc_ids.size(); ++i) {
+                    keep_posting[i] = !stats.hasDoc(doc_ids[i]) || static_cast<float>(impacts[i]) >= doc_threshold[slotOf(doc_ids[i])];
+                }
+            } else {
+                size_t count = min(doc_ids.size(), max(static_cast<size_t>(ceil(keep * doc_ids.size())), TIER_MIN_POSTINGS));
+                order.resize(doc_ids.size());
+                for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+                partial_sort(order.begin(), order.begin() + count, order.end(),
+                             [&](size_t a, size_t b) { return impacts[a] > impacts[b] || (impacts[a] == impacts[b] && a < b); });
+                for (size_t i = 0; i < count; ++i) keep_posting[order[i]] = true;
+            }
+
+            LexiconEntry tier_entry;
+            kept.clear();
+            for (size_t i = 0; i < doc_ids.size(); ++i) {
+                if (keep_posting[i]) {
+                    kept.emplace_back(doc_ids[i], freqs[i]);
+                    tier_entry.coll_freq += freqs[i];
+                } else {
+                    uint32_t length = stats.docLength(doc_ids[i]);
+                    if (tier_entry.pruned_max_freq == 0 || length < tier_entry.pruned_min_length) tier_entry.pruned_min_length = length;
+                    tier_entry.pruned_max_freq = max(tier_entry.pruned_max_freq, freqs[i]);
+                }
+            }
+            vector<uint8_t> bytes = encodePostingList(offset, blocked, kept, tier_entry);
+            tier_index.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
+            writeLexiconEntry(tier_lexicon, term, tier_entry, true);
+            offset += bytes.size();
+            total_postings += doc_ids.size();
+            kept_postings += kept.size();
+        }
+    } catch (const std::runtime_error& e) {
+        cerr << "Failed to build the tier from " << final_index_file << ": " << e.what() << endl;
+        return false;
+    }
+    if (!tier_index.close() || !tier_lexicon) {
+        cerr << "Failed to write the tier index in: " << tier_dir << endl;
+        return false;
+    }
+    cout << "Tier (" << (doc_centric ? "doc" : "term") << "-centric, keep " << keep << "): " << kept_postings << " of "
+         << total_postings << " postings, " << offset << " bytes -> " << tier_dir << endl;
+    return true;
+}
+
+// Space-saving heavy-hitters counter over term-ID pairs: at most `capacity` counters, and a new
+// pair takes over the smallest one, inheriting its count. Every pair occurring more than
+// total / capacity times keeps its counter, and no count is over by more than that.
+class PairCounter {
+public:
+    explicit PairCounter(size_t capacity) : capacity_(max<size_t>(1, capacity)) {}
+
+    void add(uint64_t key) {
+        auto it = counts_.find(key);
+        if (it != counts_.end()) {
+            by_count_.erase({it->second, key});
+            by_count_.insert({++it->second, key});
+            return;
+        }
+        uint64_t count = 1;
+        if (counts_.size() >= capacity_) {
+            auto smallest = by_count_.begin();
+            count += smallest->first;
+            counts_.erase(smallest->second);
+            by_count_.erase(smallest);
+        }
+        counts_[key] = count;
+        by_count_.insert({count, key});
+    }
+
+    // Function to return up to `top` (key, count) pairs, highest count first, ties by lower key
+    vector<pair<uint64_t, uint64_t>> top(size_t top) const {
+        vector<pair<uint64_t, uint64_t>> best(counts_.begin(), counts_.end());
+        size_t selected = min(top, best.size());
+        partial_sort(best.begin(), best.begin() + selected, best.end(), [](const auto& x, const auto& y) {
+            return x.second > y.second || (x.second == y.second && x.first < y.first);
+        });
+        best.resize(selected);
+        return best;
+    }
+
+private:
+    size_t capacity_;
+    unordered_map<uint64_t, uint64_t> counts_;  // pair -> count
+    set<pair<uint64_t, uint64_t>> by_count_;     // (count, pair), smallest first
+};
+
+// Function to append precomputed pair lists for the `pairs_top` most frequent adjacent term pairs
+// of `pairs_from` (a query log or the collection: "id<TAB>text" or plain text lines) whose terms
+// are both in at least `min_doc_freq` documents. A pair (a, b) adds two entries to the index and
+// lexicon: "a+b" holds a's postings in the documents that also contain b, and "b+a" the reverse,
+// so a conjunctive query with both terms reads two short lists and scores them exactly as it
+// would the full ones.
+bool buildPairs(const string& final_index_file, const string& lexicon_file, bool blocked, const string& pairs_from, size_t pairs_top,
+                size_t min_doc_freq) {
+    unordered_map<string, LexiconEntry> lexicon;
+    if (!load_lexicon(lexicon_file, lexicon)) {
+        return false;
+    }
+    error_code ec;
+    uint64_t offset = fs::file_size(final_index_file, ec);
+    if (ec) {
+        cerr << "Failed to open the final index for pair lists: " << final_index_file << endl;
+        return false;
+    }
+
+    // Pair lists from an earlier run sit at the end of the index and are replaced, not duplicated
+    for (auto it = lexicon.begin(); it != lexicon.end();) {
+        if (it->first.find('+') == string::npos) {
+            ++it;
+            continue;
+        }
+        offset = min(offset, it->second.docid_offset);
+        it = lexicon.erase(it);
+    }
 
-            vector<uint8_t> encoded_freqs;
-            encodeVarByteList(freqs, encoded_freqs);
+    // Adjacent token pairs are counted in either order, among terms with long lists
+    ifstream source(pairs_from);
+    if (!source.is_open()) {
+        cerr << "Failed to open pair source file: " << pairs_from << endl;
+        return false;
+    }
+
+    // Terms with long lists get IDs in lexicographic order, so a pair key (lower ID, higher ID)
+    // sorts like "a+b" does
+    vector<string> id_terms;
+    for (const auto& [term, entry] : lexicon) {
+        if (entry.doc_freq >= min_doc_freq) id_terms.push_back(term);
+    }
+    sort(id_terms.begin(), id_terms.end());
+    unordered_map<string, uint32_t> term_ids;
+    for (size_t id = 0; id < id_terms.size(); ++id) {
+        term_ids[id_terms[id]] = static_cast<uint32_t>(id);
+    }
+
+    // Count the most frequent pairs in bounded memory, however many distinct pairs the source has
+    PairCounter pair_counts(max(pairs_top * PAIR_COUNTERS_PER_PAIR, PAIR_MIN_COUNTERS));
+    string line;
+    while (getline(source, line)) {
+        size_t tab = line.find('\t');
+        vector<string> tokens = tokenize(tab == string::npos ? line : line.substr(tab + 1));
+        for (size_t i = 0; i + 1 < tokens.size(); ++i) {
+            auto a = term_ids.find(tokens[i]);
+            auto b = term_ids.find(tokens[i + 1]);
+            if (a == term_ids.end() || b == term_ids.end() || a->second == b->second) continue;
+            uint64_t low = min(a->second, b->second);
+            uint64_t high = max(a->second, b->second);
+            pair_counts.add(low << 32 | high);
+        }
+    }
+    vector<pair<string, uint64_t>> pairs;
+    for (const auto& [key, count] : pair_counts.top(pairs_top)) {
+        pairs.emplace_back(id_terms[key >> 32] + "+" + id_terms[key & UINT32_MAX], count);
+    }
+
+    // The pair lists go into copies of the index and lexicon, which replace them only once complete
+    string index_tmp = final_index_file + ".tmp";
+    string lexicon_tmp = lexicon_file + ".tmp";
+    auto discard = [&]() {
+        error_code ignored;
+        fs::remove(index_tmp, ignored);
+        fs::remove(lexicon_tmp, ignored);
+    };
+    fs::copy_file(final_index_file, index_tmp, fs::copy_options::overwrite_existing, ec);
+    if (!ec) fs::resize_file(index_tmp, offset, ec);
+    ifstream index_file(final_index_file, ios::binary);
+    ifstream lexicon_in(lexicon_file);
+    ofstream index_out(index_tmp, ios::binary | ios::app);
+    ofstream lexicon_out(lexicon_tmp);
+    if (ec || !index_file.is_open() || !lexicon_in.is_open() || !index_out.is_open() || !lexicon_out.is_open()) {
+        cerr << "Failed to open the final index for pair lists: " << final_index_file << endl;
+        discard();
+        return false;
+    }
+    string lexicon_line;
+    while (getline(lexicon_in, lexicon_line)) {
+        if (lexicon_line.substr(0, lexicon_line.find('\t')).find('+') == string::npos) {
+            lexicon_out << lexicon_line << "\n";
+        }
+    }
+
+    // Intersect each pair's lists and append both halves after the single-term lists
+    uint64_t start_offset = offset;
+    uint64_t pair_postings = 0;
+    size_t written = 0;
+    vector<uint32_t> doc_ids[2], freqs[2];
+    vector<pair<uint32_t, uint32_t>> halves[2];
+    try {
+        for (const auto& [key, count] : pairs) {
+            size_t plus = key.find('+');
+            string terms[2] = {key.substr(0, plus), key.substr(plus + 1)};
+            for (int t = 0; t < 2; ++t) {
+                readPostingList(index_file, lexicon[terms[t]], blocked, doc_ids[t], freqs[t]);
+                halves[t].clear();
+            }
+            for (size_t i = 0, j = 0; i < doc_ids[0].size() && j < doc_ids[1].size();) {
+                if (doc_ids[0][i] < doc_ids[1][j]) {
+                    ++i;
+                } else if (doc_ids[1][j] < doc_ids[0][i]) {
+                    ++j;
+                } else {
+                    halves[0].emplace_back(doc_ids[0][i], freqs[0][i]);
+                    halves[1].emplace_back(doc_ids[1][j], freqs[1][j]);
+                    ++i;
+                    ++j;
+                }
+            }
+            if (halves[0].empty()) continue; // nothing to precompute: the intersection is cheap
+
+            for (int t = 0; t < 2; ++t) {
+                LexiconEntry entry;
+                vector<uint8_t> bytes = encodePostingList(offset, blocked, halves[t], entry);
+                for (const auto& posting : halves[t]) {
+                    entry.coll_freq += posting.second;
+                }
+                index_out.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
+                writeLexiconEntry(lexicon_out, terms[t] + "+" + terms[1 - t], entry, false);
+                offset += bytes.size();
+                pair_postings += halves[t].size();
+            }
+            written++;
+        }
+    } catch (const std::runtime_error& e) {
+        cerr << "Failed to build pair lists from " << final_index_file << ": " << e.what() << endl;
+        discard();
+        return false;
+    }
+    index_out.close();
+    lexicon_out.close();
+    if (!index_out || !lexicon_out) {
+        cerr << "Failed to write pair lists to: " << final_index_file << endl;
+        discard();
+        return false;
+    }
+    fs::rename(index_tmp, final_index_file, ec);
+    if (!ec) fs::rename(lexicon_tmp, lexicon_file, ec);
+    if (ec) {
+        cerr << "Failed to replace the final index with its pair lists: " << ec.message() << endl;
+        discard();
+        return false;
+    }
+    cout << "Pairs: " << written << " pair lists mined from " << pairs_from << ", " << pair_postings << " postings, "
+         << offset - start_offset << " bytes." << endl;
+    return true;
+}
 
-            // Write encoded postings to the final index file
-            final_index.write(reinterpret_cast<char*>(encoded_docids.data()), encoded_docids.size());
-            final_index.write(reinterpret_cast<char*>(encoded_freqs.data()), encoded_freqs.size());
+int main(int argc, char* argv[]) {
+    string positions_file;
+    string tmp_dir;
+    size_t fan_in = DEFAULT_FAN_IN;
+    bool direct_io = false;
+    string layout = "split";
+    string stats_file;
+    string tier_dir;
+    double tier_keep = 0.1;
+    string tier_pruning = "term";
+    string pairs_from;
+    size_t pairs_top = 1000;
+    size_t pairs_min_df = DEFAULT_PAIR_MIN_DOC_FREQ;
+    string term_dict_file;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--direct-io") {
+            direct_io = true;
+        } else if (arg.rfind("--", 0) == 0) {
+            // Every other option takes a value; an unknown one would otherwise become a run file
+            if (i + 1 >= argc) {
+                cerr << "Missing value for option: " << arg << endl;
+                return 1;
+            }
+            string value = argv[++i];
+            try {
+                if (arg == "--positions") positions_file = value;
+                else if (arg == "--fan-in") fan_in = max<size_t>(2, stoul(value));
+                else if (arg == "--tmp-dir") tmp_dir = value;
+                else if (arg == "--layout") layout = value;
+                else if (arg == "--stats") stats_file = value;
+                else if (arg == "--tier") tier_dir = value;
+                else if (arg == "--tier-keep") tier_keep = stod(value);
+                else if (arg == "--tier-pruning") tier_pruning = value;
+                else if (arg == "--pairs-from") pairs_from = value;
+                else if (arg == "--pairs-top") pairs_top = stoul(value);
+                else if (arg == "--pairs-min-df") pairs_min_df = stoul(value);
+                else if (arg == "--term-dict") term_dict_file = value;
+                else {
+                    cerr << "Unknown option: " << arg << endl;
+                    return 1;
+                }
+            } catch (const exception&) {
+                cerr << "Invalid value for " << arg << ": " << value << endl;
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 3) {
+        cerr << "Usage: " << argv[0] << " [--positions <positions_file>] [--fan-in 64] [--tmp-dir dir] [--direct-io] [--layout split|blocked]"
+             << " [--stats collection_stats.bin] [--tier tier_dir [--tier-keep 0.1] [--tier-pruning term|doc]]"
+             << " [--pairs-from queries.tsv [--pairs-top 1000] [--pairs-min-df 1000]] [--term-dict terms.bin]"
+             << " <intermediate_file1> [<intermediate_file2> ...] <final_index> <lexicon_file>" << endl;
+        return 1;
+    }
 
-            // Write term information to the lexicon
-            uint64_t freq_offset = current_offset + encoded_docids.size();
-            lexicon << term << "\t" << current_offset << "\t" << encoded_docids.size() << "\t"
-                    << freq_offset << "\t" << encoded_freqs.size() << "\t" << merged_postings.size() << "\n";
+    if (layout != "split" && layout != "blocked") {
+        cerr << "Unknown index layout: " << layout << " (expected split or blocked)" << endl;
+        return 1;
+    }
+    bool blocked = layout == "blocked";
+    if ((tier_pruning != "term" && tier_pruning != "doc") || tier_keep <= 0 || tier_keep > 1) {
+        cerr << "Invalid tier options: --tier-pruning term|doc with --tier-keep in (0, 1]" << endl;
+        return 1;
+    }
+
+    // Last two arguments are the final index and lexicon files
+    string final_index_file = args[args.size() - 2];
+    string lexicon_file = args[args.size() - 1];
+    bool with_positions = !positions_file.empty();
+    vector<string> runs(args.begin(), args.end() - 2);
+
+    // Every open run holds one read buffer, so the fan-in bounds merge memory
+    // (64 runs x 4 MB = 256 MB by default)
+    const size_t buffer_size = SEQUENTIAL_IO_DEFAULT_BUFFER;
+
+    // Merge passes: while there are more runs than the fan-in, merge groups of fan_in runs into
+    // larger runs in tmp_dir (default: next to the final index). Input runs are left in place;
+    // runs written by an earlier pass are removed once merged.
+    if (tmp_dir.empty()) {
+        tmp_dir = fs::path(final_index_file).parent_path().string();
+        if (tmp_dir.empty()) tmp_dir = ".";
+    }
+    vector<string> own_runs;
+    for (int level = 1; runs.size() > fan_in; ++level) {
+        vector<string> next_runs;
+        for (size_t group = 0; group * fan_in < runs.size(); ++group) {
+            vector<string> inputs(runs.begin() + group * fan_in, runs.begin() + min(runs.size(), (group + 1) * fan_in));
+            if (inputs.size() == 1) {
+                next_runs.push_back(inputs[0]);
+                continue;
+            }
+            string merged_file = tmp_dir + "/merge_" + to_string(level) + "_" + to_string(group + 1) + ".txt";
+            SequentialWriter merged;
+            if (!merged.open(merged_file, direct_io, buffer_size)) {
+                cerr << "Failed to create merge file: " << merged_file << endl;
+                return 1;
+            }
+            bool ok = mergeRuns(inputs, with_positions, direct_io, buffer_size,
+                                [&](const string& term, vector<pair<uint32_t, uint32_t>>& postings, vector<vector<uint32_t>>& positions) {
+                                    writeTerm(merged, term, postings, with_positions ? &positions : nullptr);
+                                    return !merged.failed();
+                                });
+            if (!merged.close() || !ok) {
+                cerr << "Failed to write merge file: " << merged_file << endl;
+                return 1;
+            }
+            next_runs.push_back(merged_file);
+        }
+        for (const string& run : own_runs) {
+            if (find(next_runs.begin(), next_runs.end(), run) == next_runs.end()) fs::remove(run);
+        }
+        own_runs.clear();
+        for (const string& run : next_runs) {
+            if (run.rfind(tmp_dir + "/merge_", 0) == 0) own_runs.push_back(run);
+        }
+        cout << "Merge pass " << level << ": " << runs.size() << " runs -> " << next_runs.size() << " runs." << endl;
+        runs.swap(next_runs);
+    }
+
+    // Open final index and lexicon files
+    SequentialWriter final_index;
+    if (!final_index.open(final_index_file, direct_io, buffer_size)) {
+        cerr << "Failed to create final index file: " << final_index_file << endl;
+        return 1;
+    }
+
+    ofstream lexicon(lexicon_file);
+    if (!lexicon.is_open()) {
+        cerr << "Failed to create lexicon file: " << lexicon_file << endl;
+        return 1;
+    }
+
+    // Positions live in their own file so non-phrase queries never read them
+    SequentialWriter positions_out;
+    if (with_positions) {
+        if (!positions_out.open(positions_file, direct_io, buffer_size)) {
+            cerr << "Failed to create positions file: " << positions_file << endl;
+            return 1;
+        }
+    }
+
+    // Terms leave the merge in sorted order, so the prefix dictionary is written as they go
+    TermDictionaryWriter term_dict;
+    bool with_term_dict = !term_dict_file.empty();
+    if (with_term_dict && !term_dict.open(term_dict_file)) {
+        cerr << "Failed to create term dictionary file: " << term_dict_file << endl;
+        return 1;
+    }
+
+    uint64_t current_offset = 0;
+    uint64_t positions_offset = 0;
+    uint64_t num_terms = 0;
+    uint64_t num_postings = 0;
+
+    // The blocked layout is marked by a magic header, padded to a cache line
+    if (blocked) {
+        vector<char> header(BLOCKED_INDEX_HEADER_SIZE, 0);
+        memcpy(header.data(), BLOCKED_INDEX_MAGIC, sizeof(BLOCKED_INDEX_MAGIC));
+        final_index.write(header.data(), header.size());
+        current_offset = header.size();
+    }
+
+    // Sort, gap encode and write one term's postings, and its lexicon entry
+    auto encodeTerm = [&](const string& term, vector<pair<uint32_t, uint32_t>>& merged_postings,
+                          vector<vector<uint32_t>>& merged_positions) {
+        // Sort merged postings by docID, keeping each posting's positions alongside
+        if (with_positions) {
+            vector<size_t> order(merged_postings.size());
+            for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+            sort(order.begin(), order.end(), [&](size_t a, size_t b) { return merged_postings[a] < merged_postings[b]; });
+            vector<pair<uint32_t, uint32_t>> sorted_postings;
+            vector<vector<uint32_t>> sorted_positions;
+            sorted_postings.reserve(order.size());
+            sorted_positions.reserve(order.size());
+            for (size_t i : order) {
+                sorted_postings.push_back(merged_postings[i]);
+                sorted_positions.push_back(std::move(merged_positions[i]));
+            }
+            merged_postings.swap(sorted_postings);
+            merged_positions.swap(sorted_positions);
+        } else {
+            sort(merged_postings.begin(), merged_postings.end());
+        }
+
+        try {
+            // Encode the postings and write them to the final index file
+            LexiconEntry entry;
+            vector<uint8_t> bytes = encodePostingList(current_offset, blocked, merged_postings, entry);
+            final_index.write(reinterpret_cast<char*>(bytes.data()), bytes.size());
+
+            // Positions: per posting, freq gap-encoded positions, in docID order
+            if (with_positions) {
+                vector<uint32_t> position_gaps;
+                for (const auto& doc_positions : merged_positions) {
+                    uint32_t prev_pos = 0;
+                    for (uint32_t pos : doc_positions) {
+                        position_gaps.push_back(pos - prev_pos);
+                        prev_pos = pos;
+                    }
+                }
+                vector<uint8_t> encoded_positions;
+                encodeVarByteList(position_gaps, encoded_positions);
+                positions_out.write(reinterpret_cast<char*>(encoded_positions.data()), encoded_positions.size());
+                entry.pos_offset = positions_offset;
+                entry.pos_length = encoded_positions.size();
+                positions_offset += encoded_positions.size();
+            }
+
+            // Collection frequency, for query likelihood scoring
+            for (const auto& posting : merged_postings) {
+                entry.coll_freq += posting.second;
+            }
+            writeLexiconEntry(lexicon, term, entry, false);
+            if (with_term_dict) {
+                term_dict.add(term, entry.doc_freq);
+            }
+            num_terms++;
+            num_postings += merged_postings.size();
 
             // Update the current offset
-            current_offset += encoded_docids.size() + encoded_freqs.size();
+            current_offset += bytes.size();
         } catch (const std::runtime_error& e) {
             cerr << "Encoding error for term '" << term << "': " << e.what() << endl;
             // Optionally, skip this term or handle the error as needed
-            continue;
+            return true;
         }
-    }
+        return !final_index.failed() && !positions_out.failed();
+    };
+    bool merged_ok = mergeRuns(runs, with_positions, direct_io, buffer_size, encodeTerm);
 
     // Close all files
-    final_index.close();
+    bool written = final_index.close();
     lexicon.close();
-    for (auto& infile : intermediate_files) {
-        infile.close();
+    if (with_positions) {
+        written = positions_out.close() && written;
+    }
+    if (with_term_dict) {
+        written = term_dict.close() && written;
+    }
+    for (const string& run : own_runs) {
+        fs::remove(run);
+    }
+    if (!merged_ok || !written || !lexicon) {
+        cerr << "Failed to write the final index: " << final_index_file << endl;
+        return 1;
     }
 
     cout << "Indexing completed. Final inverted index and lexicon are created." << endl;
 
+    // Record the index's term and posting counts in the parser's collection stats (default: the
+    // collection_stats.bin next to the final index), rewriting only the header
+    bool stats_given = !stats_file.empty();
+    if (!stats_given) {
+        stats_file = (fs::path(final_index_file).parent_path() / "collection_stats.bin").string();
+    }
+    CollectionStatsHeader stats_header;
+    if (read_collection_stats_header(stats_file, stats_header)) {
+        stats_header.num_terms = num_terms;
+        stats_header.num_postings = num_postings;
+        if (!write_collection_stats_header(stats_file, stats_header)) {
+            return 1;
+        }
+        cout << "Updated " << stats_file << ": " << num_terms << " terms, " << num_postings << " postings." << endl;
+    } else if (stats_given) {
+        cerr << "Failed to read collection stats file: " << stats_file << endl;
+        return 1;
+    }
+
+    // The pruned first tier scores postings with the collection's document lengths
+    if (!tier_dir.empty()) {
+        CollectionStats stats;
+        if (!load_collection_stats(stats_file, stats)
+            || !buildTier(final_index_file, lexicon_file, blocked, stats, tier_keep, tier_pruning == "doc", tier_dir)) {
+            return 1;
+        }
+    }
+
+    // Pair lists go after the tier, which only prunes single-term lists
+    if (!pairs_from.empty() && !buildPairs(final_index_file, lexicon_file, blocked, pairs_from, pairs_top, pairs_min_df)) {
+        return 1;
+    }
+
     return 0;
 }
@@ -6,7 +6,10 @@
 #include <utility>
 #include <algorithm>
 #include <filesystem>
-#include "/Users/ad12/Documents/Develop/wse-hw-2/include/tokenizer.h"
+#include "tokenizer.h"
+#include "forward_index.h"
+#include "sequential_io.h"
+#include "collection_stats.h"
 
 
 
@@ -14,37 +17,116 @@ using namespace std; // ---change for defined std-----
 
 namespace fs = std::filesystem;
 
-const size_t MAX_INTERMEDIATE_FILE_SIZE = 1 * 1024 * 1024 * 1024; // 1GB ---- max size for intermeduate files
+const size_t DEFAULT_RUN_MEMORY_MB = 1024; // in-memory postings budget per intermediate run
+
+// Rough heap cost of the postings map, used to cut a run before it outgrows the budget:
+// hash node, key string and vector header per term; a (docID, freq) pair with vector slack
+// per posting; the position string plus its header with --positions.
+const size_t TERM_OVERHEAD_BYTES = 96;
+const size_t POSTING_BYTES = 12;
+const size_t POSITIONS_OVERHEAD_BYTES = 32;
+
+using PostingsMap = std::unordered_map<std::string, std::vector<std::pair<uint32_t, uint32_t>>>;
+using PositionsMap = std::unordered_map<std::string, std::vector<std::string>>;
+
+// Function to write one sorted intermediate file. Each line is "term\tdocID\tfreq..." and, when
+// positions are recorded, every posting carries a third field of comma-separated token positions.
+bool write_intermediate_file(const std::string& intermediate_file, PostingsMap& postings_map,
+                             PositionsMap& positions_map, bool with_positions) {
+    SequentialWriter outfile;
+    if(!outfile.open(intermediate_file)) {
+        std::cerr << "Failed to open intermediate file: " << intermediate_file << std::endl;
+        return false;
+    }
+
+    // extract, sort terms lexicographically
+    std::vector<PostingsMap::iterator> terms;
+    terms.reserve(postings_map.size());
+    for(auto it = postings_map.begin(); it != postings_map.end(); ++it) {
+        terms.push_back(it);
+    }
+    std::sort(terms.begin(), terms.end(), [](const auto& a, const auto& b) { return a->first < b->first; });
+
+    for(const auto& it : terms) {
+        const std::string& term = it->first;
+        const auto& postings = it->second;
+        const std::vector<std::string>* positions = with_positions ? &positions_map[term] : nullptr;
+        outfile.write(term);
+        for(size_t i = 0; i < postings.size(); ++i) {
+            outfile.put('\t');
+            outfile.writeNumber(postings[i].first);
+            outfile.put('\t');
+            outfile.writeNumber(postings[i].second);
+            if(positions) {
+                outfile.put('\t');
+                outfile.write((*positions)[i]);
+            }
+        }
+        outfile.put('\n');
+    }
+
+    if(!outfile.close()) {
+        std::cerr << "Failed to write intermediate file: " << intermediate_file << std::endl;
+        return false;
+    }
+    std::cout << "Written intermediate file: " << intermediate_file << std::endl;
+    return true;
+}
 
 int main(int argc, char* argv[]) {
-    if(argc < 3) {
-        std::cerr << "Usage: " << argv[0] << " <input_tsv_file> <output_directory>" << std::endl;
+    bool with_positions = false;
+    size_t memory_mb = DEFAULT_RUN_MEMORY_MB;
+    std::string tmp_dir;
+    std::vector<std::string> args;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--positions") {
+            with_positions = true;
+        } else if(arg == "--memory-mb" && i + 1 < argc) {
+            memory_mb = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if(arg == "--tmp-dir" && i + 1 < argc) {
+            tmp_dir = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() < 2) {
+        std::cerr << "Usage: " << argv[0] << " [--positions] [--memory-mb 1024] [--tmp-dir dir] <input_tsv_file> <output_directory>" << std::endl;
         return 1;
     }
 
-    std::string input_file = argv[1];
-    std::string output_dir = argv[2];
+    std::string input_file = args[0];
+    std::string output_dir = args[1];
+    // intermediate runs may go to a different device than the final outputs
+    if(tmp_dir.empty()) tmp_dir = output_dir;
+    const size_t memory_budget = memory_mb * 1024 * 1024;
 
-    if(!fs::exists(output_dir)) {  // check if output directory exists; if not, create it
-        if(!fs::create_directories(output_dir)) {
-            std::cerr << "Failed to create output directory: " << output_dir << std::endl;
-            return 1;
+    for(const std::string& dir : {output_dir, tmp_dir}) {
+        if(!fs::exists(dir)) {  // check if output directory exists; if not, create it
+            if(!fs::create_directories(dir)) {
+                std::cerr << "Failed to create output directory: " << dir << std::endl;
+                return 1;
+            }
         }
     }
 
-    std::ifstream infile(input_file);
-    if(!infile.is_open()) {
+    SequentialReader infile;
+    if(!infile.open(input_file)) {
         std::cerr << "Failed to open input file: " << input_file << std::endl;
         return 1;
     }
 
-    size_t current_size = 0;
+    size_t current_size = 0; // estimated bytes held by postings_map and positions_map
     int file_count = 1;
-    // using unordered_map to store postings; for large-scale, ----------------consider more memory-efficient structures-------------
-    std::unordered_map<std::string, std::vector<std::pair<uint32_t, uint32_t>>> postings_map;
+    PostingsMap postings_map;
+    PositionsMap positions_map; // only filled with --positions
     std::string line;
 
-    uint64_t total_tokens = 0;
+    CollectionStats stats; // document lengths and collection totals, saved as collection_stats.bin
+    std::vector<std::string> tokens;
+    std::vector<uint32_t> token_offsets;
+    std::vector<uint8_t> forward_record;
 
     // passages.bin
     std::ofstream passages_file(output_dir + "/passages.bin", std::ios::binary);
@@ -60,14 +142,14 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    // doc_lengths.txt
-    std::ofstream doc_length_file(output_dir + "/doc_lengths.txt");
-    if(!doc_length_file.is_open()) {
-        std::cerr << "Failed to create doc_lengths.txt in " << output_dir << std::endl;
+    // forward.bin: per-passage token stream for query-biased snippets
+    std::ofstream forward_file(output_dir + "/forward.bin", std::ios::binary);
+    if(!forward_file.is_open()) {
+        std::cerr << "Failed to create forward.bin in " << output_dir << std::endl;
         return 1;
     }
 
-    while(std::getline(infile, line)) {
+    while(infile.readLine(line)) {
         if(line.empty()) continue;
 
         // extract docID and passage
@@ -88,12 +170,12 @@ int main(int argc, char* argv[]) {
             continue;
         }
 
-        // tokenize passage
-        std::vector<std::string> tokens = tokenize(passage);
+        // tokenize passage, keeping each token's byte offset for the forward index
+        tokenize_with_offsets(passage, tokens, token_offsets);
 
-        total_tokens += tokens.size();
-
-        doc_length_file << doc_id << "\t" << tokens.size() << "\n";
+        if (!stats.addDocument(doc_id, static_cast<uint32_t>(tokens.size()))) {
+            continue;
+        }
 
         uint64_t offset = passages_file.tellp();
         // write passage length as a 4-byte unsigned integer
@@ -104,97 +186,86 @@ int main(int argc, char* argv[]) {
         passages_file.write(reinterpret_cast<char*>(&passage_length), sizeof(uint32_t));
         passages_file.write(passage.c_str(), passage.size());
 
-        // page_table.txt: docID, offset, length
-        page_table_file << doc_id << "\t" << offset << "\t" << passage.size() << "\n";
+        forward_record.clear();
+        encodeForwardRecord(tokens, token_offsets, forward_record);
+        uint64_t forward_offset = forward_file.tellp();
+        forward_file.write(reinterpret_cast<const char*>(forward_record.data()), forward_record.size());
+
+        // page_table.txt: docID, offset, length, forward offset, forward length
+        page_table_file << doc_id << "\t" << offset << "\t" << passage.size() << "\t"
+                        << forward_offset << "\t" << forward_record.size() << "\n";
+
+        if(with_positions) {
+            // collect token positions; freq is the number of positions
+            std::unordered_map<std::string, std::string> term_positions;
+            std::unordered_map<std::string, uint32_t> term_freq;
+            for(size_t pos = 0; pos < tokens.size(); ++pos) {
+                std::string& list = term_positions[tokens[pos]];
+                if(!list.empty()) list += ',';
+                list += std::to_string(pos);
+                term_freq[tokens[pos]]++;
+            }
 
-        // count term frequencies
-        std::unordered_map<std::string, uint32_t> term_freq;
-        for(const auto& token : tokens) {
-            term_freq[token]++;
-        }
+            for(auto& [term, freq] : term_freq) {
+                auto [it, inserted] = postings_map.try_emplace(term);
+                it->second.emplace_back(doc_id, freq);
+                std::string& doc_positions = term_positions[term];
+                current_size += (inserted ? TERM_OVERHEAD_BYTES * 2 + term.size() : 0) + POSTING_BYTES +
+                                POSITIONS_OVERHEAD_BYTES + doc_positions.size();
+                positions_map[term].push_back(std::move(doc_positions));
+            }
+        } else {
+            // count term frequencies
+            std::unordered_map<std::string, uint32_t> term_freq;
+            for(const auto& token : tokens) {
+                term_freq[token]++;
+            }
 
-        for(const auto& [term, freq] : term_freq) {
-            postings_map[term].emplace_back(doc_id, freq);
+            for(const auto& [term, freq] : term_freq) {
+                auto [it, inserted] = postings_map.try_emplace(term);
+                it->second.emplace_back(doc_id, freq);
+                current_size += (inserted ? TERM_OVERHEAD_BYTES + term.size() : 0) + POSTING_BYTES;
+            }
         }
 
-        // estimate current_size ----------(simplistic approach)---------
-        current_size += line.size();
-        if(current_size >= MAX_INTERMEDIATE_FILE_SIZE) {
-            std::string intermediate_file = output_dir + "/intermediate_" + std::to_string(file_count) + ".txt";
-            std::ofstream outfile(intermediate_file);
-            if(!outfile.is_open()) {
-                std::cerr << "Failed to open intermediate file: " << intermediate_file << std::endl;
+        // cut a run once the in-memory postings reach the budget
+        if(current_size >= memory_budget) {
+            std::string intermediate_file = tmp_dir + "/intermediate_" + std::to_string(file_count) + ".txt";
+            if(!write_intermediate_file(intermediate_file, postings_map, positions_map, with_positions)) {
                 return 1;
             }
 
-            // extract, sort terms lexicographically
-            std::vector<std::string> terms;
-            terms.reserve(postings_map.size());
-            for(const auto& [term, _] : postings_map) {
-                terms.push_back(term);
-            }
-            std::sort(terms.begin(), terms.end());
-
-            for(const auto& term : terms) {
-                outfile << term;
-                for(const auto& [doc_id, freq] : postings_map[term]) {
-                    outfile << "\t" << doc_id << "\t" << freq;
-                }
-                outfile << "\n";
-            }
-
-            outfile.close();
-            std::cout << "Written intermediate file: " << intermediate_file << std::endl;
-
             postings_map.clear();
+            positions_map.clear();
             current_size = 0;
             file_count++;
         }
     }
 
     if(!postings_map.empty()) {   // remaining postings_map to an intermediate file
-        std::string intermediate_file = output_dir + "/intermediate_" + std::to_string(file_count) + ".txt";
-        std::ofstream outfile(intermediate_file);
-        if(!outfile.is_open()) {
-            std::cerr << "Failed to open intermediate file: " << intermediate_file << std::endl;
+        std::string intermediate_file = tmp_dir + "/intermediate_" + std::to_string(file_count) + ".txt";
+        if(!write_intermediate_file(intermediate_file, postings_map, positions_map, with_positions)) {
             return 1;
         }
-
-        std::vector<std::string> terms;
-        terms.reserve(postings_map.size());
-        for(const auto& [term, _] : postings_map) {
-            terms.push_back(term);
-        }
-        std::sort(terms.begin(), terms.end());
-
-        for(const auto& term : terms) {
-            outfile << term;
-            for(const auto& [doc_id, freq] : postings_map[term]) {
-                outfile << "\t" << doc_id << "\t" << freq;
-            }
-            outfile << "\n";
-        }
-
-        outfile.close();
-        std::cout << "Written intermediate file: " << intermediate_file << std::endl;
     }
 
+    if(infile.failed()) {
+        std::cerr << "Failed to read input file: " << input_file << std::endl;
+        return 1;
+    }
     infile.close();
     passages_file.close();
+    forward_file.close();
     page_table_file.close();
-    doc_length_file.close();
     std::cout << "Parsing and posting generation completed." << std::endl;
-    std::cout << "Total Tokens: " << total_tokens << std::endl;
-
-    // write total_tokens to a separate file for future reference
-    std::ofstream total_tokens_file(output_dir + "/total_tokens.txt");
-    if(total_tokens_file.is_open()) {
-        total_tokens_file << total_tokens << "\n";
-        total_tokens_file.close();
-        std::cout << "Written total_tokens.txt" << std::endl;
-    } else {
-        std::cerr << "Failed to write total_tokens.txt" << std::endl;
+    std::cout << "Total Documents: " << stats.numDocs() << ", Total Tokens: " << stats.header.total_tokens
+              << ", avgdl: " << stats.avgdl() << std::endl;
+
+    // collection_stats.bin: totals and per-document lengths; the indexer adds its term counts
+    if(!save_collection_stats(output_dir + "/collection_stats.bin", stats)) {
+        return 1;
     }
+    std::cout << "Written collection_stats.bin" << std::endl;
 
     return 0;
 }
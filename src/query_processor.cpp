@@ -4,6 +4,7 @@
 #include <vector>
 #include <unordered_map>
 #include <cstdint>
+#include <cstring>
 #include <algorithm>
 #include <sstream>
 #include <cmath>
@@ -11,169 +12,926 @@
 #include <iomanip>
 #include <set>
 #include <chrono>
-#ifdef __linux__
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <unistd.h>
-#endif
-
-#include "/Users/ad12/Documents/Develop/wse-hw-2/include/varbyte.h"
-#include "/Users/ad12/Documents/Develop/wse-hw-2/include/tokenizer.h"
-
-// Structure for Lexicon Entry
-struct LexiconEntry {
-    uint64_t docid_offset;
-    size_t docid_length;
-    uint64_t freq_offset;
-    size_t freq_length;
-    size_t doc_freq; // Number of documents containing the term
+#include <memory>
+#include <charconv>
+
+#include "varbyte.h"
+#include "index_reader.h"
+#include "tokenizer.h"
+#include "docstore.h"
+#include "forward_index.h"
+#include "async_io.h"
+#include "block_postings.h"
+#include "metrics.h"
+#include "embeddings.h"
+#include "hnsw.h"
+#include "embedding_store.h"
+#include "fusion.h"
+#include "ranking.h"
+#include "query_plan.h"
+#include "shard.h"
+#include "collection_stats.h"
+#include "tiered_index.h"
+#include "term_dictionary.h"
+#include "memory_placement.h"
+
+// Structure for a quoted phrase ("a b") or proximity ("a b"~N) constraint
+struct PhraseConstraint {
+    std::vector<std::string> terms;
+    uint32_t window; // 0 for an exact phrase, otherwise all terms within N consecutive tokens
 };
 
-// Structure for Document Information
-struct DocumentInfo {
-    uint32_t docID;
-    uint64_t passage_offset;
-    size_t passage_length;
+// Lazily decoded view of one term's positions list
+struct PositionCursor {
+    std::vector<uint8_t> bytes;
+    size_t posting = 0; // posting index that `byte` points at
+    size_t byte = 0;
 };
 
-// BM25 Parameters
-const double k1 = 1.5;
-const double b = 0.75;
-
-// Function to load lexicon
-bool load_lexicon(const std::string& lexicon_file, std::unordered_map<std::string, LexiconEntry>& lexicon) {
-    std::ifstream infile(lexicon_file);
-    if(!infile.is_open()) {
-        std::cerr << "Error: Failed to open lexicon file: " << lexicon_file << std::endl;
-        return false;
+// Function to split quoted phrases out of a query; returns the remaining free text
+std::string extract_phrases(const std::string& query, std::vector<PhraseConstraint>& phrases) {
+    std::string free_text;
+    size_t i = 0;
+    while(i < query.size()) {
+        size_t open = query.find('"', i);
+        size_t close = (open == std::string::npos) ? std::string::npos : query.find('"', open + 1);
+        if(close == std::string::npos) {
+            free_text += query.substr(i);
+            break;
+        }
+        free_text += query.substr(i, open - i) + " ";
+
+        PhraseConstraint phrase;
+        phrase.terms = tokenize(query.substr(open + 1, close - open - 1));
+        phrase.window = 0;
+        i = close + 1;
+        if(i < query.size() && query[i] == '~') { // proximity suffix: "a b"~N
+            size_t digits = i + 1;
+            while(digits < query.size() && std::isdigit(static_cast<unsigned char>(query[digits]))) ++digits;
+            if(digits > i + 1) {
+                // A window too large for uint32_t covers any passage anyway, so clamp it
+                uint32_t window = 0;
+                auto parsed = std::from_chars(query.data() + i + 1, query.data() + digits, window);
+                phrase.window = parsed.ec == std::errc() ? window : std::numeric_limits<uint32_t>::max();
+            }
+            i = digits;
+        }
+        if(phrase.terms.size() > 1) {
+            phrases.push_back(phrase);
+        }
+        for(const auto& term : phrase.terms) {
+            free_text += term + " "; // phrase terms are still scored like any other term
+        }
     }
+    return free_text;
+}
 
-    std::string term;
-    uint64_t docid_offset, freq_offset;
-    size_t docid_length, freq_length, doc_freq;
-    while(infile >> term >> docid_offset >> docid_length >> freq_offset >> freq_length >> doc_freq) {
-        LexiconEntry entry;
-        entry.docid_offset = docid_offset;
-        entry.docid_length = docid_length;
-        entry.freq_offset = freq_offset;
-        entry.freq_length = freq_length;
-        entry.doc_freq = doc_freq;
-        lexicon[term] = entry;
-    }
-
-    infile.close();
-    return true;
+// Function to split "stem*" prefix terms out of a query; returns the remaining text
+std::string extract_prefixes(const std::string& query, std::vector<std::string>& prefixes) {
+    std::istringstream words(query);
+    std::string word;
+    std::string rest;
+    while(words >> word) {
+        if(word.size() > 1 && word.back() == '*') {
+            std::vector<std::string> stem = tokenize(word.substr(0, word.size() - 1));
+            if(stem.size() == 1) {
+                prefixes.push_back(stem[0]);
+                continue;
+            }
+        }
+        rest += word + " ";
+    }
+    return rest;
 }
 
-// Function to load document lengths
-bool load_doc_lengths(const std::string& doc_lengths_file, std::unordered_map<uint32_t, uint32_t>& doc_lengths) {
-    std::ifstream infile(doc_lengths_file);
-    if(!infile.is_open()) {
-        std::cerr << "Error: Failed to open document lengths file: " << doc_lengths_file << std::endl;
+// Function to decode the positions of posting `target`, skipping earlier postings without decoding them
+bool positions_for(PositionCursor& cursor, const std::vector<uint32_t>& freqs, size_t target, std::vector<uint32_t>& out) {
+    out.clear();
+    if(target < cursor.posting || target >= freqs.size()) {
         return false;
     }
+    try {
+        while(cursor.posting < target) {
+            skipVarByteList(cursor.bytes, cursor.byte, freqs[cursor.posting]);
+            cursor.posting++;
+        }
+        size_t index = cursor.byte;
+        std::vector<uint32_t> gaps = decodeVarByteList(cursor.bytes, index, freqs[target]);
+        uint32_t pos = 0;
+        for(uint32_t gap : gaps) {
+            pos += gap;
+            out.push_back(pos);
+        }
+    } catch(const std::runtime_error& e) {
+        std::cerr << "Decoding error for positions: " << e.what() << std::endl;
+        return false;
+    }
+    return true;
+}
 
-    uint32_t docID, length;
-    while(infile >> docID >> length) {
-        doc_lengths[docID] = length;
+// Function to check an exact phrase: some p in lists[0] with p + k in lists[k] for every k
+bool match_exact_phrase(const std::vector<std::vector<uint32_t>>& lists) {
+    for(uint32_t start : lists[0]) {
+        bool all = true;
+        for(size_t k = 1; k < lists.size() && all; ++k) {
+            all = std::binary_search(lists[k].begin(), lists[k].end(), start + static_cast<uint32_t>(k));
+        }
+        if(all) return true;
     }
+    return false;
+}
 
-    infile.close();
-    return true;
+// Function to check that one occurrence of every term fits within `window` consecutive tokens
+bool match_window(const std::vector<std::vector<uint32_t>>& lists, uint32_t window) {
+    std::vector<std::pair<uint32_t, size_t>> merged; // (position, term slot)
+    for(size_t k = 0; k < lists.size(); ++k) {
+        for(uint32_t pos : lists[k]) merged.emplace_back(pos, k);
+    }
+    std::sort(merged.begin(), merged.end());
+
+    std::vector<uint32_t> counts(lists.size(), 0);
+    size_t covered = 0, left = 0;
+    for(size_t right = 0; right < merged.size(); ++right) {
+        if(counts[merged[right].second]++ == 0) covered++;
+        while(covered == lists.size()) {
+            if(merged[right].first - merged[left].first < window) return true;
+            if(--counts[merged[left].second] == 0) covered--;
+            left++;
+        }
+    }
+    return false;
 }
 
-// Function to load page table
-bool load_page_table(const std::string& page_table_file, std::unordered_map<uint32_t, DocumentInfo>& page_table) {
-    std::ifstream infile(page_table_file);
-    if(!infile.is_open()) {
-        std::cerr << "Error: Failed to open page table file: " << page_table_file << std::endl;
+// Function to write the collected metrics in the requested format ("json" or "prometheus")
+bool dump_metrics(const Metrics& metrics, const std::string& format, const std::string& out_file) {
+    std::string text = (format == "prometheus") ? metrics.toPrometheus() : metrics.toJson();
+    if(out_file.empty()) {
+        std::cout << text << std::endl;
+        return true;
+    }
+    std::ofstream outfile(out_file);
+    if(!outfile.is_open()) {
+        std::cerr << "Error: Failed to open metrics output file: " << out_file << std::endl;
         return false;
     }
+    outfile << text;
+    return true;
+}
 
-    uint32_t docID;
-    uint64_t offset;
-    size_t length;
-    while(infile >> docID >> offset >> length) {
-        DocumentInfo doc_info;
-        doc_info.docID = docID;
-        doc_info.passage_offset = offset;
-        doc_info.passage_length = length;
-        page_table[docID] = doc_info;
+// Function to split a comma-separated flag value
+std::vector<std::string> split_list(const std::string& value) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while(std::getline(ss, item, ',')) {
+        if(!item.empty()) items.push_back(item);
     }
+    return items;
+}
 
-    infile.close();
+// Function to handle a "ranking <name>" line, which switches the ranking function for the
+// following queries; false if the line is an ordinary query
+bool handle_ranking_command(const std::string& query, RankingModel& ranking) {
+    if(query.compare(0, 8, "ranking ") != 0) return false;
+    std::string name = query.substr(8);
+    if(parse_ranking_model(name, ranking)) {
+        std::cout << "Ranking with " << rankingModelName(ranking) << "." << std::endl;
+    } else {
+        std::cout << "Unknown ranking function: " << name << " (expected bm25, bm25+, ql or bm25f)" << std::endl;
+    }
     return true;
 }
 
-// Function to calculate IDF
-double calculate_idf(uint32_t total_docs, uint32_t doc_freq) {
-    return log((static_cast<double>(total_docs) - doc_freq + 0.5) / (doc_freq + 0.5) + 1);
+// One distinct query term's lexicon entry and, once read, its encoded posting list
+struct TermRead {
+    std::string term;
+    LexiconEntry entry;
+    std::vector<uint8_t> encoded_docids;
+    std::vector<uint8_t> encoded_freqs;
+    int pending = 2;
+    bool failed = false;
+    bool in_phrase = false; // its positions are read too
+};
+
+// What a query reads from: the index (and positions) for its postings, the passage stores for its results
+struct QuerySources {
+    AsyncReader& reader;
+    IndexLayout layout;
+    int index_fd;
+    int positions_fd; // -1 without --positions
+    const std::unordered_map<uint32_t, DocumentInfo>& page_table;
+    DocStore* docstore; // nullptr unless --docstore
+    int passages_fd;
+    int forward_fd;   // -1 without --forward, so no snippets
+    size_t snippet_len;
+};
+
+// One top-k result's passage, fetched for display; an empty status means the passage is ready
+struct ResultFetch {
+    std::string passage;
+    std::string status;
+    std::vector<char> passage_bytes;
+    std::vector<uint8_t> forward_bytes;
+    int pending = 0;
+    bool forward_ok = false;
+};
+
+// Function to look up the distinct query terms in the lexicon, reporting the missing ones if `verbose`
+std::vector<TermRead> lookup_terms(const std::vector<std::string>& terms, const std::unordered_map<std::string, LexiconEntry>& lexicon,
+                                   Metrics& metrics, bool verbose) {
+    std::vector<TermRead> term_reads;
+    term_reads.reserve(terms.size());
+    for(const auto& term : terms) {
+        std::unordered_map<std::string, LexiconEntry>::const_iterator it;
+        {
+            Metrics::ScopedTimer timer(metrics, Stage::LexiconLookup);
+            it = lexicon.find(term);
+        }
+        if(it == lexicon.end()) {
+            if(verbose) std::cout << "Term '" << term << "' not found in lexicon." << std::endl;
+            continue;
+        }
+        bool seen = false;
+        for(const auto& read : term_reads) {
+            seen = seen || read.term == term;
+        }
+        if(!seen) {
+            term_reads.push_back(TermRead{term, it->second, {}, {}, 2, false});
+        }
+    }
+    return term_reads;
 }
 
-#ifdef __linux__
-// Function to get total CPU time (user + system) in clock ticks
-long get_total_cpu_time() {
-    std::ifstream stat_file("/proc/stat");
-    if(!stat_file.is_open()) {
-        std::cerr << "Error: Unable to open /proc/stat for CPU time." << std::endl;
-        return 0;
+// Function to search the pruned tier for the looked-up terms; true if its top `depth` is exact
+bool search_tier(TieredIndex& tier, const std::vector<std::string>& terms, const std::vector<TermRead>& term_reads, int mode, size_t depth,
+                 RankingModel ranking, const RankingContext& context, const CollectionStats& collection_stats, RankedList& out) {
+    std::vector<std::string> tier_terms;
+    std::vector<TermStatistics> tier_stats;
+    for(const auto& read : term_reads) {
+        tier_terms.push_back(read.term);
+        tier_stats.push_back(TermStatistics{read.entry.doc_freq, read.entry.coll_freq,
+                                            static_cast<size_t>(std::count(terms.begin(), terms.end(), read.term))});
     }
-    std::string cpu_label;
-    long user, nice, system, idle, iowait, irq, softirq, steal;
-    stat_file >> cpu_label >> user >> nice >> system >> idle >> iowait >> irq >> softirq >> steal;
-    stat_file.close();
-    return user + nice + system + irq + softirq + steal;
+    return tier.search(tier_terms, tier_stats, mode, depth, ranking, context, collection_stats, out);
 }
 
-// Function to get process CPU time (user + system) in clock ticks
-long get_process_cpu_time() {
-    std::ifstream proc_stat("/proc/self/stat");
-    if(!proc_stat.is_open()) {
-        std::cerr << "Error: Unable to open /proc/self/stat for process CPU time." << std::endl;
-        return 0;
+// Function to point adjacent query terms with precomputed pair lists (indexer --pairs-from) at
+// them: each term's postings restricted to documents holding both. Scores are unchanged, since
+// term statistics still come from the terms' own entries. Returns the term_reads slots changed.
+std::vector<size_t> substitute_pair_lists(const std::vector<std::string>& terms, const std::unordered_map<std::string, LexiconEntry>& lexicon,
+                             std::vector<TermRead>& term_reads) {
+    std::vector<bool> paired(term_reads.size(), false);
+    auto slot_of = [&](const std::string& term) {
+        for(size_t t = 0; t < term_reads.size(); ++t) {
+            if(term_reads[t].term == term) return t;
+        }
+        return term_reads.size();
+    };
+    std::vector<size_t> substituted;
+    for(size_t i = 0; i + 1 < terms.size(); ++i) {
+        size_t a = slot_of(terms[i]);
+        size_t b = slot_of(terms[i + 1]);
+        if(a == term_reads.size() || b == term_reads.size() || a == b || paired[a] || paired[b]) continue;
+        auto pair_a = lexicon.find(terms[i] + "+" + terms[i + 1]);
+        auto pair_b = lexicon.find(terms[i + 1] + "+" + terms[i]);
+        if(pair_a == lexicon.end() || pair_b == lexicon.end()) continue;
+        term_reads[a].entry = pair_a->second;
+        term_reads[b].entry = pair_b->second;
+        paired[a] = paired[b] = true;
+        substituted.push_back(a);
+        substituted.push_back(b);
     }
-    std::string ignore;
-    long utime, stime;
-    for(int i = 0; i < 13; ++i) proc_stat >> ignore; // Skip first 13 fields
-    proc_stat >> utime >> stime;
-    proc_stat.close();
-    return utime + stime;
+    return substituted;
 }
 
-// Function to get current memory usage in KB
-long get_memory_usage_kb() {
-    std::ifstream status_file("/proc/self/status");
-    if(!status_file.is_open()) {
-        std::cerr << "Error: Unable to open /proc/self/status for memory usage." << std::endl;
-        return 0;
+// Function to fetch every posting list (and the positions of phrase terms) in one batch,
+// decoding each list as soon as both of its halves have arrived
+void read_postings(QuerySources& sources, std::vector<TermRead>& term_reads, Metrics& metrics,
+                   std::unordered_map<std::string, PostingCursor>& term_cursors,
+                   std::unordered_map<std::string, std::vector<uint32_t>>& term_freqs,
+                   std::unordered_map<std::string, PositionCursor>& position_cursors) {
+    enum class ReadKind { DocIds, Freqs, Positions };
+    std::vector<ReadRequest> requests;
+    std::vector<std::pair<size_t, ReadKind>> request_owners; // request -> (term_reads index, part)
+    for(size_t t = 0; t < term_reads.size(); ++t) {
+        TermRead& read = term_reads[t];
+        read.encoded_docids.resize(read.entry.docid_length);
+        ReadRequest request;
+        request.fd = sources.index_fd;
+        request.offset = read.entry.docid_offset;
+        request.length = read.entry.docid_length;
+        request.buffer = read.encoded_docids.data();
+        requests.push_back(request);
+        request_owners.emplace_back(t, ReadKind::DocIds);
+        if(sources.layout == IndexLayout::Blocked) {
+            // One region holds both docIDs and freqs
+            read.pending = 1;
+        } else {
+            read.encoded_freqs.resize(read.entry.freq_length);
+            request.offset = read.entry.freq_offset;
+            request.length = read.entry.freq_length;
+            request.buffer = read.encoded_freqs.data();
+            requests.push_back(request);
+            request_owners.emplace_back(t, ReadKind::Freqs);
+        }
+
+        // Positions are only read for terms inside a phrase
+        if(read.in_phrase && read.entry.pos_length > 0 && sources.positions_fd >= 0) {
+            PositionCursor& cursor = position_cursors[read.term];
+            cursor.bytes.resize(read.entry.pos_length);
+            request.fd = sources.positions_fd;
+            request.offset = read.entry.pos_offset;
+            request.length = read.entry.pos_length;
+            request.buffer = cursor.bytes.data();
+            requests.push_back(request);
+            request_owners.emplace_back(t, ReadKind::Positions);
+        }
+    }
+
+    // Covers the whole batch, including decoding that overlaps outstanding reads
+    Metrics::ScopedTimer timer(metrics, Stage::IndexRead);
+    sources.reader.readBatch(requests, [&](size_t r) {
+        TermRead& read = term_reads[request_owners[r].first];
+        bool ok = requests[r].result == static_cast<ssize_t>(requests[r].length);
+        if(request_owners[r].second == ReadKind::Positions) {
+            if(!ok) {
+                std::cerr << "Error: Failed to read positions for term '" << read.term << "'." << std::endl;
+                position_cursors.erase(read.term);
+            }
+            return;
+        }
+        if(!ok && !read.failed) {
+            std::cerr << "Error: Failed to read postings for term '" << read.term << "'." << std::endl;
+        }
+        read.failed = read.failed || !ok;
+        if(--read.pending > 0 || read.failed) return;
+
+        // Split layout: decode docIDs (gap decoding) and frequencies now. Blocked layout:
+        // the cursor decodes a block's docIDs on entry and its freqs on first use.
+        PostingCursor cursor;
+        {
+            Metrics::ScopedTimer decode_timer(metrics, Stage::Decode);
+            try {
+                if(sources.layout == IndexLayout::Blocked) {
+                    cursor.reset(std::move(read.encoded_docids), read.entry.doc_freq);
+                } else {
+                    std::vector<uint32_t> doc_ids;
+                    std::vector<uint32_t> freqs;
+                    decode_postings(read.encoded_docids, read.encoded_freqs, read.entry.doc_freq, doc_ids, freqs);
+                    metrics.add(Counter::PostingsDecoded, doc_ids.size());
+                    cursor.reset(std::move(doc_ids), std::move(freqs));
+                }
+                // Phrase terms walk their positions by every earlier posting's freq
+                if(read.in_phrase) {
+                    std::vector<uint32_t> doc_ids;
+                    cursor.decodeAll(doc_ids, term_freqs[read.term]);
+                }
+            } catch(const std::runtime_error& e) {
+                std::cerr << "Decoding error for term '" << read.term << "': " << e.what() << std::endl;
+                term_freqs.erase(read.term);
+                return;
+            }
+        }
+        term_cursors[read.term] = std::move(cursor);
+    });
+}
+
+// Function to fetch the passages of the first `shown` results: from the docstore in one batch
+// grouped by block, or every passage (length prefix and text in one read) and, for snippets,
+// its forward record, all in one batch; each result's text is finished as soon as its reads are in
+std::vector<ResultFetch> fetch_results(QuerySources& sources, const RankedList& ranked_docs, int shown,
+                                       const std::vector<uint32_t>& query_hashes, Metrics& metrics) {
+    bool use_snippets = sources.forward_fd >= 0;
+    std::unordered_map<uint32_t, std::string> fetched_passages;
+    if(sources.docstore != nullptr) {
+        std::vector<uint32_t> top_ids;
+        for(int i = 0; i < shown; ++i) {
+            top_ids.push_back(ranked_docs[i].first);
+        }
+        Metrics::ScopedTimer timer(metrics, Stage::SnippetFetch);
+        DocStore::Stats before = sources.docstore->stats();
+        try {
+            sources.docstore->fetch(top_ids, fetched_passages);
+        } catch(const std::runtime_error& e) {
+            std::cerr << "Error: Docstore fetch failed: " << e.what() << std::endl;
+        }
+        metrics.add(Counter::DocCacheHits, sources.docstore->stats().cache_hits - before.cache_hits);
+        metrics.add(Counter::DocBlockReads, sources.docstore->stats().block_reads - before.block_reads);
     }
+
+    std::vector<ResultFetch> results(shown);
+    Metrics::ScopedTimer timer(metrics, Stage::SnippetFetch);
+    std::vector<ReadRequest> fetches;
+    std::vector<std::pair<int, bool>> fetch_owners; // fetch -> (result, is forward record)
+    for(int i = 0; i < shown; ++i) {
+        uint32_t docID = ranked_docs[i].first;
+        ResultFetch& result = results[i];
+        auto it = sources.page_table.find(docID);
+        if(sources.docstore != nullptr) {
+            auto passage_it = fetched_passages.find(docID);
+            if(passage_it == fetched_passages.end()) {
+                result.status = "[Not Found]";
+                continue;
+            }
+            result.passage = std::move(passage_it->second);
+        } else {
+            // Retrieve passage from passages.bin using page_table
+            if(it == sources.page_table.end()) {
+                result.status = "[Not Found]";
+                continue;
+            }
+            result.passage_bytes.resize(sizeof(uint32_t) + it->second.passage_length);
+            ReadRequest request;
+            request.fd = sources.passages_fd;
+            request.offset = it->second.passage_offset;
+            request.length = result.passage_bytes.size();
+            request.buffer = result.passage_bytes.data();
+            fetches.push_back(request);
+            fetch_owners.emplace_back(i, false);
+            result.pending++;
+        }
+
+        // Query-biased snippets need the passage's forward index record
+        if(use_snippets && it != sources.page_table.end() && it->second.forward_length > 0) {
+            result.forward_bytes.resize(it->second.forward_length);
+            ReadRequest request;
+            request.fd = sources.forward_fd;
+            request.offset = it->second.forward_offset;
+            request.length = result.forward_bytes.size();
+            request.buffer = result.forward_bytes.data();
+            fetches.push_back(request);
+            fetch_owners.emplace_back(i, true);
+            result.pending++;
+        }
+    }
+
+    // Function-local completion of one result once all its reads are in
+    auto finish_result = [&](int i) {
+        ResultFetch& result = results[i];
+        uint32_t docID = ranked_docs[i].first;
+        if(sources.docstore == nullptr) {
+            if(result.passage_bytes.empty()) {
+                std::cerr << "Error: Failed to read passage for docID: " << docID << std::endl;
+                result.status = "[Read Failed]";
+                return;
+            }
+            // Validate the length prefix against the page table's passage length
+            uint32_t passage_length;
+            std::memcpy(&passage_length, result.passage_bytes.data(), sizeof(uint32_t));
+            if(passage_length == 0 || passage_length > result.passage_bytes.size() - sizeof(uint32_t)) {
+                std::cerr << "Warning: Invalid passage length for docID: " << docID << std::endl;
+                result.status = "[Invalid Length]";
+                return;
+            }
+            result.passage.assign(result.passage_bytes.data() + sizeof(uint32_t), passage_length);
+        }
+
+        // Replace the full passage with a query-biased window computed from the forward index
+        if(result.forward_ok) {
+            try {
+                result.passage = buildSnippet(result.passage, decodeForwardRecord(result.forward_bytes), query_hashes, sources.snippet_len);
+            } catch(const std::runtime_error& e) {
+                std::cerr << "Warning: Bad forward record for docID " << docID << ": " << e.what() << std::endl;
+            }
+        }
+    };
+
+    sources.reader.readBatch(fetches, [&](size_t f) {
+        auto [i, is_forward] = fetch_owners[f];
+        ResultFetch& result = results[i];
+        bool ok = fetches[f].result == static_cast<ssize_t>(fetches[f].length);
+        if(is_forward) {
+            result.forward_ok = ok;
+        } else if(!ok) {
+            result.passage_bytes.clear();
+        }
+        if(--result.pending == 0) {
+            finish_result(i);
+        }
+    });
+    // Docstore results with no forward record to wait for
+    for(int i = 0; i < shown; ++i) {
+        if(sources.docstore != nullptr && results[i].status.empty() && results[i].forward_bytes.empty()) {
+            finish_result(i);
+        }
+    }
+    return results;
+}
+
+// Function to replay up to `max_queries` lines of a query log ("qid<TAB>text" or plain lines)
+// before serving, through the same lookups and reads as real queries: each query's posting
+// lists and positions, its first-tier lists, the pair lists a conjunctive query would read
+// instead, and its top passages, so the page cache and the docstore cache hold what the first
+// real queries touch. Nothing is printed per query and nothing reaches `metrics` (disabled).
+void warm_up(std::istream& log, size_t max_queries, QuerySources& sources, const std::unordered_map<std::string, LexiconEntry>& lexicon,
+             TieredIndex* tier, RankingModel ranking, const CollectionStats& collection_stats) {
+    Metrics metrics(false);
+    auto start = std::chrono::steady_clock::now();
+    size_t replayed = 0;
+    size_t lists_read = 0;
+    size_t passages_read = 0;
     std::string line;
-    long vmrss = 0;
-    while (std::getline(status_file, line)) {
-        if(line.find("VmRSS:") == 0) {
-            std::istringstream iss(line);
-            std::string label;
-            iss >> label >> vmrss; // Label and value
-            break;
+    while(replayed < max_queries && std::getline(log, line)) {
+        size_t tab = line.find('\t');
+        std::vector<std::string> terms = tokenize(tab == std::string::npos ? line : line.substr(tab + 1));
+        std::vector<TermRead> term_reads = lookup_terms(terms, lexicon, metrics, false);
+        if(term_reads.empty()) continue;
+        replayed++;
+
+        size_t matched_terms = 0;
+        for(const auto& term : terms) {
+            matched_terms += lexicon.count(term);
+        }
+        RankingContext context{collection_stats.numDocs(), collection_stats.header.total_tokens, collection_stats.avgdl(), matched_terms};
+        if(tier != nullptr) {
+            RankedList tier_results;
+            search_tier(*tier, terms, term_reads, 2, 10, ranking, context, collection_stats, tier_results);
+            lists_read += term_reads.size();
+        }
+
+        // The conjunctive form's pair lists, and the full lists with every term's positions
+        std::vector<TermRead> substituted = term_reads;
+        std::vector<TermRead> pair_reads;
+        for(size_t slot : substitute_pair_lists(terms, lexicon, substituted)) {
+            pair_reads.push_back(substituted[slot]);
+        }
+        if(!pair_reads.empty()) {
+            std::unordered_map<std::string, PostingCursor> pair_cursors;
+            std::unordered_map<std::string, std::vector<uint32_t>> pair_freqs;
+            std::unordered_map<std::string, PositionCursor> pair_positions;
+            read_postings(sources, pair_reads, metrics, pair_cursors, pair_freqs, pair_positions);
+            lists_read += pair_reads.size();
+        }
+        for(auto& read : term_reads) {
+            read.in_phrase = true;
+        }
+        std::unordered_map<std::string, PostingCursor> term_cursors;
+        std::unordered_map<std::string, std::vector<uint32_t>> term_freqs;
+        std::unordered_map<std::string, PositionCursor> position_cursors;
+        read_postings(sources, term_reads, metrics, term_cursors, term_freqs, position_cursors);
+        lists_read += term_reads.size();
+
+        // Rank disjunctively for the passages to read
+        TopK top(10);
+        with_ranking_kernel(ranking, context, [&](const auto& kernel) {
+            std::vector<TermScorer> scorers;
+            for(const auto& read : term_reads) {
+                auto it = term_cursors.find(read.term);
+                if(it == term_cursors.end()) continue;
+                TermStatistics stats{read.entry.doc_freq, read.entry.coll_freq,
+                                     static_cast<size_t>(std::count(terms.begin(), terms.end(), read.term))};
+                scorers.push_back(make_term_scorer(kernel, &it->second, stats));
+            }
+            traverse_disjunctive(scorers, kernel, collection_stats, top, [](uint32_t, double) { return true; });
+        });
+        RankedList top_docs = top.sorted();
+        std::vector<uint32_t> query_hashes;
+        for(const auto& term : terms) {
+            query_hashes.push_back(hash_term(term));
+        }
+        fetch_results(sources, top_docs, static_cast<int>(top_docs.size()), query_hashes, metrics);
+        passages_read += top_docs.size();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Warm-up: " << replayed << " queries, " << lists_read << " posting lists, " << passages_read
+              << " passages in " << elapsed.count() << " seconds." << std::endl;
+}
+
+// Coordinator loop over docID-range shards: gather global document counts, lengths and term
+// frequencies, let every shard score its own top-k with them at the same time, then merge
+int run_coordinator(std::vector<std::unique_ptr<ShardClient>>& shards, const std::unordered_map<uint32_t, uint32_t>& doc_map,
+                    RankingModel ranking) {
+    uint64_t total_docs = 0;
+    uint64_t total_length = 0;
+    for(size_t s = 0; s < shards.size(); ++s) {
+        uint64_t num_docs, length;
+        if(!shards[s]->stats(num_docs, length)) {
+            std::cerr << "Error: Failed to read statistics of shard " << s << std::endl;
+            return 1;
+        }
+        total_docs += num_docs;
+        total_length += length;
+    }
+    if(total_docs == 0) {
+        std::cerr << "Error: The shards hold no documents." << std::endl;
+        return 1;
+    }
+    double avgdl = static_cast<double>(total_length) / static_cast<double>(total_docs);
+    std::cout << "Shards: " << shards.size() << ", Total Documents: " << total_docs << ", avgdl: " << avgdl << std::endl;
+
+    std::string query;
+    while(true) {
+        int mode = 0;
+        while (mode != 1 && mode != 2) {
+            std::cout << "Select query mode (1 for conjunctive, 2 for disjunctive): ";
+            std::cin >> mode;
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Clear input buffer
+            if (mode != 1 && mode != 2) {
+                std::cout << "Invalid mode selected. Please enter 1 or 2." << std::endl;
+            }
+        }
+
+        std::cout << "Enter query (or type 'exit' to quit): ";
+        std::getline(std::cin, query);
+        if(query == "exit") break;
+        if(query.empty() || handle_ranking_command(query, ranking)) continue;
+
+        auto query_start_time = std::chrono::steady_clock::now(); // Start timing
+
+        std::vector<PhraseConstraint> phrases;
+        std::vector<std::string> terms = tokenize(extract_phrases(query, phrases));
+        if(!phrases.empty()) {
+            std::cout << "Phrase queries are not supported across shards; matching phrase terms individually." << std::endl;
+        }
+        for(auto &term : terms) {
+            term = to_lowercase(term);
+        }
+
+        // Global document and collection frequencies: the sums over shards
+        ShardQueryStats stats;
+        stats.ranking = ranking;
+        stats.num_docs = total_docs;
+        stats.total_length = total_length;
+        stats.avgdl = avgdl;
+        stats.doc_freqs.assign(terms.size(), 0);
+        stats.coll_freqs.assign(terms.size(), 0);
+        bool ok = true;
+        for(auto& shard : shards) {
+            std::vector<uint64_t> shard_doc_freqs, shard_coll_freqs;
+            ok = ok && shard->termFreqs(terms, shard_doc_freqs, shard_coll_freqs);
+            for(size_t i = 0; ok && i < terms.size(); ++i) {
+                stats.doc_freqs[i] += shard_doc_freqs[i];
+                stats.coll_freqs[i] += shard_coll_freqs[i];
+            }
+        }
+        bool any_found = false;
+        for(size_t i = 0; ok && i < terms.size(); ++i) {
+            if(stats.doc_freqs[i] == 0) {
+                std::cout << "Term '" << terms[i] << "' not found in lexicon." << std::endl;
+            }
+            any_found = any_found || stats.doc_freqs[i] > 0;
+        }
+
+        // Scatter the query, then gather and merge the per-shard top-k lists
+        int k = 10; // Top 10 results
+        std::vector<std::pair<std::pair<uint32_t, double>, size_t>> merged; // ((docID, score), shard)
+        if(ok && any_found) {
+            for(auto& shard : shards) {
+                ok = shard->startSearch(terms, mode, k, stats) && ok;
+            }
+            for(size_t s = 0; s < shards.size(); ++s) {
+                RankedList top;
+                ok = shards[s]->finishSearch(top) && ok;
+                for(const auto& entry : top) merged.emplace_back(entry, s);
+            }
+        }
+        if(!ok) {
+            std::cerr << "Error: A shard failed to answer; results may be incomplete." << std::endl;
+        }
+        std::sort(merged.begin(), merged.end(), [](const auto& a, const auto& b) {
+            return a.first.second > b.first.second || (a.first.second == b.first.second && a.first.first < b.first.first);
+        });
+        int shown = std::min(k, static_cast<int>(merged.size()));
+
+        std::cout << "Top " << k << " results:" << std::endl;
+        for(int i = 0; i < shown; ++i) {
+            uint32_t docID = merged[i].first.first;
+            double score = merged[i].first.second;
+            uint32_t display_id = docID;
+            auto map_it = doc_map.find(docID);
+            if(map_it != doc_map.end()) {
+                display_id = map_it->second;
+            }
+            std::string passage;
+            std::cout << std::fixed << std::setprecision(4);
+            if(!shards[merged[i].second]->passage(docID, passage)) {
+                std::cout << i+1 << ". DocID: " << display_id << " | Score: " << score << " | Passage: [Not Found]" << std::endl;
+                continue;
+            }
+            std::cout << i+1 << ". DocID: " << display_id << " | Score: " << score << "\nPassage: " << passage << "\n" << std::endl;
         }
+        if(merged.empty()) {
+            std::cout << "No matching documents found." << std::endl;
+        }
+
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - query_start_time;
+        std::cout << "Elapsed Time: " << elapsed.count() << " seconds." << std::endl;
+        std::cout << std::endl;
     }
-    status_file.close();
-    return vmrss; // in KB
+    return 0;
 }
-#endif
 
 int main(int argc, char* argv[]) {
-    if(argc < 7) {
-        std::cerr << "Usage: " << argv[0] << " <final_index.bin> <lexicon.txt> <page_table.txt> <passages.bin> <doc_lengths.txt> <avgdl.txt>" << std::endl;
+    // Split optional "--name value" flags from the positional arguments
+    std::vector<std::string> args;
+    std::string doc_map_file;
+    std::string docstore_file;
+    size_t doc_cache_blocks = 64;
+    std::string forward_file_path;
+    size_t snippet_len = 30;
+    std::string positions_file_path;
+    std::string metrics_format;
+    std::string metrics_out_file;
+    std::string hnsw_file;
+    std::string query_vectors_file;
+    std::string embedding_store_file;
+    std::string fusion; // rrf with --hnsw, otherwise rerank
+    double alpha = 0.5;
+    size_t fusion_depth = 100;
+    size_t ef_search = 100;
+    double rrf_k = 60.0;
+    std::string io_backend_name = "uring";
+    unsigned io_depth = 64;
+    std::string shard_dirs;
+    std::string shard_hosts;
+    std::string serve_shard_dir;
+    uint16_t serve_port = 0;
+    std::string ranking_name = "bm25";
+    std::string tier_dir;
+    std::string term_dict_file;
+    size_t prefix_expansion = 64;
+    bool huge_pages = false;
+    int numa_node = -1;
+    std::string warmup_file;
+    size_t warmup_queries = 1000;
+    for(int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if(arg == "--doc-map" && i + 1 < argc) {
+            doc_map_file = argv[++i];
+        } else if(arg == "--docstore" && i + 1 < argc) {
+            docstore_file = argv[++i];
+        } else if(arg == "--doc-cache" && i + 1 < argc) {
+            doc_cache_blocks = std::stoul(argv[++i]);
+        } else if(arg == "--forward" && i + 1 < argc) {
+            forward_file_path = argv[++i];
+        } else if(arg == "--snippet-len" && i + 1 < argc) {
+            snippet_len = std::stoul(argv[++i]);
+        } else if(arg == "--positions" && i + 1 < argc) {
+            positions_file_path = argv[++i];
+        } else if(arg == "--metrics" && i + 1 < argc) {
+            metrics_format = argv[++i];
+        } else if(arg == "--metrics-out" && i + 1 < argc) {
+            metrics_out_file = argv[++i];
+        } else if(arg == "--hnsw" && i + 1 < argc) {
+            hnsw_file = argv[++i];
+        } else if(arg == "--query-vectors" && i + 1 < argc) {
+            query_vectors_file = argv[++i];
+        } else if(arg == "--embedding-store" && i + 1 < argc) {
+            embedding_store_file = argv[++i];
+        } else if(arg == "--fusion" && i + 1 < argc) {
+            fusion = argv[++i];
+        } else if(arg == "--alpha" && i + 1 < argc) {
+            alpha = std::stod(argv[++i]);
+        } else if(arg == "--fusion-depth" && i + 1 < argc) {
+            fusion_depth = std::stoul(argv[++i]);
+        } else if(arg == "--ef-search" && i + 1 < argc) {
+            ef_search = std::stoul(argv[++i]);
+        } else if(arg == "--rrf-k" && i + 1 < argc) {
+            rrf_k = std::stod(argv[++i]);
+        } else if(arg == "--io" && i + 1 < argc) {
+            io_backend_name = argv[++i];
+        } else if(arg == "--io-depth" && i + 1 < argc) {
+            io_depth = static_cast<unsigned>(std::stoul(argv[++i]));
+        } else if(arg == "--shards" && i + 1 < argc) {
+            shard_dirs = argv[++i];
+        } else if(arg == "--shard-hosts" && i + 1 < argc) {
+            shard_hosts = argv[++i];
+        } else if(arg == "--serve-shard" && i + 1 < argc) {
+            serve_shard_dir = argv[++i];
+        } else if(arg == "--port" && i + 1 < argc) {
+            serve_port = static_cast<uint16_t>(std::stoul(argv[++i]));
+        } else if(arg == "--ranking" && i + 1 < argc) {
+            ranking_name = argv[++i];
+        } else if(arg == "--tier" && i + 1 < argc) {
+            tier_dir = argv[++i];
+        } else if(arg == "--term-dict" && i + 1 < argc) {
+            term_dict_file = argv[++i];
+        } else if(arg == "--prefix-expansion" && i + 1 < argc) {
+            prefix_expansion = std::stoul(argv[++i]);
+        } else if(arg == "--huge-pages") {
+            huge_pages = true;
+        } else if(arg == "--numa-node" && i + 1 < argc) {
+            numa_node = std::stoi(argv[++i]);
+        } else if(arg == "--warmup" && i + 1 < argc) {
+            warmup_file = argv[++i];
+        } else if(arg == "--warmup-queries" && i + 1 < argc) {
+            warmup_queries = std::stoul(argv[++i]);
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    IoBackend io_backend = IoBackend::Uring;
+    if(io_backend_name == "threads") {
+        io_backend = IoBackend::Threads;
+    } else if(io_backend_name == "sync") {
+        io_backend = IoBackend::Sync;
+    } else if(io_backend_name != "uring") {
+        std::cerr << "Error: Unknown I/O backend: " << io_backend_name << " (expected uring, threads or sync)" << std::endl;
+        return 1;
+    }
+    RankingModel ranking = RankingModel::Bm25;
+    if(!parse_ranking_model(ranking_name, ranking)) {
+        std::cerr << "Error: Unknown ranking function: " << ranking_name << " (expected bm25, bm25+, ql or bm25f)" << std::endl;
+        return 1;
+    }
+
+    // Bind before anything is loaded, so every structure (and each I/O thread) is node-local
+    if(numa_node >= 0) {
+        if(!bind_to_numa_node(numa_node)) {
+            return 1;
+        }
+        std::cout << "Bound to NUMA node " << numa_node << "." << std::endl;
+    }
+
+    // Note what is mapped before loading, so huge pages go only to the structures loaded below
+    MappingList premapped;
+    if(huge_pages) {
+        premapped = anonymous_mappings();
+    }
+
+    // Shard server: answer a coordinator's requests for one shard directory
+    if(!serve_shard_dir.empty()) {
+        ShardSearcher shard;
+        if(serve_port == 0 || !shard.open(serve_shard_dir, io_backend)) {
+            std::cerr << "Error: --serve-shard needs a shard directory with an index and --port" << std::endl;
+            return 1;
+        }
+        if(huge_pages) {
+            std::cout << "Huge pages: " << (advise_resident_huge_pages(premapped) >> 20) << " MB advised." << std::endl;
+        }
+        std::cout << "Serving shard " << serve_shard_dir << " (" << shard.numDocs() << " documents) on 127.0.0.1:" << serve_port << std::endl;
+        if(!serveShard(shard, serve_port)) {
+            std::cerr << "Error: Failed to listen on port " << serve_port << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Coordinator over shard directories (one thread each) or shard server processes
+    if(!shard_dirs.empty() || !shard_hosts.empty()) {
+        std::vector<std::unique_ptr<ShardClient>> shards;
+        for(const auto& dir : split_list(shard_dirs)) {
+            auto shard = std::make_unique<LocalShard>();
+            if(!shard->open(dir, io_backend)) {
+                std::cerr << "Error: Failed to open shard: " << dir << std::endl;
+                return 1;
+            }
+            shards.push_back(std::move(shard));
+        }
+        for(const auto& host : split_list(shard_hosts)) {
+            auto shard = std::make_unique<RemoteShard>();
+            if(!shard->connect(host)) {
+                std::cerr << "Error: Failed to connect to shard server: " << host << std::endl;
+                return 1;
+            }
+            shards.push_back(std::move(shard));
+        }
+        std::unordered_map<uint32_t, uint32_t> doc_map;
+        if(!doc_map_file.empty() && !load_doc_map(doc_map_file, doc_map)) {
+            return 1;
+        }
+        return run_coordinator(shards, doc_map, ranking);
+    }
+
+    if(args.size() < 5) {
+        std::cerr << "Usage: " << argv[0] << " <final_index.bin> <lexicon.txt> <page_table.txt> <passages.bin> <collection_stats.bin>"
+                  << " [--doc-map doc_map.txt] [--docstore docstore.bin] [--doc-cache blocks]"
+                  << " [--forward forward.bin] [--snippet-len tokens] [--positions positions.bin]"
+                  << " [--metrics json|prometheus] [--metrics-out file] [--io uring|threads|sync] [--io-depth 64]"
+                  << " [--ranking bm25|bm25+|ql|bm25f] [--tier tier_dir]"
+                  << " [--term-dict terms.bin [--prefix-expansion 64]]"
+                  << " [--huge-pages] [--numa-node N] [--warmup queries.tsv [--warmup-queries 1000]]"
+                  << " [--hnsw hnsw.bin --query-vectors query_embeddings.bin [--fusion rrf|linear|rerank] [--alpha 0.5]"
+                  << " [--fusion-depth 100] [--ef-search 100] [--rrf-k 60]] [--embedding-store embeddings_store.bin]" << std::endl;
+        std::cerr << "       " << argv[0] << " --shards shard_0,shard_1,... | --shard-hosts host:port,... [--doc-map doc_map.txt] [--ranking bm25]" << std::endl;
+        std::cerr << "       " << argv[0] << " --serve-shard shard_dir --port port [--huge-pages] [--numa-node N]" << std::endl;
+        return 1;
+    }
+    if(fusion.empty()) {
+        fusion = hnsw_file.empty() ? "rerank" : "rrf";
+    }
+    if(fusion != "rrf" && fusion != "linear" && fusion != "rerank") {
+        std::cerr << "Error: Unknown fusion method: " << fusion << " (expected rrf, linear or rerank)" << std::endl;
+        return 1;
+    }
+    if(fusion != "rerank" && hnsw_file.empty() && !embedding_store_file.empty()) {
+        std::cerr << "Error: --fusion " << fusion << " needs --hnsw; the embedding store alone supports --fusion rerank" << std::endl;
+        return 1;
+    }
+    if(!metrics_format.empty() && metrics_format != "json" && metrics_format != "prometheus") {
+        std::cerr << "Error: Unknown metrics format: " << metrics_format << " (expected json or prometheus)" << std::endl;
         return 1;
     }
 
-    std::string final_index_file = argv[1];
-    std::string lexicon_file = argv[2];
-    std::string page_table_file = argv[3];
-    std::string passages_bin_file = argv[4];
-    std::string doc_lengths_file = argv[5];
-    std::string avgdl_file = argv[6];
+    std::string final_index_file = args[0];
+    std::string lexicon_file = args[1];
+    std::string page_table_file = args[2];
+    std::string passages_bin_file = args[3];
+    std::string stats_file = args[4];
+    if(args.size() > 5) {
+        std::cout << "Note: avgdl now comes from the collection stats; ignoring " << args[5] << std::endl;
+    }
 
     // Load lexicon
     std::unordered_map<std::string, LexiconEntry> lexicon;
@@ -182,50 +940,184 @@ int main(int argc, char* argv[]) {
     }
     std::cout << "Lexicon loaded with " << lexicon.size() << " terms." << std::endl;
 
-    // Load page table
-    std::unordered_map<uint32_t, DocumentInfo> page_table;
-    if(!load_page_table(page_table_file, page_table)) {
-        return 1;
+    // Pruned first tier (indexer --tier), tried before the full index
+    TieredIndex tier;
+    bool use_tier = !tier_dir.empty();
+    if(use_tier) {
+        if(!tier.open(tier_dir, io_backend)) {
+            return 1;
+        }
+        std::cout << "Tier loaded with " << tier.numTerms() << " terms." << std::endl;
     }
-    std::cout << "Page table loaded with " << page_table.size() << " documents." << std::endl;
 
-    // Load document lengths
-    std::unordered_map<uint32_t, uint32_t> doc_lengths;
-    if(!load_doc_lengths(doc_lengths_file, doc_lengths)) {
-        return 1;
+    // Sorted term dictionary for prefix queries (indexer --term-dict)
+    TermDictionary term_dict;
+    bool use_term_dict = !term_dict_file.empty();
+    if(use_term_dict) {
+        if(!term_dict.open(term_dict_file)) {
+            return 1;
+        }
+        std::cout << "Term dictionary loaded: " << term_dict.numTerms() << " terms in " << term_dict.bytes() << " bytes." << std::endl;
     }
-    std::cout << "Document lengths loaded with " << doc_lengths.size() << " entries." << std::endl;
 
-    // Load avgdl
-    std::ifstream avgdl_ifs(avgdl_file);
-    if(!avgdl_ifs.is_open()) {
-        std::cerr << "Error: Failed to open avgdl file: " << avgdl_file << std::endl;
-        return 1;
+    // Load page table; the compressed docstore carries its own block index and replaces it,
+    // unless snippets need the page table's forward index offsets
+    std::unordered_map<uint32_t, DocumentInfo> page_table;
+    DocStore docstore;
+    bool use_docstore = !docstore_file.empty();
+    bool use_snippets = !forward_file_path.empty();
+    if(use_docstore) {
+        if(!docstore.open(docstore_file, doc_cache_blocks)) {
+            std::cerr << "Error: Failed to open docstore file: " << docstore_file << std::endl;
+            return 1;
+        }
+        std::cout << "Docstore opened with " << docstore.numDocs() << " documents in " << docstore.numBlocks() << " blocks." << std::endl;
+    }
+    if(!use_docstore || use_snippets) {
+        if(!load_page_table(page_table_file, page_table)) {
+            return 1;
+        }
+        std::cout << "Page table loaded with " << page_table.size() << " documents." << std::endl;
     }
 
-    double avgdl;
-    avgdl_ifs >> avgdl;
-    avgdl_ifs.close();
-    std::cout << "Average Document Length (avgdl) loaded: " << avgdl << std::endl;
+    // Load collection statistics: document count, avgdl and the docID -> length table
+    CollectionStats collection_stats;
+    if(!load_collection_stats(stats_file, collection_stats)) {
+        return 1;
+    }
+    double avgdl = collection_stats.avgdl();
+    std::cout << "Collection stats loaded: " << collection_stats.numDocs() << " documents, avgdl " << avgdl << "." << std::endl;
+
+    // Load the reordered -> original passage ID map, if the index was reordered
+    std::unordered_map<uint32_t, uint32_t> doc_map;
+    if(!doc_map_file.empty()) {
+        if(!load_doc_map(doc_map_file, doc_map)) {
+            return 1;
+        }
+        std::cout << "Doc map loaded with " << doc_map.size() << " entries." << std::endl;
+    }
 
     // Determine total number of documents
-    uint32_t total_docs = doc_lengths.size();
+    uint64_t total_docs = collection_stats.numDocs();
     std::cout << "Total Documents: " << total_docs << std::endl;
 
-    // Open the inverted index file
-    std::ifstream index_file(final_index_file, std::ios::binary);
-    if(!index_file.is_open()) {
+    // Open the inverted index file; postings, positions, passages and forward records are all
+    // read through batched async reads
+    FileHandle index_file;
+    if(!index_file.open(final_index_file)) {
         std::cerr << "Error: Failed to open final inverted index file: " << final_index_file << std::endl;
         return 1;
     }
 
     // Open passages.bin for reading
-    std::ifstream passages_file(passages_bin_file, std::ios::binary);
-    if(!passages_file.is_open()) {
+    FileHandle passages_file;
+    if(!use_docstore && !passages_file.open(passages_bin_file)) {
         std::cerr << "Error: Failed to open passages.bin file: " << passages_bin_file << std::endl;
         return 1;
     }
 
+    // Open forward.bin for query-biased snippets
+    FileHandle forward_file;
+    if(use_snippets) {
+        if(!forward_file.open(forward_file_path)) {
+            std::cerr << "Error: Failed to open forward index file: " << forward_file_path << std::endl;
+            return 1;
+        }
+    }
+
+    // Open positions.bin for phrase and proximity queries
+    FileHandle positions_file;
+    if(!positions_file_path.empty()) {
+        if(!positions_file.open(positions_file_path)) {
+            std::cerr << "Error: Failed to open positions file: " << positions_file_path << std::endl;
+            return 1;
+        }
+    }
+
+    // The blocked layout interleaves each block's docIDs and freqs in one stream per term
+    IndexLayout index_layout = detect_index_layout(final_index_file);
+    if(index_layout == IndexLayout::Blocked) {
+        std::cout << "Index layout: blocked (" << POSTING_BLOCK_SIZE << " postings per block)." << std::endl;
+    }
+
+    // One batch of reads per query for its posting lists, and one for its top-k passages
+    AsyncReader async_reader;
+    async_reader.init(io_backend, io_depth);
+    std::cout << "I/O backend: " << ioBackendName(async_reader.backend()) << std::endl;
+
+    // Dense retrieval: HNSW over passage embeddings and/or the quantized embedding store, plus
+    // precomputed query embeddings keyed by query ID
+    HnswIndex hnsw;
+    EmbeddingStore embedding_store;
+    EmbeddingMatrix query_vectors;
+    std::unordered_map<uint32_t, size_t> query_vector_rows; // query ID -> row in query_vectors
+    bool use_hnsw = !hnsw_file.empty();
+    bool use_embedding_store = !embedding_store_file.empty();
+    bool use_hybrid = use_hnsw || use_embedding_store;
+    if(use_hybrid) {
+        if(query_vectors_file.empty()) {
+            std::cerr << "Error: --hnsw and --embedding-store need --query-vectors" << std::endl;
+            return 1;
+        }
+        try {
+            query_vectors = loadEmbeddings(query_vectors_file);
+        } catch(const std::runtime_error& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        for(size_t i = 0; i < query_vectors.size(); ++i) {
+            normalizeVector(query_vectors.row(i), query_vectors.dim);
+            query_vector_rows[query_vectors.ids[i]] = i;
+        }
+        std::cout << "Query embeddings loaded: " << query_vectors.size() << " (fusion: " << fusion << ")." << std::endl;
+    }
+    if(use_hnsw) {
+        if(!hnsw.load(hnsw_file)) {
+            std::cerr << "Error: Failed to load HNSW index: " << hnsw_file << std::endl;
+            return 1;
+        }
+        if(query_vectors.dim != hnsw.dim()) {
+            std::cerr << "Error: Query embeddings have dimension " << query_vectors.dim << " but the HNSW index has " << hnsw.dim() << std::endl;
+            return 1;
+        }
+        std::cout << "HNSW index loaded with " << hnsw.size() << " passages." << std::endl;
+    }
+    if(use_embedding_store) {
+        if(!embedding_store.open(embedding_store_file)) {
+            std::cerr << "Error: Failed to open embedding store: " << embedding_store_file << std::endl;
+            return 1;
+        }
+        if(query_vectors.dim != embedding_store.dim()) {
+            std::cerr << "Error: Query embeddings have dimension " << query_vectors.dim << " but the embedding store has " << embedding_store.dim() << std::endl;
+            return 1;
+        }
+        std::cout << "Embedding store mapped: " << embedding_store.bytes() << " bytes, "
+                  << (embedding_store.quantization() == Quantization::Int8 ? "int8" : "fp16") << ", "
+                  << simdLevelName(embedding_store.simdLevel()) << " kernels." << std::endl;
+    }
+
+    // Everything resident is loaded: move the lexicon, page table and length tables onto huge pages
+    if(huge_pages) {
+        std::cout << "Huge pages: " << (advise_resident_huge_pages(premapped) >> 20) << " MB advised." << std::endl;
+    }
+
+    // What every query reads from
+    QuerySources sources{async_reader, index_layout, index_file.fd(), positions_file.fd(), page_table,
+                         use_docstore ? &docstore : nullptr, passages_file.fd(), use_snippets ? forward_file.fd() : -1, snippet_len};
+
+    // Warm-up: replay a sample of a query log before serving
+    if(!warmup_file.empty()) {
+        std::ifstream warmup_log(warmup_file);
+        if(!warmup_log.is_open()) {
+            std::cerr << "Error: Failed to open warm-up query log: " << warmup_file << std::endl;
+            return 1;
+        }
+        warm_up(warmup_log, warmup_queries, sources, lexicon, use_tier ? &tier : nullptr, ranking, collection_stats);
+    }
+
+    // Per-stage latency histograms and counters; every hook is a no-op unless --metrics is given
+    Metrics metrics(!metrics_format.empty());
+
     // Query processing loop
     std::string query;
     while(true) {
@@ -243,293 +1135,363 @@ int main(int argc, char* argv[]) {
         std::cout << "Enter query (or type 'exit' to quit): ";
         std::getline(std::cin, query);
         if(query == "exit") break;
-        if(query.empty()) continue;
-
-#ifdef __linux__
-        long total_cpu_start = get_total_cpu_time();
-        long process_cpu_start = get_process_cpu_time();
-        long memory_start = get_memory_usage_kb();
-#endif
+        if(query.empty() || handle_ranking_command(query, ranking)) continue;
+        if(query == "metrics") {
+            if(!metrics.enabled()) {
+                std::cout << "Metrics are disabled; start with --metrics json|prometheus." << std::endl;
+            } else {
+                dump_metrics(metrics, metrics_format, metrics_out_file);
+            }
+            continue;
+        }
 
-        auto query_start_time = std::chrono::high_resolution_clock::now(); // Start timing
+        auto query_start_time = std::chrono::steady_clock::now(); // Start timing
+        metrics.beginQuery();
+
+        // Queries may carry their MS MARCO ID as "qid<TAB>text"; the ID selects the query embedding
+        const float* query_vector = nullptr;
+        size_t tab = query.find('\t');
+        if(tab != std::string::npos && tab > 0
+           && std::all_of(query.begin(), query.begin() + tab, [](char c) { return std::isdigit(static_cast<unsigned char>(c)); })) {
+            uint32_t qid = 0;
+            bool valid_qid = std::from_chars(query.data(), query.data() + tab, qid).ec == std::errc();
+            std::string qid_text = query.substr(0, tab);
+            query = query.substr(tab + 1);
+            auto row_it = valid_qid ? query_vector_rows.find(qid) : query_vector_rows.end();
+            if(!valid_qid) {
+                if(use_hybrid) std::cout << "Query ID " << qid_text << " is out of range; using BM25 only." << std::endl;
+            } else if(row_it != query_vector_rows.end()) {
+                query_vector = query_vectors.row(row_it->second);
+            } else if(use_hybrid) {
+                std::cout << "No embedding for query " << qid << "; using BM25 only." << std::endl;
+            }
+        }
 
-        // Tokenize query
-        std::vector<std::string> terms = tokenize(query);
+        // Function-local end of a query: record its stage times and report the end-to-end latency
+        auto finish_query = [&]() {
+            metrics.endQuery();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - query_start_time;
+            std::cout << "Elapsed Time: " << elapsed.count() << " seconds." << std::endl;
+            std::cout << std::endl;
+        };
+
+        // Pull out quoted phrases and prefix terms, then tokenize query
+        std::vector<PhraseConstraint> phrases;
+        std::vector<std::string> prefixes;
+        std::vector<std::string> terms = tokenize(extract_prefixes(extract_phrases(query, phrases), prefixes));
+        if(!phrases.empty() && !positions_file.is_open()) {
+            std::cout << "Phrase queries need --positions; matching phrase terms individually." << std::endl;
+            phrases.clear();
+        }
 
         // Convert all terms to lowercase
         for(auto &term : terms) {
             term = to_lowercase(term);
         }
 
+        // Expand each prefix into its most frequent terms, which are ORed: conjunctive queries
+        // need every plain term and at least one term of every prefix
+        std::vector<std::vector<std::string>> required_groups;
+        for(const auto& term : terms) {
+            required_groups.push_back({term});
+        }
+        for(const auto& prefix : prefixes) {
+            if(!use_term_dict) {
+                std::cout << "Prefix queries need --term-dict; matching '" << prefix << "' as a term." << std::endl;
+                terms.push_back(prefix);
+                required_groups.push_back({prefix});
+                continue;
+            }
+            std::vector<std::string> expansion;
+            size_t matches = 0;
+            try {
+                Metrics::ScopedTimer timer(metrics, Stage::LexiconLookup);
+                matches = term_dict.expand(prefix, prefix_expansion, expansion);
+            } catch(const std::runtime_error& e) {
+                std::cerr << "Prefix expansion error for '" << prefix << "*': " << e.what() << std::endl;
+                continue; // the group is dropped, so it constrains nothing
+            }
+            if(matches > expansion.size()) {
+                std::cout << "Prefix '" << prefix << "*' matches " << matches << " terms; using the " << expansion.size() << " most frequent." << std::endl;
+            } else if(matches == 0) {
+                std::cout << "No terms start with '" << prefix << "'." << std::endl;
+            }
+            for(const auto& term : expansion) {
+                if(std::find(terms.begin(), terms.end(), term) == terms.end()) {
+                    terms.push_back(term);
+                }
+            }
+            required_groups.push_back(std::move(expansion));
+        }
+        bool prefix_conjunction = mode == 1 && !prefixes.empty();
+
         if(terms.empty()) {
             std::cout << "No valid terms in query." << std::endl;
-#ifdef __linux__
-            long total_cpu_end = get_total_cpu_time();
-            long process_cpu_end = get_process_cpu_time();
-            long memory_end = get_memory_usage_kb();
-
-            long total_cpu_diff = total_cpu_end - total_cpu_start;
-            long process_cpu_diff = process_cpu_end - process_cpu_start;
-            long memory_diff = memory_end - memory_start;
-
-            long ticks_per_sec = sysconf(_SC_CLK_TCK);
-
-            double cpu_usage = (total_cpu_diff > 0) ? (static_cast<double>(process_cpu_diff) / static_cast<double>(total_cpu_diff)) * 100.0 : 0.0;
-
-            auto query_end_time_now = std::chrono::high_resolution_clock::now();
-            std::chrono::duration<double> elapsed = query_end_time_now - query_start_time;
-
-            std::cout << "Elapsed Time: " << elapsed.count() << " seconds." << std::endl;
-            std::cout << "CPU Usage: " << cpu_usage << " %" << std::endl;
-            std::cout << "Memory Usage Change: " << memory_diff << " KB." << std::endl;
-#endif
-            std::cout << std::endl;
+            finish_query();
             continue;
         }
 
         // Retrieve postings for each term
-        std::unordered_map<std::string, std::vector<uint32_t>> term_doc_ids; // term -> list of docIDs
-        std::unordered_map<std::string, std::vector<uint32_t>> term_freqs;   // term -> list of frequencies
-        std::unordered_map<std::string, size_t> term_positions;              // term -> current position in postings
-
+        std::unordered_map<std::string, PostingCursor> term_cursors;         // term -> postings cursor
+        std::unordered_map<std::string, std::vector<uint32_t>> term_freqs;   // phrase term -> all frequencies
+        std::unordered_map<std::string, PositionCursor> position_cursors;    // phrase term -> positions list
+
+        // Look up every term first, then fetch all posting lists (and phrase positions) in one batch
+        std::vector<TermRead> term_reads = lookup_terms(terms, lexicon, metrics, true);
+
+        // Try the pruned tier first; when it proves its top k exact the full lists are never read.
+        // Phrases need positions and conjunctive queries with an unknown term match nothing.
+        size_t result_depth = query_vector != nullptr ? std::max<size_t>(10, fusion_depth) : 10;
+        RankedList tier_results;
+        bool from_tier = false;
+        size_t found_terms = 0;
         for(const auto& term : terms) {
-            auto it = lexicon.find(term);
-            if(it == lexicon.end()) {
-                // Term not found in lexicon
-                std::cout << "Term '" << term << "' not found in lexicon." << std::endl;
-                continue;
+            found_terms += lexicon.count(term);
+        }
+        if(use_tier && phrases.empty() && !term_reads.empty() && (mode == 2 || (found_terms == terms.size() && !prefix_conjunction))) {
+            Metrics::ScopedTimer timer(metrics, Stage::Traversal);
+            RankingContext tier_context{total_docs, collection_stats.header.total_tokens, avgdl, found_terms};
+            from_tier = search_tier(tier, terms, term_reads, mode, result_depth, ranking, tier_context, collection_stats, tier_results);
+            if(from_tier) {
+                metrics.add(Counter::TierAnswers);
+                term_reads.clear();
             }
+        }
 
-            LexiconEntry entry = it->second;
+        // Conjunctive: adjacent query pairs read their precomputed pair lists when they have them.
+        // Phrases need full lists.
+        if(mode == 1 && phrases.empty() && !from_tier && !prefix_conjunction) {
+            metrics.add(Counter::PairLists, substitute_pair_lists(terms, lexicon, term_reads).size() / 2);
+        }
 
-            // Read encoded docIDs
-            std::vector<uint8_t> encoded_docids(entry.docid_length);
-            index_file.seekg(entry.docid_offset, std::ios::beg);
-            if(!index_file.read(reinterpret_cast<char*>(encoded_docids.data()), entry.docid_length)) {
-                std::cerr << "Error: Failed to read docIDs for term '" << term << "'." << std::endl;
-                continue;
+        // Positions are only read for terms inside a phrase
+        for(auto& read : term_reads) {
+            for(const auto& phrase : phrases) {
+                read.in_phrase = read.in_phrase || std::find(phrase.terms.begin(), phrase.terms.end(), read.term) != phrase.terms.end();
             }
-
-            // Read encoded frequencies
-            std::vector<uint8_t> encoded_freqs(entry.freq_length);
-            index_file.seekg(entry.freq_offset, std::ios::beg);
-            if(!index_file.read(reinterpret_cast<char*>(encoded_freqs.data()), entry.freq_length)) {
-                std::cerr << "Error: Failed to read frequencies for term '" << term << "'." << std::endl;
-                continue;
+        }
+        read_postings(sources, term_reads, metrics, term_cursors, term_freqs, position_cursors);
+
+        // Function-local check of all phrase constraints for a document every phrase term matched
+        std::vector<std::vector<uint32_t>> phrase_lists;
+        auto phrases_match = [&](uint32_t doc_id) {
+            for(const auto& phrase : phrases) {
+                phrase_lists.assign(phrase.terms.size(), {});
+                for(size_t k = 0; k < phrase.terms.size(); ++k) {
+                    const std::string& term = phrase.terms[k];
+                    auto cursor_it = position_cursors.find(term);
+                    auto postings_it = term_cursors.find(term);
+                    if(cursor_it == position_cursors.end() || postings_it == term_cursors.end()) return false;
+                    const PostingCursor& postings = postings_it->second;
+                    if(postings.done() || postings.docid() != doc_id) return false;
+                    if(!positions_for(cursor_it->second, term_freqs[term], postings.index(), phrase_lists[k])) return false;
+                }
+                bool matched = (phrase.window == 0) ? match_exact_phrase(phrase_lists) : match_window(phrase_lists, phrase.window);
+                if(!matched) return false;
             }
+            return true;
+        };
 
-            // Decode docIDs (gap decoding) and frequencies
-            size_t index_pos = 0;
-            std::vector<uint32_t> doc_id_gaps;
-            try {
-                doc_id_gaps = decodeVarByteList(encoded_docids, index_pos, entry.doc_freq);
-            } catch(const std::runtime_error& e) {
-                std::cerr << "Decoding error for docIDs of term '" << term << "': " << e.what() << std::endl;
-                continue;
-            }
+        // Check if any terms have postings (dense retrieval can still answer a hybrid query)
+        if(term_cursors.empty() && query_vector == nullptr && !from_tier) {
+            std::cout << "No matching documents found." << std::endl;
+            finish_query();
+            continue;
+        }
 
-            // Reconstruct original docIDs from gaps
-            std::vector<uint32_t> doc_ids;
-            doc_ids.reserve(doc_id_gaps.size());
-            uint32_t prev_doc_id = 0;
-            for (uint32_t gap : doc_id_gaps) {
-                uint32_t doc_id = prev_doc_id + gap;
-                doc_ids.push_back(doc_id);
-                prev_doc_id = doc_id;
+        // Query plan: each distinct term's lexicon entry is resolved here, once; a repeated term
+        // scores once per occurrence via its weight
+        std::vector<PostingCursor*> lists;
+        std::vector<TermStatistics> term_stats;
+        size_t matched_terms = 0;
+        for(const auto& term : terms) {
+            auto it = term_cursors.find(term);
+            if(it == term_cursors.end()) continue;
+            matched_terms++;
+            if(std::find(lists.begin(), lists.end(), &it->second) != lists.end()) continue;
+            lists.push_back(&it->second);
+            const LexiconEntry& entry = lexicon[term];
+            term_stats.push_back(TermStatistics{entry.doc_freq, entry.coll_freq,
+                                                static_cast<size_t>(std::count(terms.begin(), terms.end(), term))});
+        }
+        RankingContext ranking_context{total_docs, collection_stats.header.total_tokens, avgdl, matched_terms};
+
+        // Only the top results are kept: the ones shown, or the fusion depth for hybrid queries
+        TopK top(result_depth);
+        {
+            Metrics::ScopedTimer traversal_timer(metrics, Stage::Traversal);
+            // Prefix conjunctions: one term of every required group must be at the document
+            auto groups_match = [&](uint32_t doc_id) {
+                for(const auto& group : required_groups) {
+                    bool present = false;
+                    for(const auto& term : group) {
+                        auto it = term_cursors.find(term);
+                        present = present || (it != term_cursors.end() && !it->second.done() && it->second.docid() == doc_id);
+                    }
+                    if(!present) return false;
+                }
+                return true;
+            };
+            bool groups_possible = true;
+            for(const auto& group : required_groups) {
+                groups_possible = groups_possible && std::any_of(group.begin(), group.end(), [&](const std::string& term) {
+                    return term_cursors.count(term) > 0;
+                });
             }
 
-            index_pos = 0;
-            std::vector<uint32_t> freqs;
-            try {
-                freqs = decodeVarByteList(encoded_freqs, index_pos, entry.doc_freq);
-            } catch(const std::runtime_error& e) {
-                std::cerr << "Decoding error for frequencies of term '" << term << "': " << e.what() << std::endl;
-                continue;
-            }
+            // Positions are only touched for docs that already passed docID matching
+            auto accept_document = [&](uint32_t current_doc_id, double) {
+                return (!prefix_conjunction || groups_match(current_doc_id)) && (phrases.empty() || phrases_match(current_doc_id));
+            };
+
+            // The traversal is instantiated per ranking kernel; the choice is made once here
+            TraversalStats traversal;
+            with_ranking_kernel(ranking, ranking_context, [&](const auto& kernel) {
+                std::vector<TermScorer> scorers;
+                for(size_t t = 0; t < lists.size(); ++t) {
+                    scorers.push_back(make_term_scorer(kernel, lists[t], term_stats[t]));
+                }
+                if(prefix_conjunction) {
+                    // Conjunctive with prefixes: a union of all lists, filtered per document
+                    if(groups_possible) {
+                        traversal = traverse_disjunctive(scorers, kernel, collection_stats, top, accept_document);
+                    }
+                } else if(mode == 1) {
+                    // Conjunctive: every query term must match; blocked lists jump over whole
+                    // blocks without decoding them
+                    if(matched_terms == terms.size()) {
+                        traversal = traverse_conjunctive(scorers, kernel, collection_stats, top, accept_document);
+                    }
+                } else {
+                    // Disjunctive: MaxScore over the union of all lists
+                    traversal = traverse_disjunctive(scorers, kernel, collection_stats, top, accept_document);
+                }
+            });
+            metrics.add(Counter::PostingsScored, traversal.postings_scored);
 
-            // Ensure doc_ids and freqs are the same size
-            if(doc_ids.size() != freqs.size()) {
-                std::cerr << "Error: Mismatch between docIDs and frequencies for term: " << term << std::endl;
-                continue;
+            for(PostingCursor* cursor : lists) {
+                metrics.add(Counter::BlocksSkipped, cursor->blocksSkipped());
+                if(index_layout == IndexLayout::Blocked) {
+                    metrics.add(Counter::PostingsDecoded, std::min(cursor->size(), cursor->blocksDecoded() * POSTING_BLOCK_SIZE));
+                }
             }
-
-            term_doc_ids[term] = doc_ids;
-            term_freqs[term] = freqs;
-            term_positions[term] = 0;
         }
 
-        // Capture the end time immediately after retrieving postings
-        auto query_end_time_now = std::chrono::high_resolution_clock::now();
-        std::chrono::duration<double> elapsed = query_end_time_now - query_start_time;
-
-#ifdef __linux__
-        // Measure CPU and memory usage after retrieving postings
-        long total_cpu_end = get_total_cpu_time();
-        long process_cpu_end = get_process_cpu_time();
-        long memory_end = get_memory_usage_kb();
-
-        long total_cpu_diff = total_cpu_end - total_cpu_start;
-        long process_cpu_diff = process_cpu_end - process_cpu_start;
-        long memory_diff = memory_end - memory_start;
-
-        double cpu_usage = (total_cpu_diff > 0) ? (static_cast<double>(process_cpu_diff) / static_cast<double>(total_cpu_diff)) * 100.0 : 0.0;
-#endif
-
-        // Check if any terms have postings
-        if(term_doc_ids.empty()) {
-            std::cout << "No matching documents found." << std::endl;
-#ifdef __linux__
-            std::cout << "Elapsed Time: " << elapsed.count() << " seconds." << std::endl;
-            std::cout << "CPU Usage: " << cpu_usage << " %" << std::endl;
-            std::cout << "Memory Usage Change: " << memory_diff << " KB." << std::endl;
-#endif
-            std::cout << std::endl;
-            continue;
+        // Rank documents by score
+        RankedList ranked_docs;
+        {
+            Metrics::ScopedTimer timer(metrics, Stage::TopK);
+            ranked_docs = from_tier ? std::move(tier_results) : top.sorted();
         }
 
-        // Initialize data structures for DAAT processing
-        std::unordered_map<uint32_t, double> doc_scores; // docID -> BM25 score
+        // Hybrid: fuse the BM25 ranking with HNSW results, or rerank the BM25 top candidates by dot product
+        if(query_vector != nullptr) {
+            Metrics::ScopedTimer timer(metrics, Stage::DenseSearch);
+            RankedList lexical(ranked_docs.begin(), ranked_docs.begin() + std::min(fusion_depth, ranked_docs.size()));
 
-        // Collect all unique docIDs across all terms
-        std::set<uint32_t> all_doc_ids;
-        for (const auto& [term, doc_ids] : term_doc_ids) {
-            all_doc_ids.insert(doc_ids.begin(), doc_ids.end());
-        }
+            // Exact query-document similarity: quantized store when given, else the HNSW's float vectors
+            EmbeddingStore::PreparedQuery prepared;
+            if(use_embedding_store) {
+                prepared = embedding_store.prepare(query_vector);
+            }
+            auto dense_score = [&](uint32_t doc_id, double& score) {
+                if(use_embedding_store) {
+                    if(!embedding_store.contains(doc_id)) return false;
+                    score = embedding_store.score(prepared, doc_id);
+                    return true;
+                }
+                const float* doc_vector = hnsw.vectorForDoc(doc_id);
+                if(doc_vector == nullptr) return false;
+                score = dotProduct(query_vector, doc_vector, hnsw.dim());
+                return true;
+            };
 
-        // Process documents in order
-        for(auto doc_id_iter = all_doc_ids.begin(); doc_id_iter != all_doc_ids.end(); ++doc_id_iter) {
-            uint32_t current_doc_id = *doc_id_iter;
+            RankedList dense;
             double score = 0.0;
-            int found_terms = 0;
-
-            for (const auto& term : terms) {
-                if (term_doc_ids.find(term) == term_doc_ids.end()) {
-                    continue;
+            if(fusion == "rerank") {
+                // Candidates without an embedding are kept, after the reranked ones, in BM25 order
+                RankedList unscored;
+                for(const auto& [doc_id, bm25] : lexical) {
+                    if(dense_score(doc_id, score)) {
+                        dense.emplace_back(doc_id, score);
+                    } else {
+                        unscored.emplace_back(doc_id, bm25);
+                    }
                 }
-
-                auto& doc_ids = term_doc_ids[term];
-                auto& freqs = term_freqs[term];
-                auto& pos = term_positions[term];
-
-                // Move the pointer forward if necessary
-                while (pos < doc_ids.size() && doc_ids[pos] < current_doc_id) {
-                    pos++;
+                sortByScore(dense);
+                dense.insert(dense.end(), unscored.begin(), unscored.end());
+                ranked_docs = dense;
+            } else {
+                for(const auto& [doc_id, similarity] : hnsw.search(query_vector, fusion_depth, ef_search)) {
+                    dense.emplace_back(doc_id, similarity);
                 }
-
-                if (pos < doc_ids.size() && doc_ids[pos] == current_doc_id) {
-                    found_terms++;
-
-                    // Retrieve frequency
-                    uint32_t freq = freqs[pos];
-
-                    // Retrieve document length
-                    auto len_it = doc_lengths.find(current_doc_id);
-                    if(len_it == doc_lengths.end()) {
-                        std::cerr << "Warning: Document length not found for docID: " << current_doc_id << std::endl;
-                        continue;
+                if(fusion == "rrf") {
+                    ranked_docs = fuseReciprocalRank(lexical, dense, fusion_depth, rrf_k);
+                } else {
+                    // Score the BM25 candidates the graph search missed exactly, so both lists cover them
+                    std::unordered_map<uint32_t, bool> in_dense;
+                    for(const auto& entry : dense) in_dense[entry.first] = true;
+                    for(const auto& [doc_id, bm25] : lexical) {
+                        if(!in_dense.count(doc_id) && dense_score(doc_id, score)) {
+                            dense.emplace_back(doc_id, score);
+                        }
                     }
-                    uint32_t doc_length = len_it->second;
-
-                    // Compute BM25 score for this term
-                    LexiconEntry entry = lexicon[term];
-                    double idf = calculate_idf(total_docs, entry.doc_freq);
-                    double denominator = freq + k1 * (1 - b + b * (static_cast<double>(doc_length) / avgdl));
-                    double numerator = freq * (k1 + 1);
-                    double bm25_component = (denominator != 0) ? (numerator / denominator) : 0.0;
-                    double term_score = idf * bm25_component;
-
-                    score += term_score;
+                    sortByScore(dense);
+                    ranked_docs = fuseLinear(lexical, dense, dense.size(), alpha);
                 }
             }
-
-            if ((mode == 1 && found_terms == terms.size()) || (mode == 2 && found_terms > 0)) {
-                doc_scores[current_doc_id] = score;
-            }
         }
 
-        // Rank documents by BM25 score
-        std::vector<std::pair<uint32_t, double>> ranked_docs(doc_scores.begin(), doc_scores.end());
-        std::sort(ranked_docs.begin(), ranked_docs.end(),
-                  [](const std::pair<uint32_t, double>& a, const std::pair<uint32_t, double>& b) -> bool {
-                      return a.second > b.second;
-                  });
+        // Query term hashes, matched against forward index term dictionaries for snippets
+        std::vector<uint32_t> query_hashes;
+        for(const auto& term : terms) {
+            query_hashes.push_back(hash_term(term));
+        }
 
         // Display top-k results
         int k = 10; // Top 10 results
+        int shown = std::min(k, static_cast<int>(ranked_docs.size()));
+
+        // Fetch the top-k passages (and snippet records)
+        std::vector<ResultFetch> results = fetch_results(sources, ranked_docs, shown, query_hashes, metrics);
+
         std::cout << "Top " << k << " results:" << std::endl;
-        for(int i = 0; i < std::min(k, static_cast<int>(ranked_docs.size())); ++i) {
+        for(int i = 0; i < shown; ++i) {
             uint32_t docID = ranked_docs[i].first;
             double score = ranked_docs[i].second;
 
-            // Retrieve passage from passages.bin using page_table
-            auto it = page_table.find(docID);
-            if(it == page_table.end()) {
-                std::cout << i+1 << ". DocID: " << docID << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: [Not Found]" << std::endl;
-                continue;
-            }
-
-            uint64_t offset = it->second.passage_offset;
-            size_t length = it->second.passage_length;
-
-            // Seek to the passage in passages.bin
-            passages_file.seekg(offset, std::ios::beg);
-            if(passages_file.fail()) {
-                std::cerr << "Error: Failed to seek to passage for docID: " << docID << std::endl;
-                std::cout << i+1 << ". DocID: " << docID << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: [Seek Failed]" << std::endl;
-                continue;
+            // Report the original passage ID when the index was built on reordered docIDs
+            uint32_t display_id = docID;
+            auto map_it = doc_map.find(docID);
+            if(map_it != doc_map.end()) {
+                display_id = map_it->second;
             }
 
-            // Read passage length (first 4 bytes as uint32_t)
-            uint32_t passage_length;
-            passages_file.read(reinterpret_cast<char*>(&passage_length), sizeof(uint32_t));
-            if(passages_file.fail()) {
-                std::cerr << "Error: Failed to read passage length for docID: " << docID << std::endl;
-                std::cout << i+1 << ". DocID: " << docID << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: [Read Failed]" << std::endl;
-                continue;
-            }
-
-            // Validate passage_length
-            if(passage_length == 0 || passage_length > length) {
-                std::cerr << "Warning: Invalid passage length for docID: " << docID << std::endl;
-                std::cout << i+1 << ". DocID: " << docID << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: [Invalid Length]" << std::endl;
+            if(!results[i].status.empty()) {
+                std::cout << i+1 << ". DocID: " << display_id << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: " << results[i].status << std::endl;
                 continue;
             }
 
-            // Read passage characters based on byte length
-            std::vector<char> passage_chars(passage_length);
-            passages_file.read(reinterpret_cast<char*>(passage_chars.data()), passage_length);
-            if(passages_file.fail()) {
-                std::cerr << "Error: Failed to read passage content for docID: " << docID << std::endl;
-                std::cout << i+1 << ". DocID: " << docID << " | Score: " << std::fixed << std::setprecision(4) << score << " | Passage: [Content Read Failed]" << std::endl;
-                continue;
-            }
-            std::string passage(passage_chars.begin(), passage_chars.end());
-
             // Output formatting
             std::cout << std::fixed << std::setprecision(4);
-            std::cout << i+1 << ". DocID: " << docID << " | Score: " << score << "\nPassage: " << passage << "\n" << std::endl;
+            std::cout << i+1 << ". DocID: " << display_id << " | Score: " << score << "\nPassage: " << results[i].passage << "\n" << std::endl;
         }
 
         if(ranked_docs.empty()) {
             std::cout << "No matching documents found." << std::endl;
         }
 
-#ifdef __linux__
         // Display performance metrics
-        std::cout << "Elapsed Time: " << elapsed.count() << " seconds." << std::endl;
-        std::cout << "CPU Usage: " << cpu_usage << " %" << std::endl;
-        std::cout << "Memory Usage Change: " << memory_diff << " KB." << std::endl;
-#endif
-
-        std::cout << std::endl;
-
-        // Reset the stream state for the next query
-        index_file.clear();
+        finish_query();
     }
 
     // Close files before exiting
     index_file.close();
     passages_file.close();
 
+    if(metrics.enabled() && !dump_metrics(metrics, metrics_format, metrics_out_file)) {
+        return 1;
+    }
+
     return 0;
 }
@@ -0,0 +1,462 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <sstream>
+#include <future>
+#include <thread>
+#include <filesystem>
+#include <tuple>
+#include "collection_stats.h"
+
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+// Docs per recursion leaf; below this size bisection no longer pays for itself
+const size_t BP_LEAF_SIZE = 16;
+
+// Structure to hold one row of the page table
+struct PageTableRow {
+    uint32_t doc_id;
+    string rest; // remaining tab-separated columns, carried through untouched
+};
+
+// Forward index in CSR form: terms of dense doc d are terms[offsets[d] .. offsets[d + 1])
+struct ForwardIndex {
+    vector<uint64_t> offsets;
+    vector<uint32_t> terms;
+    uint32_t num_terms = 0;
+};
+
+// Function to map an original docID to its dense index (position in the page table)
+inline bool denseIndex(const vector<uint32_t>& sorted_ids, const vector<uint32_t>& dense_of_sorted,
+                       uint32_t doc_id, uint32_t& dense) {
+    auto it = lower_bound(sorted_ids.begin(), sorted_ids.end(), doc_id);
+    if (it == sorted_ids.end() || *it != doc_id) {
+        return false;
+    }
+    dense = dense_of_sorted[it - sorted_ids.begin()];
+    return true;
+}
+
+// Function to build the doc -> term forward index from the intermediate files.
+// Terms occurring in fewer than min_df documents cannot shrink any gap and are dropped.
+bool buildForwardIndex(const vector<string>& files, const vector<uint32_t>& sorted_ids,
+                       const vector<uint32_t>& dense_of_sorted, uint32_t min_df, bool with_positions,
+                       ForwardIndex& fwd) {
+    size_t num_docs = sorted_ids.size();
+    vector<vector<uint32_t>> doc_terms(num_docs);
+    unordered_map<string, uint32_t> term_ids;
+    vector<uint32_t> df;
+
+    for (const auto& file : files) {
+        ifstream infile(file);
+        if (!infile.is_open()) {
+            cerr << "Failed to open intermediate file: " << file << endl;
+            return false;
+        }
+
+        string line;
+        while (getline(infile, line)) {
+            istringstream iss(line);
+            string term;
+            if (!(iss >> term)) {
+                continue;
+            }
+
+            auto [it, inserted] = term_ids.emplace(term, static_cast<uint32_t>(df.size()));
+            if (inserted) {
+                df.push_back(0);
+            }
+            uint32_t term_id = it->second;
+
+            uint32_t doc_id, freq, dense;
+            string positions;
+            while (iss >> doc_id >> freq) {
+                if (with_positions) iss >> positions; // positions are doc-relative and not needed here
+                if (!denseIndex(sorted_ids, dense_of_sorted, doc_id, dense)) {
+                    cerr << "DocID " << doc_id << " in " << file << " is missing from the page table" << endl;
+                    return false;
+                }
+                doc_terms[dense].push_back(term_id);
+                df[term_id]++;
+            }
+        }
+    }
+
+    // Renumber surviving terms densely so the per-thread degree arrays stay small
+    vector<uint32_t> remap(df.size(), UINT32_MAX);
+    uint32_t kept = 0;
+    for (size_t t = 0; t < df.size(); ++t) {
+        if (df[t] >= min_df) {
+            remap[t] = kept++;
+        }
+    }
+
+    fwd.num_terms = kept;
+    fwd.offsets.assign(num_docs + 1, 0);
+    for (size_t d = 0; d < num_docs; ++d) {
+        for (uint32_t t : doc_terms[d]) {
+            if (remap[t] != UINT32_MAX) {
+                fwd.terms.push_back(remap[t]);
+            }
+        }
+        fwd.offsets[d + 1] = fwd.terms.size();
+        vector<uint32_t>().swap(doc_terms[d]);
+    }
+
+    cout << "Forward index built: " << num_docs << " docs, " << kept << " terms (df >= " << min_df
+         << "), " << fwd.terms.size() << " edges." << endl;
+    return true;
+}
+
+// Approximate cost in bits of encoding a term's gaps inside a partition of size n where it has degree deg
+inline double gapCost(int64_t deg, int64_t n) {
+    if (deg <= 0) return 0.0;
+    return static_cast<double>(deg) * log2(static_cast<double>(n) / static_cast<double>(deg + 1));
+}
+
+// Per-thread scratch for bisection: term degrees and move gains for each side
+struct BisectScratch {
+    vector<int32_t> deg_left;
+    vector<int32_t> deg_right;
+    vector<double> gain_to_right;
+    vector<double> gain_to_left;
+    vector<uint32_t> touched;
+};
+
+// Function to run one bisection step (Dhulipala et al.) over docs[lo, hi) and recurse into both halves
+void bisect(const ForwardIndex& fwd, vector<uint32_t>& docs, size_t lo, size_t hi,
+            int depth, int max_depth, int iterations, int parallel_depth) {
+    if (hi - lo <= BP_LEAF_SIZE || depth >= max_depth) {
+        return;
+    }
+
+    thread_local BisectScratch scratch;
+    if (scratch.deg_left.size() < fwd.num_terms) {
+        scratch.deg_left.assign(fwd.num_terms, 0);
+        scratch.deg_right.assign(fwd.num_terms, 0);
+        scratch.gain_to_right.assign(fwd.num_terms, 0.0);
+        scratch.gain_to_left.assign(fwd.num_terms, 0.0);
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    int64_t n_left = static_cast<int64_t>(mid - lo);
+    int64_t n_right = static_cast<int64_t>(hi - mid);
+    vector<pair<double, uint32_t>> left_gains(mid - lo);
+    vector<pair<double, uint32_t>> right_gains(hi - mid);
+
+    for (int iter = 0; iter < iterations; ++iter) {
+        // Term degrees on each side of the current split
+        scratch.touched.clear();
+        for (size_t i = lo; i < hi; ++i) {
+            uint32_t d = docs[i];
+            auto& deg = (i < mid) ? scratch.deg_left : scratch.deg_right;
+            for (uint64_t e = fwd.offsets[d]; e < fwd.offsets[d + 1]; ++e) {
+                uint32_t t = fwd.terms[e];
+                if (scratch.deg_left[t] == 0 && scratch.deg_right[t] == 0) {
+                    scratch.touched.push_back(t);
+                }
+                deg[t]++;
+            }
+        }
+
+        // Gain of moving one document carrying term t across the split, per direction
+        for (uint32_t t : scratch.touched) {
+            int64_t dl = scratch.deg_left[t];
+            int64_t dr = scratch.deg_right[t];
+            double before = gapCost(dl, n_left) + gapCost(dr, n_right);
+            scratch.gain_to_right[t] = before - (gapCost(dl - 1, n_left) + gapCost(dr + 1, n_right));
+            scratch.gain_to_left[t] = before - (gapCost(dl + 1, n_left) + gapCost(dr - 1, n_right));
+        }
+
+        for (size_t i = lo; i < hi; ++i) {
+            uint32_t d = docs[i];
+            const auto& gains = (i < mid) ? scratch.gain_to_right : scratch.gain_to_left;
+            double gain = 0.0;
+            for (uint64_t e = fwd.offsets[d]; e < fwd.offsets[d + 1]; ++e) {
+                gain += gains[fwd.terms[e]];
+            }
+            if (i < mid) {
+                left_gains[i - lo] = {gain, d};
+            } else {
+                right_gains[i - mid] = {gain, d};
+            }
+        }
+
+        for (uint32_t t : scratch.touched) {
+            scratch.deg_left[t] = 0;
+            scratch.deg_right[t] = 0;
+        }
+
+        auto by_gain_desc = [](const pair<double, uint32_t>& a, const pair<double, uint32_t>& b) {
+            return a.first > b.first;
+        };
+        sort(left_gains.begin(), left_gains.end(), by_gain_desc);
+        sort(right_gains.begin(), right_gains.end(), by_gain_desc);
+
+        // Swap the most eager pairs while the combined gain stays positive
+        size_t swaps = 0;
+        size_t pairs = min(left_gains.size(), right_gains.size());
+        while (swaps < pairs && left_gains[swaps].first + right_gains[swaps].first > 0.0) {
+            swap(left_gains[swaps].second, right_gains[swaps].second);
+            ++swaps;
+        }
+
+        for (size_t i = 0; i < left_gains.size(); ++i) docs[lo + i] = left_gains[i].second;
+        for (size_t i = 0; i < right_gains.size(); ++i) docs[mid + i] = right_gains[i].second;
+
+        if (swaps == 0) {
+            break;
+        }
+    }
+
+    vector<pair<double, uint32_t>>().swap(left_gains);
+    vector<pair<double, uint32_t>>().swap(right_gains);
+
+    // Halves are disjoint, so the top levels can be processed concurrently
+    if (depth < parallel_depth) {
+        auto left = async(launch::async, bisect, cref(fwd), ref(docs), lo, mid,
+                          depth + 1, max_depth, iterations, parallel_depth);
+        bisect(fwd, docs, mid, hi, depth + 1, max_depth, iterations, parallel_depth);
+        left.get();
+    } else {
+        bisect(fwd, docs, lo, mid, depth + 1, max_depth, iterations, parallel_depth);
+        bisect(fwd, docs, mid, hi, depth + 1, max_depth, iterations, parallel_depth);
+    }
+}
+
+// Function to hash a term ID for minhash signatures (splitmix64 finalizer)
+inline uint64_t mixHash(uint64_t x, uint64_t seed) {
+    x += seed + 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// Function to order docs lexicographically by a two-value minhash signature;
+// similar documents share minima and end up adjacent
+void minhashOrder(const ForwardIndex& fwd, vector<uint32_t>& docs) {
+    size_t num_docs = docs.size();
+    vector<pair<pair<uint64_t, uint64_t>, uint32_t>> keyed(num_docs);
+    for (size_t d = 0; d < num_docs; ++d) {
+        uint64_t h1 = UINT64_MAX, h2 = UINT64_MAX;
+        for (uint64_t e = fwd.offsets[d]; e < fwd.offsets[d + 1]; ++e) {
+            h1 = min(h1, mixHash(fwd.terms[e], 0x1234));
+            h2 = min(h2, mixHash(fwd.terms[e], 0x5678));
+        }
+        keyed[d] = {{h1, h2}, static_cast<uint32_t>(d)};
+    }
+    sort(keyed.begin(), keyed.end());
+    for (size_t d = 0; d < num_docs; ++d) {
+        docs[d] = keyed[d].second;
+    }
+}
+
+// Function to rewrite one intermediate file with reassigned docIDs, postings kept in docID order.
+// Position lists (parser --positions) are relative to the document and carried over unchanged.
+bool rewriteIntermediate(const string& in_path, const string& out_path, const vector<uint32_t>& sorted_ids,
+                         const vector<uint32_t>& dense_of_sorted, const vector<uint32_t>& new_id_of_dense,
+                         bool with_positions) {
+    ifstream infile(in_path);
+    if (!infile.is_open()) {
+        cerr << "Failed to open intermediate file: " << in_path << endl;
+        return false;
+    }
+    ofstream outfile(out_path);
+    if (!outfile.is_open()) {
+        cerr << "Failed to create reordered intermediate file: " << out_path << endl;
+        return false;
+    }
+
+    string line;
+    vector<tuple<uint32_t, uint32_t, string>> postings;
+    while (getline(infile, line)) {
+        istringstream iss(line);
+        string term;
+        if (!(iss >> term)) {
+            continue;
+        }
+
+        postings.clear();
+        uint32_t doc_id, freq, dense;
+        string positions;
+        while (iss >> doc_id >> freq) {
+            if (with_positions) iss >> positions;
+            if (!denseIndex(sorted_ids, dense_of_sorted, doc_id, dense)) {
+                cerr << "DocID " << doc_id << " in " << in_path << " is missing from the page table" << endl;
+                return false;
+            }
+            postings.emplace_back(new_id_of_dense[dense], freq, positions);
+        }
+        sort(postings.begin(), postings.end());
+
+        outfile << term;
+        for (const auto& [new_id, f, p] : postings) {
+            outfile << "\t" << new_id << "\t" << f;
+            if (with_positions) outfile << "\t" << p;
+        }
+        outfile << "\n";
+    }
+
+    cout << "Written reordered intermediate file: " << out_path << endl;
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    string mode = "bp";
+    int iterations = 20;
+    int max_depth = -1; // derived from the collection size unless given
+    uint32_t min_df = 2;
+    unsigned threads = max(1u, thread::hardware_concurrency());
+    bool with_positions = false;
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--positions") {
+            with_positions = true;
+        } else if (arg.rfind("--", 0) == 0 && i + 1 < argc) {
+            string value = argv[++i];
+            if (arg == "--mode") mode = value;
+            else if (arg == "--iterations") iterations = stoi(value);
+            else if (arg == "--depth") max_depth = stoi(value);
+            else if (arg == "--min-df") min_df = static_cast<uint32_t>(stoul(value));
+            else if (arg == "--threads") threads = max(1, stoi(value));
+            else {
+                cerr << "Unknown option: " << arg << endl;
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 4 || (mode != "bp" && mode != "minhash")) {
+        cerr << "Usage: " << argv[0] << " [--mode bp|minhash] [--iterations N] [--depth N] [--min-df N] [--threads N] [--positions]"
+             << " <page_table.txt> <collection_stats.bin> <intermediate_file1> [<intermediate_file2> ...] <output_directory>" << endl;
+        return 1;
+    }
+
+    string page_table_file = args[0];
+    string stats_file = args[1];
+    vector<string> intermediate_files(args.begin() + 2, args.end() - 1);
+    string output_dir = args.back();
+
+    if (!fs::exists(output_dir) && !fs::create_directories(output_dir)) {
+        cerr << "Failed to create output directory: " << output_dir << endl;
+        return 1;
+    }
+
+    // Load the page table; its row order defines the dense doc index
+    vector<PageTableRow> page_table;
+    {
+        ifstream infile(page_table_file);
+        if (!infile.is_open()) {
+            cerr << "Failed to open page table file: " << page_table_file << endl;
+            return 1;
+        }
+        string line;
+        while (getline(infile, line)) {
+            size_t tab_pos = line.find('\t');
+            if (tab_pos == string::npos) continue;
+            page_table.push_back({static_cast<uint32_t>(stoul(line.substr(0, tab_pos))), line.substr(tab_pos + 1)});
+        }
+    }
+
+    size_t num_docs = page_table.size();
+    if (num_docs == 0) {
+        cerr << "Page table is empty: " << page_table_file << endl;
+        return 1;
+    }
+
+    vector<pair<uint32_t, uint32_t>> id_pairs(num_docs);
+    for (size_t d = 0; d < num_docs; ++d) {
+        id_pairs[d] = {page_table[d].doc_id, static_cast<uint32_t>(d)};
+    }
+    sort(id_pairs.begin(), id_pairs.end());
+    vector<uint32_t> sorted_ids(num_docs), dense_of_sorted(num_docs);
+    for (size_t i = 0; i < num_docs; ++i) {
+        sorted_ids[i] = id_pairs[i].first;
+        dense_of_sorted[i] = id_pairs[i].second;
+    }
+    vector<pair<uint32_t, uint32_t>>().swap(id_pairs);
+
+    // Load document lengths keyed by dense index
+    vector<uint32_t> doc_lengths(num_docs, 0);
+    CollectionStats stats;
+    if (!load_collection_stats(stats_file, stats)) {
+        return 1;
+    }
+    for (size_t d = 0; d < num_docs; ++d) {
+        doc_lengths[d] = stats.docLength(page_table[d].doc_id);
+    }
+
+    ForwardIndex fwd;
+    if (!buildForwardIndex(intermediate_files, sorted_ids, dense_of_sorted, min_df, with_positions, fwd)) {
+        return 1;
+    }
+
+    // order[new_id] = dense index of the document placed there
+    vector<uint32_t> order(num_docs);
+    for (size_t d = 0; d < num_docs; ++d) order[d] = static_cast<uint32_t>(d);
+
+    if (mode == "minhash") {
+        minhashOrder(fwd, order);
+    } else {
+        if (max_depth < 0) {
+            max_depth = static_cast<int>(ceil(log2(static_cast<double>(num_docs) / BP_LEAF_SIZE)));
+        }
+        int parallel_depth = static_cast<int>(floor(log2(static_cast<double>(threads))));
+        cout << "Running recursive graph bisection: depth " << max_depth << ", " << iterations
+             << " iterations per level, " << threads << " threads." << endl;
+        bisect(fwd, order, 0, num_docs, 0, max_depth, iterations, parallel_depth);
+    }
+    vector<uint64_t>().swap(fwd.offsets);
+    vector<uint32_t>().swap(fwd.terms);
+
+    vector<uint32_t> new_id_of_dense(num_docs);
+    for (size_t new_id = 0; new_id < num_docs; ++new_id) {
+        new_id_of_dense[order[new_id]] = static_cast<uint32_t>(new_id);
+    }
+
+    // Rewrite the doc tables in new docID order, with a map back to the original passage IDs
+    ofstream page_table_out(output_dir + "/page_table.txt");
+    ofstream doc_map_out(output_dir + "/doc_map.txt");
+    CollectionStats reordered_stats;
+    if (!page_table_out.is_open() || !doc_map_out.is_open()) {
+        cerr << "Failed to create doc tables in " << output_dir << endl;
+        return 1;
+    }
+    for (size_t new_id = 0; new_id < num_docs; ++new_id) {
+        const auto& row = page_table[order[new_id]];
+        page_table_out << new_id << "\t" << row.rest << "\n";
+        if (!reordered_stats.addDocument(static_cast<uint32_t>(new_id), doc_lengths[order[new_id]])) {
+            return 1;
+        }
+        doc_map_out << new_id << "\t" << row.doc_id << "\n";
+    }
+    page_table_out.close();
+    doc_map_out.close();
+    if (!save_collection_stats(output_dir + "/collection_stats.bin", reordered_stats)) {
+        return 1;
+    }
+
+    for (size_t i = 0; i < intermediate_files.size(); ++i) {
+        string out_path = output_dir + "/reordered_" + to_string(i + 1) + ".txt";
+        if (!rewriteIntermediate(intermediate_files[i], out_path, sorted_ids, dense_of_sorted, new_id_of_dense, with_positions)) {
+            return 1;
+        }
+    }
+
+    cout << "Reordering completed. " << num_docs << " documents reassigned (" << mode << ")." << endl;
+
+    return 0;
+}
@@ -0,0 +1,345 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <memory>
+#include <filesystem>
+#include "sequential_io.h"
+#include "collection_stats.h"
+
+
+using namespace std;
+
+namespace fs = std::filesystem;
+
+const size_t RUN_FORMAT_CHECK_LINES = 16; // lines of each run checked before any shard is written
+
+// Splits a parsed (or reordered) collection into N docID-range shards, each a self-contained
+// index input: shard_K/ gets its own intermediate runs, page_table.txt, collection_stats.bin and
+// passages.bin (plus forward.bin when given). DocIDs stay global, so shard results
+// merge without remapping and one doc_map.txt still applies. Run the indexer once per shard.
+
+// Structure to hold one page table row
+struct PageTableRow {
+    uint32_t doc_id;
+    uint64_t passage_offset;
+    size_t passage_length;
+    uint64_t forward_offset = 0;
+    size_t forward_length = 0;
+};
+
+// Function to copy `length` bytes at `offset` of `in` to the end of `out`
+bool copyRecord(ifstream& in, uint64_t offset, size_t length, ofstream& out, vector<char>& buffer) {
+    buffer.resize(length);
+    in.seekg(offset, ios::beg);
+    if (!in.read(buffer.data(), length)) {
+        return false;
+    }
+    out.write(buffer.data(), length);
+    return static_cast<bool>(out);
+}
+
+// Function to split one run line's postings ("\tdocID\tfreq[\tpositions]" after the term) by
+// shard, checking them against the run format on the way: docIDs ascending, and with positions a
+// comma-separated list of freq positions per posting. False, with `error` set, on a mismatch.
+template <class ShardOf>
+bool splitPostings(const string& line, size_t tab, bool with_positions, ShardOf&& shardOf, vector<string>& shard_lines, string& error) {
+    for (auto& shard_line : shard_lines) shard_line.clear();
+    const char* end = line.data() + line.size();
+    size_t pos = tab;
+    bool first = true;
+    uint32_t last_doc = 0;
+    while (pos < line.size()) {
+        size_t begin = pos;
+        uint32_t fields[2]; // docID, freq
+        for (uint32_t& field : fields) {
+            const char* p = line.data() + pos + 1;
+            auto result = from_chars(p, end, field);
+            if (line[pos] != '\t' || result.ec != errc() || (result.ptr != end && *result.ptr != '\t')) {
+                error = "malformed posting";
+                return false;
+            }
+            pos = result.ptr - line.data();
+        }
+        if (!first && fields[0] <= last_doc) {
+            error = "docIDs out of order";
+            return false;
+        }
+        if (with_positions) {
+            // One position per occurrence, comma-separated
+            uint32_t count = 0;
+            const char* p = line.data() + pos + 1;
+            while (p < end && *p != '\t') {
+                uint32_t position;
+                auto result = from_chars(p, end, position);
+                if (result.ec != errc()) break;
+                count++;
+                p = result.ptr;
+                if (p < end && *p == ',') ++p;
+            }
+            if (pos >= line.size() || count != fields[1] || (p != end && *p != '\t')) {
+                error = "position count does not match the frequency";
+                return false;
+            }
+            pos = p - line.data();
+        }
+        first = false;
+        last_doc = fields[0];
+        shard_lines[shardOf(fields[0])].append(line, begin, pos - begin);
+    }
+    return true;
+}
+
+// Function to remove what this run wrote into the shard directories, and each directory it left empty
+void removeShardOutputs(const vector<fs::path>& shard_dirs, size_t num_runs) {
+    for (const auto& dir : shard_dirs) {
+        error_code ec;
+        for (const char* name : {"passages.bin", "forward.bin", "page_table.txt", "collection_stats.bin"}) {
+            fs::remove(dir / name, ec);
+        }
+        for (size_t r = 0; r < num_runs; ++r) {
+            fs::remove(dir / ("intermediate_" + to_string(r + 1) + ".txt"), ec);
+        }
+        if (fs::is_empty(dir, ec) && !ec) fs::remove(dir, ec);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_shards = 4;
+    bool with_positions = false;
+    string forward_file;
+
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--shards" && i + 1 < argc) {
+            num_shards = stoul(argv[++i]);
+        } else if (arg == "--positions") {
+            with_positions = true;
+        } else if (arg == "--forward" && i + 1 < argc) {
+            forward_file = argv[++i];
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 5 || num_shards == 0) {
+        cerr << "Usage: " << argv[0] << " [--shards 4] [--positions] [--forward forward.bin] <page_table.txt> <collection_stats.bin>"
+             << " <passages.bin> <output_dir> <intermediate_1.txt> [intermediate_2.txt ...]" << endl;
+        return 1;
+    }
+
+    string page_table_file = args[0];
+    string stats_file = args[1];
+    string passages_file = args[2];
+    fs::path output_dir = args[3];
+    vector<string> run_files(args.begin() + 4, args.end());
+
+    // Load the page table in docID order
+    ifstream page_table(page_table_file);
+    if (!page_table.is_open()) {
+        cerr << "Failed to open page table file: " << page_table_file << endl;
+        return 1;
+    }
+    vector<PageTableRow> rows;
+    string line;
+    while (getline(page_table, line)) {
+        istringstream iss(line);
+        PageTableRow row;
+        if (!(iss >> row.doc_id >> row.passage_offset >> row.passage_length)) {
+            continue;
+        }
+        iss >> row.forward_offset >> row.forward_length;
+        rows.push_back(row);
+    }
+    page_table.close();
+    if (rows.empty()) {
+        cerr << "No documents found in page table: " << page_table_file << endl;
+        return 1;
+    }
+    sort(rows.begin(), rows.end(), [](const PageTableRow& a, const PageTableRow& b) { return a.doc_id < b.doc_id; });
+    num_shards = min(num_shards, rows.size());
+
+    // Equal document counts per shard; shard s holds docIDs in [first_doc[s], first_doc[s + 1])
+    vector<uint32_t> first_doc(num_shards);
+    for (size_t s = 0; s < num_shards; ++s) {
+        first_doc[s] = rows[s * rows.size() / num_shards].doc_id;
+    }
+    auto shardOf = [&](uint32_t doc_id) {
+        return static_cast<size_t>(upper_bound(first_doc.begin() + 1, first_doc.end(), doc_id) - (first_doc.begin() + 1));
+    };
+
+    // Check the start of every run against the expected format before writing anything, so runs
+    // parsed with --positions but split without it (or the reverse) fail up front
+    vector<string> check_lines(1);
+    for (const auto& run_file : run_files) {
+        SequentialReader run;
+        if (!run.open(run_file)) {
+            cerr << "Failed to open intermediate file: " << run_file << endl;
+            return 1;
+        }
+        string error;
+        for (size_t n = 0; n < RUN_FORMAT_CHECK_LINES && run.readLine(line); ++n) {
+            size_t tab = line.find('\t');
+            if (tab == 0 || tab == string::npos
+                || !splitPostings(line, tab, with_positions, [](uint32_t) { return size_t(0); }, check_lines, error)) {
+                cerr << "Intermediate file " << run_file << " does not match the expected format ("
+                     << (with_positions ? "with" : "without") << " positions): " << (error.empty() ? "invalid line" : error)
+                     << ". Use --positions exactly when the runs were parsed with it." << endl;
+                return 1;
+            }
+        }
+    }
+
+    vector<fs::path> shard_dirs(num_shards);
+    for (size_t s = 0; s < num_shards; ++s) {
+        shard_dirs[s] = output_dir / ("shard_" + to_string(s));
+        error_code ec;
+        fs::create_directories(shard_dirs[s], ec);
+        if (ec) {
+            cerr << "Failed to create shard directory: " << shard_dirs[s] << " (" << ec.message() << ")" << endl;
+            return 1;
+        }
+    }
+
+    // From here on a failure removes the partly written shards
+    auto fail = [&]() {
+        removeShardOutputs(shard_dirs, run_files.size());
+        return 1;
+    };
+
+    // Passages (and forward records) are copied into per-shard files with rewritten offsets
+    ifstream passages_in(passages_file, ios::binary);
+    if (!passages_in.is_open()) {
+        cerr << "Failed to open passages file: " << passages_file << endl;
+        return fail();
+    }
+    ifstream forward_in;
+    if (!forward_file.empty()) {
+        forward_in.open(forward_file, ios::binary);
+        if (!forward_in.is_open()) {
+            cerr << "Failed to open forward index file: " << forward_file << endl;
+            return fail();
+        }
+    }
+    {
+        vector<ofstream> passages_out(num_shards), forward_out(num_shards), page_table_out(num_shards);
+        vector<uint64_t> passage_bytes(num_shards, 0), forward_bytes(num_shards, 0);
+        for (size_t s = 0; s < num_shards; ++s) {
+            passages_out[s].open(shard_dirs[s] / "passages.bin", ios::binary);
+            page_table_out[s].open(shard_dirs[s] / "page_table.txt");
+            if (!forward_file.empty()) {
+                forward_out[s].open(shard_dirs[s] / "forward.bin", ios::binary);
+            }
+            if (!passages_out[s] || !page_table_out[s] || (!forward_file.empty() && !forward_out[s])) {
+                cerr << "Failed to create shard output files in: " << shard_dirs[s] << endl;
+                return fail();
+            }
+        }
+
+        vector<char> buffer;
+        for (const auto& row : rows) {
+            size_t s = shardOf(row.doc_id);
+            // Each passages.bin record is a 4-byte length prefix followed by the passage bytes
+            if (!copyRecord(passages_in, row.passage_offset, sizeof(uint32_t) + row.passage_length, passages_out[s], buffer)) {
+                cerr << "Failed to copy passage for docID: " << row.doc_id << endl;
+                return fail();
+            }
+            page_table_out[s] << row.doc_id << "\t" << passage_bytes[s] << "\t" << row.passage_length;
+            passage_bytes[s] += sizeof(uint32_t) + row.passage_length;
+            if (!forward_file.empty()) {
+                if (row.forward_length > 0
+                    && !copyRecord(forward_in, row.forward_offset, row.forward_length, forward_out[s], buffer)) {
+                    cerr << "Failed to copy forward record for docID: " << row.doc_id << endl;
+                    return fail();
+                }
+                page_table_out[s] << "\t" << forward_bytes[s] << "\t" << row.forward_length;
+                forward_bytes[s] += row.forward_length;
+            }
+            page_table_out[s] << "\n";
+        }
+    }
+
+    // Document lengths and totals per shard, so a shard also works as a standalone index
+    CollectionStats stats;
+    if (!load_collection_stats(stats_file, stats)) {
+        return fail();
+    }
+    vector<CollectionStats> shard_stats(num_shards);
+    for (const auto& row : rows) {
+        if (!shard_stats[shardOf(row.doc_id)].addDocument(row.doc_id, stats.docLength(row.doc_id))) {
+            return fail();
+        }
+    }
+    for (size_t s = 0; s < num_shards; ++s) {
+        if (!save_collection_stats((shard_dirs[s] / "collection_stats.bin").string(), shard_stats[s])) {
+            return fail();
+        }
+    }
+
+    // Split every run line by line: each term's postings go to the shard owning their docID, so
+    // every shard run stays sorted by term and can be merged by the indexer as usual
+    size_t stride = with_positions ? 3 : 2; // docID, freq[, positions]
+    for (size_t r = 0; r < run_files.size(); ++r) {
+        SequentialReader run;
+        if (!run.open(run_files[r])) {
+            cerr << "Failed to open intermediate file: " << run_files[r] << endl;
+            return fail();
+        }
+        vector<unique_ptr<SequentialWriter>> shard_runs(num_shards);
+        for (size_t s = 0; s < num_shards; ++s) {
+            shard_runs[s] = make_unique<SequentialWriter>();
+            fs::path path = shard_dirs[s] / ("intermediate_" + to_string(r + 1) + ".txt");
+            if (!shard_runs[s]->open(path.string(), false, SEQUENTIAL_IO_DEFAULT_BUFFER / num_shards + SEQUENTIAL_IO_ALIGNMENT)) {
+                cerr << "Failed to create intermediate file: " << path << endl;
+                return fail();
+            }
+        }
+
+        vector<string> shard_lines(num_shards);
+        while (run.readLine(line)) {
+            size_t tab = line.find('\t');
+            if (tab == 0 || tab == string::npos) {
+                cerr << "Invalid line format in intermediate file: " << line << endl;
+                return fail();
+            }
+            string_view term(line.data(), tab);
+            string error;
+            if (!splitPostings(line, tab, with_positions, shardOf, shard_lines, error)) {
+                cerr << "Invalid posting for term '" << term << "' in " << run_files[r] << ": " << error << endl;
+                return fail();
+            }
+
+            for (size_t s = 0; s < num_shards; ++s) {
+                if (shard_lines[s].empty()) continue;
+                shard_runs[s]->write(term);
+                shard_runs[s]->write(shard_lines[s]);
+                shard_runs[s]->put('\n');
+            }
+        }
+        if (run.failed()) {
+            cerr << "Failed to read intermediate file: " << run_files[r] << endl;
+            return fail();
+        }
+        for (size_t s = 0; s < num_shards; ++s) {
+            if (!shard_runs[s]->close()) {
+                cerr << "Failed to write intermediate file in: " << shard_dirs[s] << endl;
+                return fail();
+            }
+        }
+    }
+
+    for (size_t s = 0; s < num_shards; ++s) {
+        cout << "Shard " << s << ": docIDs from " << first_doc[s] << ", " << shard_stats[s].numDocs() << " documents, "
+             << shard_stats[s].header.total_tokens << " tokens -> " << shard_dirs[s].string() << endl;
+    }
+    cout << "Index each shard with: indexer <shard>/intermediate_*.txt <shard>/final_index.bin <shard>/lexicon.txt" << endl;
+
+    return 0;
+}
@@ -0,0 +1,34 @@
+import argparse
+import logging
+import numpy as np
+from read_h5 import load_embeddings
+
+# Export .h5 embeddings to the flat binary read by the C++ engine (include/embeddings.h):
+#   magic u32 "EMB1" | version u32 | count u32 | dim u32 | count x u32 ids | count x dim x f32
+EMBEDDINGS_MAGIC = 0x31424D45
+EMBEDDINGS_VERSION = 1
+
+logging.basicConfig(level=logging.INFO, format='%(asctime)s - %(levelname)s - %(message)s')
+
+
+def export_embeddings(h5_path: str, out_path: str) -> None:
+    """Write ids and float32 vectors from an H5 embeddings file as a flat binary."""
+    ids, embeddings = load_embeddings(h5_path)
+    ids = ids.astype(np.int64)
+    if ids.min() < 0 or ids.max() > np.iinfo(np.uint32).max:
+        raise ValueError(f"IDs in {h5_path} do not fit in 32 bits")
+
+    count, dim = embeddings.shape
+    with open(out_path, 'wb') as f:
+        np.array([EMBEDDINGS_MAGIC, EMBEDDINGS_VERSION, count, dim], dtype='<u4').tofile(f)
+        ids.astype('<u4').tofile(f)
+        np.ascontiguousarray(embeddings, dtype='<f4').tofile(f)
+    logging.info(f"Exported {count} embeddings of dimension {dim} to {out_path}")
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Export H5 embeddings for the C++ query processor")
+    parser.add_argument("h5_file", help="e.g. data/embeddings.h5 or data/queries_dev_eval_embeddings.h5")
+    parser.add_argument("out_file", help="e.g. output/passage_embeddings.bin")
+    args = parser.parse_args()
+    export_embeddings(args.h5_file, args.out_file)